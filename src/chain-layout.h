@@ -0,0 +1,457 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_CHAIN_LAYOUT_H
+#define MMCHAIN_ANALYSIS_SRC_CHAIN_LAYOUT_H
+
+#include <algorithm>
+#include <climits>
+#include "tensor-operator.h"
+#include "operator-tree.h"
+#include "simd-kernel.h"
+
+namespace DAT {
+
+struct ChainCost {
+  long access_volume{0};
+  long mem_footprint{0};
+  long compute_time{0};
+  // the footprint taking the smallest record of each fused tensor, a lower bound of the
+  // footprint constraints of the block size MIP at the same or larger block sizes
+  long min_mem_footprint{0};
+};
+
+using BlockSizes = std::map<TensorOperator *, std::map<Dim *, long> >;
+
+// An indexed view of an operator chain. Every (operator, dim) pair gets a slot, and the
+// per-candidate values of a slot are stored contiguously, so the cost model of many candidate
+// orders is evaluated column by column, with SIMD kernels, without touching Dim and Tensor states.
+class ChainLayout {
+public:
+  ChainLayout(const std::set<TensorOperator *> &operators, const std::vector<OperatorNode *> &nodes) {
+    ops.assign(operators.begin(), operators.end());
+    for (long o = 0; o < ops.size(); ++o) {
+      op_index[ops[o]] = o;
+    }
+    op_slot_offset.push_back(0);
+    for (auto op : ops) {
+      for (auto d : op->getDims()) {
+        slot_dims.push_back(d);
+      }
+      op_slot_offset.push_back(static_cast<long>(slot_dims.size()));
+    }
+
+    std::map<Tensor *, long> tensor_index;
+    op_tensors.resize(ops.size());
+    op_state_bytes.assign(ops.size(), 0);
+    op_normalize_slot.assign(ops.size(), -1);
+    for (long o = 0; o < ops.size(); ++o) {
+      TensorOperator *op = ops[o];
+      auto element_wise = dynamic_cast<ElementWise *>(op);
+      auto row_norm = dynamic_cast<RowNormalization *>(op);
+      if (row_norm) {
+        op_state_bytes[o] = 2 * op->getOutputTensors().front()->getFootprintBytes();
+        for (long s = op_slot_offset[o]; s < op_slot_offset[o + 1]; ++s) {
+          if (slot_dims[s] == row_norm->getNormalizeDim()) {
+            op_normalize_slot[o] = s;
+          }
+        }
+      }
+      auto addAccess = [&](Tensor *t, bool output) {
+        assert(dynamic_cast<BatchTensor2D *>(t) == nullptr && "batch tensors are not supported");
+        if (!tensor_index.count(t)) {
+          tensor_index[t] = static_cast<long>(tensors.size());
+          tensors.push_back(t);
+          tensor_accesses.emplace_back();
+        }
+        TensorAccess a;
+        a.op = o;
+        a.tensor = tensor_index[t];
+        a.output = output;
+        a.fused = t->isFused();
+        a.io_or_external = t->isIO() || t->isExternal();
+        a.with_bias = op->is_with_bias();
+        a.partial_sums = output && !element_wise;
+        a.passes = element_wise && !output ? element_wise->getPasses() : 1;
+        a.size = t->getSize();
+        a.element_bytes = t->getElementBytes();
+        a.footprint_bytes = t->getFootprintBytes();
+        for (long s = op_slot_offset[o]; s < op_slot_offset[o + 1]; ++s) {
+          if (t->hasDim(slot_dims[s])) {
+            a.tensor_slots.push_back(s);
+            auto key = std::make_pair(a.tensor, slot_dims[s]);
+            if (!expand_index.count(key)) {
+              expand_index[key] = static_cast<long>(expand_index.size());
+            }
+            a.expand_ids.push_back(expand_index[key]);
+          } else {
+            a.other_slots.push_back(s);
+          }
+        }
+        tensor_accesses[a.tensor].push_back(static_cast<long>(accesses.size()));
+        op_tensors[o].insert(a.tensor);
+        accesses.push_back(a);
+      };
+      for (auto t : op->getInputTensors()) {
+        addAccess(t, false);
+      }
+      for (auto t : op->getOutputTensors()) {
+        addAccess(t, true);
+      }
+    }
+    // a fused external input of several operators is loaded by the one running first, see
+    // OperatorChain::updateLoadedElsewhere
+    for (long t = 0; t < tensors.size(); ++t) {
+      if (!tensors[t]->isExternal()) {
+        continue;
+      }
+      for (auto ai : tensor_accesses[t]) {
+        for (auto aj : tensor_accesses[t]) {
+          if (ai != aj && !accesses[ai].output && !accesses[aj].output) {
+            accesses[ai].load_peers.push_back(accesses[aj].op);
+          }
+        }
+      }
+    }
+    tensor_fused.resize(tensors.size());
+    par_tensor_ids.resize(tensors.size());
+    for (long t = 0; t < tensors.size(); ++t) {
+      tensor_fused[t] = tensors[t]->isFused();
+      for (auto pt : tensors[t]->getParTensors()) {
+        if (tensor_index.count(pt)) {
+          par_tensor_ids[t].push_back(tensor_index[pt]);
+        }
+      }
+    }
+
+    std::map<OperatorNode *, long> node_index;
+    for (long i = 0; i < nodes.size(); ++i) {
+      node_index[nodes[i]] = i;
+    }
+    this->nodes = nodes;
+    op_node.assign(ops.size(), 0);
+    for (auto node : nodes) {
+      TensorOperator *op = node->getOperator();
+      op_node[op_index.at(op)] = static_cast<long>(node_op.size());
+      node_op.push_back(op_index.at(op));
+      node_parent.push_back(node->getParent() ? node_index.at(node->getParent()) : -1);
+      // the same rule as isReduceDimExpended: the first reduce dim of the parent decides
+      long group_expand_id = ALWAYS_EXPANDED;
+      if (node->getParent()) {
+        auto reduce_dims = node->getParent()->getOperator()->getReduceDims();
+        if (!reduce_dims.empty()) {
+          auto key = std::make_pair(tensor_index.at(op->getOutputTensor(0)), *reduce_dims.begin());
+          group_expand_id = expand_index.count(key) ? expand_index.at(key) : NEVER_EXPANDED;
+        }
+      }
+      node_group_expand_id.push_back(group_expand_id);
+    }
+  }
+
+  // Block sizes are given per candidate, or once for all candidates.
+  std::vector<ChainCost> evaluate(const std::vector<OperatorTree> &order_trees,
+                                  const std::vector<BlockSizes> &block_sizes,
+                                  const SimdKernels &kernels = simdKernels()) const {
+    const long n_num = static_cast<long>(order_trees.size());
+    assert(block_sizes.size() == order_trees.size() || block_sizes.size() == 1);
+    const long slot_num = static_cast<long>(slot_dims.size());
+
+    std::vector<long> pos(slot_num * n_num, -1);
+    std::vector<long> blocks(slot_num * n_num);
+    std::vector<long> block_size(slot_num * n_num);
+    std::vector<std::vector<int> > ranks(n_num, std::vector<int>(nodes.size()));
+    for (long n = 0; n < n_num; ++n) {
+      const auto o_infos = order_trees[n].getOrderInfos();
+      const BlockSizes &bss = block_sizes.size() == 1 ? block_sizes[0] : block_sizes[n];
+      for (long i = 0; i < nodes.size(); ++i) {
+        const OrderInfo &o_info = o_infos.at(nodes[i]);
+        ranks[n][i] = o_info.execute_rank;
+        long o = node_op[i];
+        long p = 0;
+        for (auto d : o_info.dims_order) {
+          for (long s = op_slot_offset[o]; s < op_slot_offset[o + 1]; ++s) {
+            if (slot_dims[s] == d) {
+              pos[s * n_num + n] = p++;
+            }
+          }
+        }
+        for (long s = op_slot_offset[o]; s < op_slot_offset[o + 1]; ++s) {
+          assert(pos[s * n_num + n] >= 0 && "dims order should cover all dims of the operator");
+          long bs = bss.at(ops[o]).at(slot_dims[s]);
+          block_size[s * n_num + n] = bs;
+          blocks[s * n_num + n] = slot_dims[s]->getSize() / bs;
+        }
+      }
+    }
+
+    std::vector<long> access_volume(n_num, 0);
+    std::vector<long> footprints(accesses.size() * n_num);
+    std::vector<long> expanded(expand_index.size() * n_num, 0);
+    std::vector<long> tensor_block_size(n_num);
+    std::vector<long> times(n_num);
+    std::vector<long> bound(n_num);
+    for (long ai = 0; ai < accesses.size(); ++ai) {
+      const TensorAccess &a = accesses[ai];
+      std::fill(tensor_block_size.begin(), tensor_block_size.end(), 1);
+      for (auto s : a.tensor_slots) {
+        kernels.mul(tensor_block_size.data(), &block_size[s * n_num], n_num);
+      }
+
+      // access volume, see MatrixMul::analyzeMemAccess
+      if (a.fused) {
+        long const_volume = (a.output && a.with_bias) ? a.size * a.element_bytes : 0;
+        std::fill(times.begin(), times.end(), 0);
+        if (a.io_or_external) {
+          std::fill(times.begin(), times.end(), a.element_bytes);
+          for (auto s : a.tensor_slots) {
+            kernels.mul(times.data(), &blocks[s * n_num], n_num);
+          }
+          for (long n = 0; n < n_num && !a.load_peers.empty(); ++n) {
+            if (!isLoader(a, ranks[n])) {
+              times[n] = 0;
+            }
+          }
+        }
+        kernels.mulAdd(access_volume.data(), times.data(), tensor_block_size.data(), const_volume, n_num);
+      } else {
+        // the tensor is reloaded by every loop from its outermost dim inward
+        std::fill(bound.begin(), bound.end(), LONG_MAX);
+        for (auto s : a.tensor_slots) {
+          kernels.min(bound.data(), &pos[s * n_num], n_num);
+        }
+        std::fill(times.begin(), times.end(), a.partial_sums ? 2 * a.footprint_bytes : a.passes * a.element_bytes);
+        for (long s = op_slot_offset[a.op]; s < op_slot_offset[a.op + 1]; ++s) {
+          kernels.mulIfNotBefore(times.data(), &pos[s * n_num], bound.data(), &blocks[s * n_num], n_num);
+        }
+        long const_volume = a.partial_sums ? -(2 * (a.footprint_bytes - a.element_bytes)
+            + (a.with_bias ? 0 : a.element_bytes)) * a.size : 0;
+        kernels.mulAdd(access_volume.data(), times.data(), tensor_block_size.data(), const_volume, n_num);
+      }
+
+      // footprint, see MatrixMul::analyzeMemFootprint
+      long *fp = &footprints[ai * n_num];
+      std::transform(tensor_block_size.begin(), tensor_block_size.end(), fp,
+                     [&a](long bs) { return bs * a.footprint_bytes; });
+      if (a.fused) {
+        // tensor dims outside the innermost non-tensor dim are expanded
+        std::fill(bound.begin(), bound.end(), -1);
+        for (auto s : a.other_slots) {
+          kernels.max(bound.data(), &pos[s * n_num], n_num);
+        }
+        for (long k = 0; k < a.tensor_slots.size(); ++k) {
+          long s = a.tensor_slots[k];
+          kernels.mulIfBefore(fp, &expanded[a.expand_ids[k] * n_num], &pos[s * n_num], bound.data(),
+                              &blocks[s * n_num], n_num);
+        }
+      } else if (options().buffer_num > 1) {
+        // streamed when the innermost dim of the operator is a tensor dim
+        std::fill(bound.begin(), bound.end(), LONG_MAX);
+        std::fill(times.begin(), times.end(), LONG_MAX);
+        for (auto s : a.other_slots) {
+          kernels.min(bound.data(), &pos[s * n_num], n_num);
+        }
+        for (auto s : a.tensor_slots) {
+          kernels.min(times.data(), &pos[s * n_num], n_num);
+        }
+        for (long n = 0; n < n_num; ++n) {
+          if (times[n] < bound[n]) {
+            fp[n] *= options().buffer_num;
+          }
+        }
+      }
+    }
+
+    // statistics of row normalizations, see RowNormalization::analyzeMemFootprint
+    std::vector<long> states(ops.size() * n_num, 0);
+    for (long o = 0; o < ops.size(); ++o) {
+      long ns = op_normalize_slot[o];
+      if (ns < 0) {
+        continue;
+      }
+      for (long n = 0; n < n_num; ++n) {
+        long state = op_state_bytes[o];
+        for (long s = op_slot_offset[o]; s < op_slot_offset[o + 1]; ++s) {
+          // rows inside the normalize loop are all kept
+          if (s != ns) {
+            state *= block_size[s * n_num + n];
+            if (pos[s * n_num + n] < pos[ns * n_num + n]) {
+              state *= blocks[s * n_num + n];
+            }
+          }
+        }
+        states[o * n_num + n] = state;
+      }
+    }
+
+    std::vector<ChainCost> costs(n_num);
+    for (long n = 0; n < n_num; ++n) {
+      costs[n].access_volume = access_volume[n];
+      costs[n].mem_footprint = groupFootprint(n, n_num, ranks[n], footprints, expanded, states, false);
+      costs[n].min_mem_footprint = groupFootprint(n, n_num, ranks[n], footprints, expanded, states, true);
+      for (long o = 0; o < ops.size(); ++o) {
+        std::map<Dim *, long> op_block_sizes;
+        for (long s = op_slot_offset[o]; s < op_slot_offset[o + 1]; ++s) {
+          op_block_sizes[slot_dims[s]] = block_size[s * n_num + n];
+        }
+        costs[n].compute_time += ops[o]->compute_time(op_block_sizes);
+      }
+    }
+    return costs;
+  }
+
+private:
+  static constexpr long ALWAYS_EXPANDED = -1;
+  static constexpr long NEVER_EXPANDED = -2;
+
+  struct TensorAccess {
+    long op{};
+    long tensor{};
+    bool output{};
+    bool fused{};
+    bool io_or_external{};
+    // the other operators reading the same external input, only the first of them to run loads it
+    std::vector<long> load_peers;
+    bool with_bias{};
+    // outputs stored and reloaded as partial sums, and reads of inputs
+    bool partial_sums{};
+    long passes{1};
+    long size{};
+    long element_bytes{1};
+    long footprint_bytes{1};
+    std::vector<long> tensor_slots;
+    std::vector<long> expand_ids;
+    std::vector<long> other_slots;
+  };
+
+  // Whether the operator of an access to a shared input runs before the other readers, see
+  // OperatorChain::updateLoadedElsewhere.
+  bool isLoader(const TensorAccess &a, const std::vector<int> &ranks) const {
+    int rank = ranks[op_node[a.op]];
+    for (auto o : a.load_peers) {
+      int peer_rank = ranks[op_node[o]];
+      if (peer_rank > rank || (peer_rank == rank && o < a.op)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // see OperatorChain::analysisEnvTensors, buildOperatorGroup and analyzeMemFootprint
+  long groupFootprint(long n, long n_num, const std::vector<int> &ranks,
+                      const std::vector<long> &footprints,
+                      const std::vector<long> &expanded,
+                      const std::vector<long> &states,
+                      bool min_record) const {
+    std::vector<long> op_rank(ops.size());
+    for (long i = 0; i < nodes.size(); ++i) {
+      op_rank[node_op[i]] = ranks[i];
+    }
+    std::vector<std::set<long> > env_tensors(nodes.size());
+    for (long t = 0; t < tensors.size(); ++t) {
+      if (!tensor_fused[t] || tensor_accesses[t].size() < 2) {
+        continue;
+      }
+      long first_rank = LONG_MIN;
+      long last_rank = LONG_MAX;
+      for (auto ai : tensor_accesses[t]) {
+        first_rank = std::max(first_rank, op_rank[accesses[ai].op]);
+        last_rank = std::min(last_rank, op_rank[accesses[ai].op]);
+      }
+      for (long j = 0; j < nodes.size(); ++j) {
+        if (ranks[j] > last_rank && ranks[j] < first_rank && !op_tensors[node_op[j]].count(t)) {
+          env_tensors[j].insert(t);
+        }
+      }
+    }
+
+    std::vector<long> node_group(nodes.size(), 0);
+    long group_num = 0;
+    for (long i = 0; i < nodes.size(); ++i) {
+      long e = node_group_expand_id[i];
+      bool same_group = node_parent[i] >= 0
+          && (e == ALWAYS_EXPANDED || (e != NEVER_EXPANDED && expanded[e * n_num + n]));
+      node_group[i] = same_group ? node_group[node_parent[i]] : group_num++;
+    }
+
+    // pipelined groups are all in SRAM at the same time, and tensors passed between them are
+    // double buffered
+    std::vector<long> op_group(ops.size(), 0);
+    for (long i = 0; i < nodes.size(); ++i) {
+      op_group[node_op[i]] = node_group[i];
+    }
+    bool pipeline = options().pipeline;
+    long mem_footprint = 0;
+    for (long g = 0; g < (pipeline ? 1 : group_num); ++g) {
+      std::set<long> group_ops;
+      std::set<long> group_tensors;
+      for (long i = 0; i < nodes.size(); ++i) {
+        if (pipeline || node_group[i] == g) {
+          group_ops.insert(node_op[i]);
+          group_tensors.insert(op_tensors[node_op[i]].begin(), op_tensors[node_op[i]].end());
+          group_tensors.insert(env_tensors[i].begin(), env_tensors[i].end());
+        }
+      }
+      long og_mem_footprint = 0;
+      for (auto o : group_ops) {
+        og_mem_footprint += states[o * n_num + n];
+      }
+      for (auto t : group_tensors) {
+        long buffers = 1;
+        if (pipeline && tensor_fused[t]) {
+          for (auto ai : tensor_accesses[t]) {
+            if (op_group[accesses[ai].op] != op_group[accesses[tensor_accesses[t].front()].op]) {
+              buffers = 2;
+            }
+          }
+        }
+        if (tensor_fused[t] && min_record) {
+          long min_footprint = LONG_MAX;
+          for (auto ai : tensor_accesses[t]) {
+            min_footprint = std::min(min_footprint, footprints[ai * n_num + n]);
+          }
+          og_mem_footprint += buffers * min_footprint;
+        } else if (tensor_fused[t]) {
+          long max_footprint = 0;
+          for (auto ai : tensor_accesses[t]) {
+            max_footprint = std::max(max_footprint, footprints[ai * n_num + n]);
+          }
+          for (auto pt : par_tensor_ids[t]) {
+            for (auto ai : tensor_accesses[pt]) {
+              max_footprint = std::max(max_footprint, footprints[ai * n_num + n]);
+            }
+          }
+          og_mem_footprint += buffers * max_footprint;
+        } else {
+          for (auto ai : tensor_accesses[t]) {
+            if (group_ops.count(accesses[ai].op)) {
+              og_mem_footprint += footprints[ai * n_num + n];
+              break;
+            }
+          }
+        }
+      }
+      mem_footprint = std::max(mem_footprint, og_mem_footprint);
+    }
+    return mem_footprint;
+  }
+
+  std::vector<TensorOperator *> ops;
+  std::map<TensorOperator *, long> op_index;
+  std::vector<long> op_slot_offset;
+  std::vector<Dim *> slot_dims;
+  std::vector<Tensor *> tensors;
+  std::vector<bool> tensor_fused;
+  std::vector<std::vector<long> > par_tensor_ids;
+  std::vector<std::set<long> > op_tensors;
+  std::vector<long> op_state_bytes;
+  std::vector<long> op_normalize_slot;
+  std::vector<TensorAccess> accesses;
+  std::vector<std::vector<long> > tensor_accesses;
+  std::map<std::pair<long, Dim *>, long> expand_index;
+  std::vector<OperatorNode *> nodes;
+  std::vector<long> node_op;
+  std::vector<long> op_node;
+  std::vector<long> node_parent;
+  std::vector<long> node_group_expand_id;
+};
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_CHAIN_LAYOUT_H
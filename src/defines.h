@@ -2,6 +2,13 @@
 #ifndef MMCHAIN_ANALYSIS_SRC_DEFINES_H
 #define MMCHAIN_ANALYSIS_SRC_DEFINES_H
 
-#define MAX_TENSOR_NUM 16
+#include <boost/dynamic_bitset.hpp>
+
+namespace DAT {
+
+// Which tensors of a list are fused, one bit per tensor in the order of the list.
+using FusePattern = boost::dynamic_bitset<>;
+
+}
 
 #endif //MMCHAIN_ANALYSIS_SRC_DEFINES_H
@@ -14,6 +14,7 @@
 #include <algorithm>
 #include <cmath>
 #include "options.h"
+#include "util.h"
 
 namespace DAT {
 
@@ -23,9 +24,9 @@ class Tensor;
 class Dim {
 public:
   Dim() : size_set(false) {};
-  Dim(std::string n, long s) : name(std::move(n)), size(s), size_set(true) {};
+  Dim(std::string n, long s) : name(std::move(n)), size(s), size_set(true), factors(findFactors(s)) {};
   explicit Dim(std::string n) : name(std::move(n)), size_set(false) {};
-  explicit Dim(long s) : size_set(true), size(s) {};
+  explicit Dim(long s) : size_set(true), size(s), factors(findFactors(s)) {};
   [[nodiscard]] long getSize() const {
     assert(size_set);
     return size;
@@ -38,12 +39,18 @@ public:
     assert(size_set);
     return tensor_block_sizes.at(to);
   }
+  // All legal block sizes (equivalently block numbers) of this dim, in ascending order.
+  [[nodiscard]] const std::vector<long> &getFactors() const {
+    assert(size_set);
+    return factors;
+  }
   std::string getName() {
     return name;
   }
   void setSize(long s) {
     size_set = true;
     size = s;
+    factors = findFactors(s);
   }
   void setBlocks(TensorOperator *to, long b) {
     assert(size_set);
@@ -84,6 +91,7 @@ public:
   void clear() {
     size_set = false;
     size = 0;
+    factors.clear();
     tensor_blocks.clear();
     tensor_block_sizes.clear();
     related_tensor.clear();
@@ -94,6 +102,7 @@ private:
   bool size_set{false};
   long size{0};
   std::string name;
+  std::vector<long> factors;
   std::map<Tensor *, long> related_tensor;
   std::map<TensorOperator *, long> tensor_block_sizes;
   std::map<TensorOperator *, long> tensor_blocks;
@@ -6,8 +6,8 @@
 #define MMCHAIN_ANALYSIS_SRC_DSE_H
 
 #include <cfloat>
-#include <bitset>
 #include <fstream>
+#include <functional>
 #include "operator-chain.h"
 #include "to-gurobi.h"
 #include <boost/filesystem.hpp>
@@ -18,13 +18,13 @@
 #include "defines.h"
 #include "operator-tree.h"
 #include "util.h"
+#include "order-cache.h"
+#include "pareto.h"
+#include <map>
+#include <tuple>
 
 namespace DAT {
 
-// Initialize random number generator
-auto rd = std::random_device{};
-auto rng = std::default_random_engine{rd()};
-
 void checkTree(const OperatorTree &t) {
   for (auto r : t.getRoot()->getChildren()) {
     r->getOperator();
@@ -552,18 +552,9 @@ public:
 
 };
 
-std::vector<long> findFactors(long number) {
-  std::vector<long> factors;
-
-  for (int i = 1; i <= number; ++i) {
-    if (number % i == 0) {
-      factors.push_back(i);
-    }
-  }
-
-  return factors;
-}
-
+// The block sizes of op_chain by mipBlockSize. The bsc and hsc block sizes of the operators having
+// those dims are traversed if all of them depend on the dim, 1 if none does, or from the options.
+// The gsc block sizes are always traversed, as the query heads of a group reuse the same K and V.
 double optimizeBlockSize(OperatorChain *op_chain,
                          long mem_constraint,
                          bool print_info = false,
@@ -576,47 +567,75 @@ double optimizeBlockSize(OperatorChain *op_chain,
     traversal_batch_blocksize = true;
     batch_independent = true;
     for (auto op : op_chain->getOperators()) {
-      traversal_batch_blocksize &= op->isBatchDependent();
-      batch_independent &= !op->isBatchDependent();
+      if (op->getDim("bsc")) {
+        traversal_batch_blocksize &= op->isBatchDependent();
+        batch_independent &= !op->isBatchDependent();
+      }
     }
   }
   if (op_chain->getDim("hsc")) {
     traversal_head_blocksize = true;
     head_independent = true;
     for (auto op : op_chain->getOperators()) {
-      traversal_head_blocksize &= op->isBatchDependent();
-      head_independent &= !op->isHeadDependent();
+      if (op->getDim("hsc")) {
+        traversal_head_blocksize &= op->isBatchDependent();
+        head_independent &= !op->isHeadDependent();
+      }
     }
   }
+  auto setBlockSize = [op_chain](const std::string &dim_name, long bs) {
+    if (op_chain->getDim(dim_name)) {
+      for (auto op : op_chain->getOperators()) {
+        if (op->getDim(dim_name)) {
+          op->getDim(dim_name)->setBlockSize(op, bs);
+        }
+      }
+    }
+  };
+  // the best over the gsc block sizes, if any
+  auto mipGroupBlockSize = [&](long &group) {
+    if (!op_chain->getDim("gsc")) {
+      return mipBlockSize(op_chain, mem_constraint, print_info, lp_file);
+    }
+    double best_obj = FLT_MAX;
+    for (auto gs : op_chain->getDim("gsc")->getFactors()) {
+      setBlockSize("gsc", gs);
+      double obj = mipBlockSize(op_chain, mem_constraint, print_info, lp_file);
+      if (obj < best_obj) {
+        best_obj = obj;
+        group = gs;
+      }
+    }
+    return best_obj;
+  };
   double best_obj = FLT_MAX;
-  long best_batch = Options::batch_blocksize;
-  long best_head = Options::head_blocksize;
+  long best_batch = options().batch_blocksize;
+  long best_head = options().head_blocksize;
+  long best_group = 1;
   if (traversal_batch_blocksize) {
-    std::vector<long> batch_blocksizes;
-    batch_blocksizes = findFactors(op_chain->getDim("bsc")->getSize());
+    const std::vector<long> &batch_blocksizes = op_chain->getDim("bsc")->getFactors();
     for (auto bs : batch_blocksizes) {
-      for (auto op : op_chain->getOperators()) {
-        op->getDim("bsc")->setBlockSize(op, bs);
-      }
+      setBlockSize("bsc", bs);
       if (traversal_head_blocksize) {
-        std::vector<long> head_blocksizes;
-        head_blocksizes = findFactors(op_chain->getDim("hsc")->getSize());
+        const std::vector<long> &head_blocksizes = op_chain->getDim("hsc")->getFactors();
         for (auto hs : head_blocksizes) {
-          for (auto op : op_chain->getOperators()) {
-            op->getDim("hsc")->setBlockSize(op, hs);
-          }
-          double obj = mipBlockSize(op_chain, mem_constraint, print_info, lp_file);
+          setBlockSize("hsc", hs);
+          long group = 1;
+          double obj = mipGroupBlockSize(group);
           if (obj < best_obj) {
             best_obj = obj;
             best_batch = bs;
             best_head = hs;
+            best_group = group;
           }
         }
       } else {
-        double obj = mipBlockSize(op_chain, mem_constraint, print_info, lp_file);
+        long group = 1;
+        double obj = mipGroupBlockSize(group);
         if (obj < best_obj) {
           best_obj = obj;
           best_batch = bs;
+          best_group = group;
         }
       }
     }
@@ -628,16 +647,12 @@ double optimizeBlockSize(OperatorChain *op_chain,
     best_head = 1;
   }
 
-  if (op_chain->getDim("bsc")) {
-    for (auto op : op_chain->getOperators()) {
-      op->getDim("bsc")->setBlockSize(op, best_batch);
-    }
-  }
-  if (op_chain->getDim("hsc")) {
-    for (auto op : op_chain->getOperators()) {
-      op->getDim("hsc")->setBlockSize(op, best_head);
-    }
+  setBlockSize("bsc", best_batch);
+  setBlockSize("hsc", best_head);
+  if (!traversal_batch_blocksize && op_chain->getDim("gsc")) {
+    mipGroupBlockSize(best_group);
   }
+  setBlockSize("gsc", best_group);
 
   return mipBlockSize(op_chain, mem_constraint, print_info, lp_file);
 }
@@ -646,11 +661,11 @@ std::vector<Dim *> randomExchangeTwoDims(const std::vector<Dim *> &dims_order) {
   std::vector<Dim *> ret_dims_order(dims_order.begin(), dims_order.end());
   // Generate random indices
   std::uniform_int_distribution<size_t> distribution(0, ret_dims_order.size() - 1);
-  size_t index1 = distribution(rng);
-  size_t index2 = distribution(rng);
+  size_t index1 = distribution(rng());
+  size_t index2 = distribution(rng());
   // Ensure the two indices are different
   while (index1 == index2) {
-    index2 = distribution(rng);
+    index2 = distribution(rng());
   }
   // Swap elements at the random indices
   std::swap(ret_dims_order[index1], ret_dims_order[index2]);
@@ -685,7 +700,7 @@ OperatorTree selectOneNodeAndChangeDimsOrder(OperatorTree op_tree, OperatorNode
   for (int ii = 0; ii < op_nodes.size(); ++ii) {
     constraint_dims_num[ii] = op_nodes[ii]->getDimsOrderConstraint().size();
     for (int iii = 0; iii < op_nodes[ii]->getFreeDims().size(); ++iii) {
-      free_dims_offsets[ii].push_back(dis(rng) % (constraint_dims_num[ii] + iii + 1));
+      free_dims_offsets[ii].push_back(dis(rng()) % (constraint_dims_num[ii] + iii + 1));
     }
     op_nodes[ii]->setDimsOrder(free_dims_offsets[ii]);
     op_nodes[ii]->setChildrenDimsOrderConstraint();
@@ -707,10 +722,19 @@ OperatorTree generateRandomTreeOrder(OperatorTree op_tree) {
   root_dims_vec.pop_back();
 
   std::vector<Dim *> root_dims_order = root_dims_vec;
-  std::shuffle(root_dims_order.begin(), root_dims_order.end(), rng);
+  std::shuffle(root_dims_order.begin(), root_dims_order.end(), rng());
 
   op_root->setDimsOrderConstraint(root_dims_order);
   op_tree = selectOneNodeAndChangeDimsOrder(op_tree, op_root);
+  // the other sinks of a DAG are not constrained by any consumer
+  for (auto r : op_tree.getRoots()) {
+    if (r != op_root) {
+      auto o_infos = op_tree.getOrderInfos();
+      o_infos[r].dims_order_constraint.clear();
+      op_tree.setOrderInfos(o_infos);
+      op_tree = selectOneNodeAndChangeDimsOrder(op_tree, r);
+    }
+  }
 
   return op_tree;
 
@@ -732,6 +756,75 @@ OperatorTree generateRandomTreeOrder(OperatorTree op_tree) {
 //  return is_inferior;
 //}
 
+// The smallest block sizes the block size MIP may choose, see buildBlockSizeModel.
+BlockSizes minBlockSizes(OperatorChain *op_chain) {
+  BlockSizes block_sizes;
+  for (auto op : op_chain->getOperators()) {
+    for (auto d : op->getDims()) {
+      const std::vector<long> &factors = d->getFactors();
+      long bs = factors.front();
+      if (options().enable_compute_utilization_constraint && d->getName() != "bsc" && d->getName() != "hsc"
+          && d->getName() != "gsc") {
+        auto it = std::lower_bound(factors.begin(), factors.end(), 16);
+        bs = it == factors.end() ? factors.back() : *it;
+      }
+      block_sizes[op][d] = bs;
+    }
+  }
+  return block_sizes;
+}
+
+// A candidate screened out by the batch evaluation, with screened_footprint its footprint at the
+// smallest block sizes, never had its block sizes solved: it is logged with that footprint and
+// without access volume and compute time.
+void writeDimOrderLog(OperatorChain *op_chain, const OperatorTree &dims_order_tree, long mem_size, double obj,
+                      long screened_footprint = -1) {
+  if (screened_footprint < 0) {
+    op_chain->setOrder(dims_order_tree.getOrderInfos());
+  }
+  LogRecord3 log_record;
+  log_record.id = 3;
+  log_record.defineAlgroithm(op_chain->getOperators());
+  log_record.mem_size = mem_size;
+  log_record.recordFuseStatus(op_chain->getExternalTensors());
+  for (auto op : dims_order_tree.getNodes()) {
+    log_record.recordDimOrder(op->getDimsOrder());
+  }
+  log_record.mem_footprint = screened_footprint < 0 ? op_chain->getMemFootprint() : screened_footprint;
+  if (obj == FLT_MAX) {
+    log_record.mem_access_volume = -1;
+    log_record.compute_time = -1;
+  } else {
+    log_record.mem_access_volume = op_chain->getMemAccessVolume();
+    log_record.compute_time = op_chain->compute_time();
+  }
+  log_record.writeToFile(options().log_directory + "/log3.csv");
+}
+
+// Optimize the block sizes of each candidate order. All candidates are first evaluated in one
+// batch with the smallest block sizes: as footprints only grow with block sizes, a candidate over
+// mem_size there has no feasible block size, and its MIP is skipped.
+std::vector<double> optimizeBlockSizeOfOrders(OperatorChain *op_chain,
+                                              const std::vector<OperatorTree> &dims_order_trees,
+                                              long mem_size) {
+  std::vector<ChainCost> min_costs = op_chain->evaluateOrders(dims_order_trees, {minBlockSizes(op_chain)});
+  std::vector<double> objs;
+  for (size_t i = 0; i < dims_order_trees.size(); ++i) {
+    double obj = FLT_MAX;
+    bool screened = min_costs[i].min_mem_footprint > mem_size;
+    if (!screened) {
+      op_chain->setOrder(dims_order_trees[i].getOrderInfos());
+      obj = optimizeBlockSize(op_chain, mem_size);
+    }
+    objs.push_back(obj);
+    if (options().save_log_file >= 3) {
+      writeDimOrderLog(op_chain, dims_order_trees[i], mem_size, obj,
+                       screened ? min_costs[i].min_mem_footprint : -1);
+    }
+  }
+  return objs;
+}
+
 bool geneticDimOrder(OperatorChain *op_chain,
                      long mem_size,
                      double &best_obj,
@@ -746,104 +839,36 @@ bool geneticDimOrder(OperatorChain *op_chain,
   const size_t k = 5;
   OperatorTree top_k_dims_orders[k];
   double top_k_objs[k] = {FLT_MAX};
+  std::vector<OperatorTree> init_dims_orders;
   for (int i = 0; i < k; ++i) {
-    top_k_dims_orders[i] = generateRandomTreeOrder(op_tree);
-    op_chain->setOrder(top_k_dims_orders[i].getOrderInfos());
-    top_k_objs[i] = optimizeBlockSize(op_chain, mem_size);
-    if (Options::save_log_file >= 3) {
-      auto dims_orders_candidate = top_k_dims_orders[i];
-      auto obj_candidate = top_k_objs[i];
-      op_chain->setOrder(dims_orders_candidate.getOrderInfos());
-      LogRecord3 log_record;
-      log_record.id = 3;
-      log_record.defineAlgroithm(op_chain->getOperators());
-      log_record.mem_size = mem_size;
-      log_record.recordFuseStatus(op_chain->getExternalTensors());
-      for (auto op : dims_orders_candidate.getNodes()) {
-        log_record.recordDimOrder(op->getDimsOrder());
-      }
-      log_record.mem_footprint = op_chain->getMemFootprint();
-      if (obj_candidate == FLT_MAX) {
-        log_record.mem_access_volume = -1;
-        log_record.compute_time = -1;
-      } else {
-        log_record.mem_access_volume = op_chain->getMemAccessVolume();
-        log_record.compute_time = op_chain->compute_time();
-      }
-      log_record.writeToFile(Options::log_directory + "/log3.csv");
-    }
+    init_dims_orders.push_back(generateRandomTreeOrder(op_tree));
+  }
+  std::vector<double> init_objs = optimizeBlockSizeOfOrders(op_chain, init_dims_orders, mem_size);
+  for (int i = 0; i < k; ++i) {
+    top_k_dims_orders[i] = init_dims_orders[i];
+    top_k_objs[i] = init_objs[i];
   }
   // genetic
   for (int i = 0; i < generations; ++i) {
     // generate candidates
     std::vector<OperatorTree> dims_orders_candidates;
+    std::vector<OperatorTree> new_dims_orders;
     std::vector<double> obj_candidates;
     for (int ii = 0; ii < k; ++ii) {
       dims_orders_candidates.push_back(top_k_dims_orders[ii]);
       obj_candidates.push_back(top_k_objs[ii]);
     }
     for (auto &top_k_dims_order : top_k_dims_orders) {
-      OperatorTree order_candidate = generateRandomTreeOrder(top_k_dims_order);
-//      if (isInferior(op_chain, order_candidate, top_k_dims_order)) {
-//        obj_candidates.push_back(INFINITY);
-//      } else {
-      op_chain->setOrder(order_candidate.getOrderInfos());
-      obj_candidates.push_back(optimizeBlockSize(op_chain, mem_size));
-//      }
-      dims_orders_candidates.push_back(order_candidate);
-      if (Options::save_log_file >= 3) {
-        auto dims_orders_candidate = dims_orders_candidates.back();
-        auto obj_candidate = obj_candidates.back();
-        op_chain->setOrder(dims_orders_candidate.getOrderInfos());
-        LogRecord3 log_record;
-        log_record.id = 3;
-        log_record.defineAlgroithm(op_chain->getOperators());
-        log_record.mem_size = mem_size;
-        log_record.recordFuseStatus(op_chain->getExternalTensors());
-        for (auto op : dims_orders_candidate.getNodes()) {
-          log_record.recordDimOrder(op->getDimsOrder());
-        }
-        log_record.mem_footprint = op_chain->getMemFootprint();
-        if (obj_candidate == FLT_MAX) {
-          log_record.mem_access_volume = -1;
-          log_record.compute_time = -1;
-        } else {
-          log_record.mem_access_volume = op_chain->getMemAccessVolume();
-          log_record.compute_time = op_chain->compute_time();
-        }
-        log_record.writeToFile(Options::log_directory + "/log3.csv");
-      }
+      new_dims_orders.push_back(generateRandomTreeOrder(top_k_dims_order));
       for (int c = 0; c < 4; ++c) {
-        int select_node_index = dis(rng) % (top_k_dims_order.getNodes().size());
-        order_candidate = selectOneNodeAndChangeDimsOrder(top_k_dims_order,
-                                                          top_k_dims_order.getNodes()[select_node_index]);
-        op_chain->setOrder(order_candidate.getOrderInfos());
-        obj_candidates.push_back(optimizeBlockSize(op_chain, mem_size));
-        dims_orders_candidates.push_back(order_candidate);
-        if (Options::save_log_file >= 3) {
-          auto dims_orders_candidate = dims_orders_candidates.back();
-          auto obj_candidate = obj_candidates.back();
-          op_chain->setOrder(dims_orders_candidate.getOrderInfos());
-          LogRecord3 log_record;
-          log_record.id = 3;
-          log_record.defineAlgroithm(op_chain->getOperators());
-          log_record.mem_size = mem_size;
-          log_record.recordFuseStatus(op_chain->getExternalTensors());
-          for (auto op : dims_orders_candidate.getNodes()) {
-            log_record.recordDimOrder(op->getDimsOrder());
-          }
-          log_record.mem_footprint = op_chain->getMemFootprint();
-          if (obj_candidate == FLT_MAX) {
-            log_record.mem_access_volume = -1;
-            log_record.compute_time = -1;
-          } else {
-            log_record.mem_access_volume = op_chain->getMemAccessVolume();
-            log_record.compute_time = op_chain->compute_time();
-          }
-          log_record.writeToFile(Options::log_directory + "/log3.csv");
-        }
+        int select_node_index = dis(rng()) % (top_k_dims_order.getNodes().size());
+        new_dims_orders.push_back(selectOneNodeAndChangeDimsOrder(top_k_dims_order,
+                                                                  top_k_dims_order.getNodes()[select_node_index]));
       }
     }
+    std::vector<double> new_objs = optimizeBlockSizeOfOrders(op_chain, new_dims_orders, mem_size);
+    dims_orders_candidates.insert(dims_orders_candidates.end(), new_dims_orders.begin(), new_dims_orders.end());
+    obj_candidates.insert(obj_candidates.end(), new_objs.begin(), new_objs.end());
     assert(dims_orders_candidates.size() == obj_candidates.size());
     // find the top k and update
     auto top_k_indices = findTopKIndices(obj_candidates, k);
@@ -871,34 +896,20 @@ bool randomDimOrder(OperatorChain *op_chain,
   bool infeasible = true;
   OperatorTree op_tree = op_chain->getOperatorTree();
 
-  for (size_t n = 0; n < times; ++n) {
-    op_tree = generateRandomTreeOrder(op_tree);
-    op_chain->setOrder(op_tree.getOrderInfos());
-    double obj = DAT::optimizeBlockSize(op_chain, mem_size);
-    if (obj < best_obj) {
-      best_obj = obj;
-      best_dims_order_tree = op_tree;
-      infeasible = false;
-    }
-    if (Options::save_log_file >= 3) {
-      op_chain->setOrder(op_tree.getOrderInfos());
-      LogRecord3 log_record;
-      log_record.id = 3;
-      log_record.defineAlgroithm(op_chain->getOperators());
-      log_record.mem_size = mem_size;
-      log_record.recordFuseStatus(op_chain->getExternalTensors());
-      for (auto op : op_tree.getNodes()) {
-        log_record.recordDimOrder(op->getDimsOrder());
-      }
-      log_record.mem_footprint = op_chain->getMemFootprint();
-      if (obj == FLT_MAX) {
-        log_record.mem_access_volume = -1;
-        log_record.compute_time = -1;
-      } else {
-        log_record.mem_access_volume = op_chain->getMemAccessVolume();
-        log_record.compute_time = op_chain->compute_time();
+  const size_t batch_size = 256;
+  for (size_t n = 0; n < times; n += batch_size) {
+    std::vector<OperatorTree> dims_orders;
+    for (size_t nn = n; nn < std::min(times, n + batch_size); ++nn) {
+      op_tree = generateRandomTreeOrder(op_tree);
+      dims_orders.push_back(op_tree);
+    }
+    std::vector<double> objs = optimizeBlockSizeOfOrders(op_chain, dims_orders, mem_size);
+    for (size_t nn = 0; nn < dims_orders.size(); ++nn) {
+      if (objs[nn] < best_obj) {
+        best_obj = objs[nn];
+        best_dims_order_tree = dims_orders[nn];
+        infeasible = false;
       }
-      log_record.writeToFile(Options::log_directory + "/log3.csv");
     }
   }
 
@@ -930,6 +941,12 @@ bool traversalDimOrder(OperatorChain *op_chain,
       root_dims_order_constraint.push_back(root_dims_vec.at(ind));
     }
     op_root->setDimsOrderConstraint(root_dims_order_constraint);
+    // the other sinks of a DAG have all dims free
+    for (auto r : op_tree.getRoots()) {
+      if (r != op_root) {
+        r->setDimsOrderConstraint({});
+      }
+    }
 
     const std::vector<OperatorNode *> op_nodes = op_tree.getNodes();
     size_t op_nodes_size = op_nodes.size();
@@ -964,7 +981,7 @@ bool traversalDimOrder(OperatorChain *op_chain,
           best_free_dims_offsets = free_dims_offsets;
           infeasible = false;
         }
-        if (Options::save_log_file >= 3) {
+        if (options().save_log_file >= 3) {
           op_chain->setDimsOrder(root_dims_order_constraint, free_dims_offsets);
           LogRecord3 log_record;
           log_record.id = 3;
@@ -982,19 +999,25 @@ bool traversalDimOrder(OperatorChain *op_chain,
             log_record.mem_access_volume = op_chain->getMemAccessVolume();
             log_record.compute_time = op_chain->compute_time();
           }
-          log_record.writeToFile(Options::log_directory + "/log3.csv");
+          log_record.writeToFile(options().log_directory + "/log3.csv");
         }
 
         nodes_index--;
         offsets_index.at(nodes_index)--;
+        // a node without free dims, e.g. an element-wise operator fused into its parent, has a
+        // single order and is passed over
         while (nodes_index >= 0
-            && free_dims_offsets.at(nodes_index).at(offsets_index.at(nodes_index))
-                >= constraint_dims_num.at(nodes_index) + offsets_index.at(nodes_index)) {
+            && (offsets_index.at(nodes_index) < 0
+                || free_dims_offsets.at(nodes_index).at(offsets_index.at(nodes_index))
+                    >= constraint_dims_num.at(nodes_index) + offsets_index.at(nodes_index))) {
           if (offsets_index.at(nodes_index) > 0) {
             free_dims_offsets.at(nodes_index).at(offsets_index.at(nodes_index)) = 0;
             offsets_index.at(nodes_index)--;
           } else {
-            free_dims_offsets.at(nodes_index).at(offsets_index.at(nodes_index)) = 0;
+            if (offsets_index.at(nodes_index) == 0) {
+              free_dims_offsets.at(nodes_index).at(0) = 0;
+            }
+            offsets_index.at(nodes_index) = 0;
             nodes_index--;
             if (nodes_index >= 0)
               offsets_index.at(nodes_index)--;
@@ -1025,6 +1048,34 @@ bool traversalDimOrder(OperatorChain *op_chain,
   return infeasible;
 }
 
+// The producers of node which may run once node is ranked: a producer runs before all its
+// consumers, and a larger execute rank runs earlier. Unranked nodes have a rank of -1.
+std::vector<OperatorNode *> readyProducers(const OperatorTree &op_tree, OperatorNode *node) {
+  auto o_infos = op_tree.getOrderInfos();
+  std::vector<OperatorNode *> ready;
+  for (auto p : node->getProducers()) {
+    auto consumers = p->getConsumers();
+    if (std::all_of(consumers.begin(), consumers.end(),
+                    [&o_infos](OperatorNode *c) { return o_infos[c].execute_rank >= 0; })) {
+      ready.push_back(p);
+    }
+  }
+  return ready;
+}
+
+// The tree of op_chain with no node ranked, and the nodes which may run last: the sinks.
+OperatorTree unrankedTree(OperatorChain *op_chain, std::set<OperatorNode *> &init_options) {
+  OperatorTree op_tree = op_chain->getOperatorTree();
+  auto o_infos = op_tree.getOrderInfos();
+  for (auto node : op_tree.getNodes()) {
+    o_infos[node].execute_rank = -1;
+  }
+  op_tree.setOrderInfos(o_infos);
+  auto roots = op_tree.getRoots();
+  init_options.insert(roots.begin(), roots.end());
+  return op_tree;
+}
+
 bool randomExecuteOrder(OperatorChain *op_chain,
                             long mem_size,
                             double &best_obj,
@@ -1036,7 +1087,7 @@ bool randomExecuteOrder(OperatorChain *op_chain,
   std::set<OperatorNode *> new_options = current_options;
   while (!new_options.empty()) {
     std::uniform_int_distribution<> dist(0, new_options.size() - 1);
-    int randomIndex = dist(rng);
+    int randomIndex = dist(rng());
     auto it = new_options.begin();
     std::advance(it, randomIndex);
     auto select_node = *it;
@@ -1044,10 +1095,8 @@ bool randomExecuteOrder(OperatorChain *op_chain,
     order_info[select_node].execute_rank = rank;
     op_tree.setOrderInfos(order_info);
     new_options.erase(select_node);
-    for (auto c : select_node->getChildren()) {
-      if (c) {
-        new_options.insert(c);
-      }
+    for (auto p : readyProducers(op_tree, select_node)) {
+      new_options.insert(p);
     }
   }
     {
@@ -1057,7 +1106,7 @@ bool randomExecuteOrder(OperatorChain *op_chain,
       op_chain->setOrder(op_tree.getOrderInfos());
           sub_infeasible =
               DAT::randomDimOrder(op_chain, mem_size, sub_best_obj, best_dims_order_tree, 1);
-      if (Options::save_log_file >= 3) {
+      if (options().save_log_file >= 3) {
         LogRecord5 log_record;
         log_record.id = 5;
         log_record.defineAlgroithm(op_chain->getOperators());
@@ -1076,8 +1125,8 @@ bool randomExecuteOrder(OperatorChain *op_chain,
           log_record.compute_time = op_chain->compute_time();
           log_record.mem_footprint = op_chain->getMemFootprint();
         }
-        log_record.writeToFile(Options::log_directory + "/log3exec.csv");
-        log_record.writeExecTree(Options::log_directory + "/log3tree.csv");
+        log_record.writeToFile(options().log_directory + "/log3exec.csv");
+        log_record.writeExecTree(options().log_directory + "/log3tree.csv");
       }
       if (!sub_infeasible) {
         infeasible = false;
@@ -1104,10 +1153,8 @@ bool travsersalExecuteOrder(OperatorChain *op_chain,
     op_tree.setOrderInfos(order_info);
     std::set<OperatorNode *> new_options = current_options;
     new_options.erase(select_node);
-    for (auto c : select_node->getChildren()) {
-      if (c) {
-        new_options.insert(c);
-      }
+    for (auto p : readyProducers(op_tree, select_node)) {
+      new_options.insert(p);
     }
     if (!new_options.empty()) {
       infeasible = travsersalExecuteOrder(op_chain, mem_size, best_obj, best_order_tree,
@@ -1120,13 +1167,13 @@ bool travsersalExecuteOrder(OperatorChain *op_chain,
       if (op_chain->getDims().size() <= 7) {
         sub_infeasible = traversalDimOrder(op_chain, mem_size, sub_best_obj, best_dims_order_tree);
       } else {
-        if (Options::dim_order_opt == "traversal") {
+        if (options().dim_order_opt == "traversal") {
           sub_infeasible =
               traversalDimOrder(op_chain, mem_size, sub_best_obj, best_dims_order_tree);
-        } else if (DAT::Options::dim_order_opt == "random") {
+        } else if (DAT::options().dim_order_opt == "random") {
           sub_infeasible =
               DAT::randomDimOrder(op_chain, mem_size, sub_best_obj, best_dims_order_tree, 6000);
-        } else if (DAT::Options::dim_order_opt == "genetic") {
+        } else if (DAT::options().dim_order_opt == "genetic") {
           sub_infeasible =
               DAT::geneticDimOrder(op_chain, mem_size, sub_best_obj, best_dims_order_tree, 200);
         } else {
@@ -1136,7 +1183,7 @@ bool travsersalExecuteOrder(OperatorChain *op_chain,
               traversalDimOrder(op_chain, mem_size, sub_best_obj, best_dims_order_tree);
         }
       }
-      if (Options::save_log_file >= 3) {
+      if (options().save_log_file >= 3) {
         LogRecord5 log_record;
         log_record.id = 5;
         log_record.defineAlgroithm(op_chain->getOperators());
@@ -1158,8 +1205,8 @@ bool travsersalExecuteOrder(OperatorChain *op_chain,
           log_record.compute_time = op_chain->compute_time();
           log_record.mem_footprint = op_chain->getMemFootprint();
         }
-        log_record.writeToFile(Options::log_directory + "/log3exec.csv");
-        log_record.writeExecTree(Options::log_directory + "/log3tree.csv");
+        log_record.writeToFile(options().log_directory + "/log3exec.csv");
+        log_record.writeExecTree(options().log_directory + "/log3tree.csv");
       }
       if (!sub_infeasible) {
         infeasible = false;
@@ -1178,9 +1225,8 @@ bool randomOrder(OperatorChain *op_chain,
                    double &best_obj,
                    OperatorTree &best_order_tree) {
   bool infeasible = true;
-  OperatorTree op_tree = op_chain->getOperatorTree();
   std::set<OperatorNode *> init_option;
-  init_option.insert(op_tree.getRoot());
+  OperatorTree op_tree = unrankedTree(op_chain, init_option);
   infeasible = randomExecuteOrder(op_chain, mem_size, best_obj, best_order_tree, op_tree,
                                       init_option, 0);
   if (!infeasible)
@@ -1193,9 +1239,8 @@ bool optimizeOrder(OperatorChain *op_chain,
                    double &best_obj,
                    OperatorTree &best_order_tree) {
   bool infeasible = true;
-  OperatorTree op_tree = op_chain->getOperatorTree();
   std::set<OperatorNode *> init_option;
-  init_option.insert(op_tree.getRoot());
+  OperatorTree op_tree = unrankedTree(op_chain, init_option);
   infeasible = travsersalExecuteOrder(op_chain, mem_size, best_obj, best_order_tree, op_tree,
                                       init_option, 0);
   if (!infeasible)
@@ -1203,35 +1248,71 @@ bool optimizeOrder(OperatorChain *op_chain,
   return infeasible;
 }
 
+// optimizeOrder, reusing the result of the same chain from the order cache of the context.
+bool optimizeOrderCached(OperatorChain *op_chain,
+                         long mem_size,
+                         double &best_obj,
+                         OperatorTree &best_order_tree) {
+  std::shared_ptr<OrderCache> order_cache = currentContext().order_cache;
+  std::string key = order_cache ? OrderCache::key(op_chain, mem_size) : "";
+  if (key.empty()) {
+    return optimizeOrder(op_chain, mem_size, best_obj, best_order_tree);
+  }
+  OrderCache::Entry entry;
+  if (order_cache->lookup(key, entry)) {
+    if (!entry.infeasible && entry.obj < best_obj) {
+      best_obj = entry.obj;
+      best_order_tree = OrderCache::toOrderTree(op_chain, entry);
+      op_chain->setOrder(best_order_tree.getOrderInfos());
+    }
+    return entry.infeasible;
+  }
+  double obj = FLT_MAX;
+  OperatorTree order_tree = op_chain->getOperatorTree();
+  bool infeasible = optimizeOrder(op_chain, mem_size, obj, order_tree);
+  order_cache->store(key, OrderCache::toEntry(infeasible, obj, order_tree));
+  if (!infeasible && obj < best_obj) {
+    best_obj = obj;
+    best_order_tree = order_tree;
+  }
+  return infeasible;
+}
+
 long createToOperatorChain(OperatorChain *op_chain[],
                            std::set<DAT::TensorOperator *> non_add_to_operator_chain,
                            const std::set<DAT::Tensor *> &tensors) {
 
-  std::set<DAT::TensorOperator *> add_to_operator_chain;
-  long operator_chain_num = 0;
+  // operators linked by fused tensors, directly or through other operators, form one chain
+  std::vector<std::set<DAT::TensorOperator *> > chain_operators;
   for (auto t : tensors) {
     if ((!t->isIO()) && t->isFused()) {
+      std::set<DAT::TensorOperator *> linked;
       for (auto to : non_add_to_operator_chain) {
         if (to->hasTensor(t)) {
-          bool add_to_exist_operator_chain = false;
-          for (long n = 0; n < operator_chain_num; ++n) {
-            if (op_chain[n]->hasTensor(t)) {
-              add_to_exist_operator_chain = true;
-              op_chain[n]->addOperator(to);
-            }
-          }
-          if (!add_to_exist_operator_chain) {
-            op_chain[operator_chain_num] = new DAT::OperatorChain;
-            op_chain[operator_chain_num]->addOperator(to);
-            operator_chain_num++;
-          }
-          add_to_operator_chain.insert(to);
+          linked.insert(to);
         }
       }
-      for (auto rop : add_to_operator_chain) {
-        non_add_to_operator_chain.erase(rop);
+      for (auto it = chain_operators.begin(); it != chain_operators.end();) {
+        bool overlap = std::any_of(it->begin(), it->end(),
+                                   [&linked](DAT::TensorOperator *to) { return linked.count(to) > 0; });
+        if (overlap) {
+          linked.insert(it->begin(), it->end());
+          it = chain_operators.erase(it);
+        } else {
+          ++it;
+        }
       }
+      chain_operators.push_back(linked);
+    }
+  }
+  long operator_chain_num = 0;
+  for (const auto &ops : chain_operators) {
+    op_chain[operator_chain_num] = new DAT::OperatorChain;
+    for (auto to : ops) {
+      op_chain[operator_chain_num]->addOperator(to);
+      non_add_to_operator_chain.erase(to);
     }
+    operator_chain_num++;
   }
   for (auto to : non_add_to_operator_chain) {
     op_chain[operator_chain_num] = new DAT::OperatorChain;
@@ -1264,6 +1345,15 @@ long createToOperatorChain(OperatorChain *op_chain[],
 
 }
 
+// The number of fuse patterns of tensor_num tensors, enumerated as the bits of a long.
+long fusePatternNum(size_t tensor_num) {
+  if (tensor_num >= 63) {
+    throw std::invalid_argument("the fuse patterns of " + std::to_string(tensor_num)
+                                    + " tensors can not be enumerated, use --fuse_search greedy or dp");
+  }
+  return 1L << tensor_num;
+}
+
 long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
                  const std::set<DAT::Tensor *> &tensors,
                  long mem_size,
@@ -1281,14 +1371,13 @@ long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
       t->unsetFuse();
     }
   }
-  long situation_num = pow(2, non_io_tensors.size());
+  long situation_num = fusePatternNum(non_io_tensors.size());
 
-  std::uniform_int_distribution<std::mt19937::result_type> dist_f(0, situation_num);
+  std::uniform_int_distribution<long> dist_f(0, situation_num - 1);
   {
-  long f = dist_f(rng);
-  assert(tensors.size() <= MAX_TENSOR_NUM);
-  DAT::OperatorChain *op_chain[MAX_TENSOR_NUM] = {nullptr};
-  std::bitset<MAX_TENSOR_NUM> fuse_or_not(f);
+  long f = dist_f(rng());
+  std::vector<DAT::OperatorChain *> op_chain(non_add_to_operator_chain.size(), nullptr);
+  FusePattern fuse_or_not(non_io_tensors.size(), f);
   long f_i = 0;
   for (auto t : non_io_tensors) {
     if (fuse_or_not[f_i]) {
@@ -1299,7 +1388,7 @@ long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
     ++f_i;
   }
   LogRecord6 log_record;
-  if (Options::save_log_file >= 2) {
+  if (options().save_log_file >= 2) {
     log_record.id = 2;
     log_record.defineAlgroithm(non_add_to_operator_chain);
     log_record.mem_size = mem_size;
@@ -1309,7 +1398,7 @@ long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
   if (print_log)
     std::cout << "----------------situation " << f << "-----------------" << std::endl;
   long operator_chain_num =
-      DAT::createToOperatorChain(op_chain, non_add_to_operator_chain, tensors);
+      DAT::createToOperatorChain(op_chain.data(), non_add_to_operator_chain, tensors);
   long total_access_volume = 0;
   long mem_footprint = 0;
   long infeasible = 0;
@@ -1322,13 +1411,13 @@ long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
     OperatorTree sub_best_order_tree = mul_chain->getOperatorTree();
     long sub_best_access_volume = LONG_MAX;
     long sub_mem_footprint = 0;
-    long sub_situation_num = pow(2, external_tensors_num);
+    long sub_situation_num = fusePatternNum(external_tensors_num);
     bool sub_infeasible = true;
-    std::uniform_int_distribution<std::mt19937::result_type> dist_sf(0, sub_situation_num);
-    long sf = dist_sf(rng);
+    std::uniform_int_distribution<long> dist_sf(0, sub_situation_num - 1);
+    long sf = dist_sf(rng());
     mul_chain->setExternalTensorsFusePattern(sf);
     LogRecord2 sub_log_record;
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       sub_log_record.id = 2;
       sub_log_record.defineAlgroithm(mul_chain->getOperators());
       sub_log_record.mem_size = mem_size;
@@ -1354,19 +1443,19 @@ long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
         sub_best_access_volume = mem_access_volume;
         sub_mem_footprint = mul_chain->getMemFootprint();
       }
-      if (Options::save_log_file >= 2) {
+      if (options().save_log_file >= 2) {
         sub_log_record.mem_access_volume = mem_access_volume;
         sub_log_record.compute_time = mul_chain->compute_time();
         sub_log_record.mem_footprint = mul_chain->getMemFootprint();
       }
     } else {
-      if (Options::save_log_file >= 2) {
+      if (options().save_log_file >= 2) {
         sub_log_record.mem_access_volume = -1;
         sub_log_record.compute_time = -1;
       }
     }
-    if (Options::save_log_file >= 2) {
-      sub_log_record.writeToFile(Options::log_directory + "/log2s.csv");
+    if (options().save_log_file >= 2) {
+      sub_log_record.writeToFile(options().log_directory + "/log2s.csv");
     }
     if (!sub_infeasible) {
       if (print_log) {
@@ -1399,7 +1488,7 @@ long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
         *(best_op_chain[i]) = *(op_chain[i]);
       }
     }
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.mem_access_volume = total_access_volume;
       log_record.mem_footprint = mem_footprint;
     }
@@ -1408,14 +1497,14 @@ long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
       std::cout << "best total access volume: " << best_total_access_volume << std::endl;
     }
   } else {
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.mem_access_volume = -1;
     }
     if (print_log)
       std::cerr << "Can not use this fuse pattern with mem_size: " << mem_size << std::endl;
   }
 
-  if (Options::save_log_file >= 2) {
+  if (options().save_log_file >= 2) {
     long total_compute_time = 0;
     for (long i = 0; i < operator_chain_num; ++i) {
       op_chain[i]->setInternalTensorsFuse();
@@ -1430,7 +1519,7 @@ long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
       total_compute_time += op_chain[i]->compute_time();
     }
     log_record.compute_time = total_compute_time;
-    log_record.writeToFile(Options::log_directory + "/log2.csv");
+    log_record.writeToFile(options().log_directory + "/log2.csv");
   }
   for (long i = 0; i < operator_chain_num; ++i) {
     delete op_chain[i];
@@ -1439,7 +1528,7 @@ long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
 
 }
 
-  std::bitset<MAX_TENSOR_NUM> fuse_or_not(best_fuse_pattern);
+  FusePattern fuse_or_not(non_io_tensors.size(), best_fuse_pattern);
   long f_i = 0;
   for (auto t : non_io_tensors) {
     if (fuse_or_not[f_i]) {
@@ -1453,14 +1542,50 @@ long randomFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
 
 }
 
+// The cost of an operator chain the search minimizes, per options().objective.
+long objectiveValue(OperatorChain *op_chain) {
+  if (options().objective == "latency") {
+    return op_chain->latency();
+  }
+  return op_chain->getMemAccessVolume();
+}
+
+// Whether the dims orders of every chain are traversed: chains of more than 7 dims take the
+// random or the genetic search if options().dim_order_opt asks for it.
+bool isExhaustiveDimOrderOpt() {
+  return options().dim_order_opt != "random" && options().dim_order_opt != "genetic";
+}
+
+// What the exploration of a graph at a larger mem_size proves about a smaller one: a fuse
+// pattern or sub fuse pattern infeasible there is infeasible here, and its cost there is a lower
+// bound of its cost here. Both hold as long as the order search is exact, so traversalFused
+// ignores the bounds unless isExhaustiveDimOrderOpt.
+struct FuseBounds {
+  static constexpr long infeasible = -1;
+  // fuse pattern -> cost, see objectiveValue
+  std::map<long, long> pattern_costs;
+  // (fuse pattern, operator chain index, sub fuse pattern) -> cost
+  std::map<std::tuple<long, long, long>, long> sub_pattern_costs;
+  // explored first to seed the incumbent, the best fuse pattern of the last exploration
+  long seed_pattern{-1};
+  long skipped_pattern_num{0};
+  long skipped_sub_pattern_num{0};
+};
+
 long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
                     const std::set<DAT::Tensor *> &tensors,
                     long mem_size,
                     DAT::OperatorChain *best_op_chain[],
-                    bool print_log = false) {
+                    bool print_log = false,
+                    FuseBounds *bounds = nullptr,
+                    ParetoArchive *archive = nullptr) {
   long best_operator_chain_num = 0;
   long best_fuse_pattern = 0;
-  long best_total_access_volume = LONG_MAX;
+  long best_total_cost = LONG_MAX;
+  // a sampled dims order may miss the best one, so its costs bound nothing
+  if (!isExhaustiveDimOrderOpt()) {
+    bounds = nullptr;
+  }
 
   std::set<Tensor *> non_io_tensors;
   for (auto t : tensors) {
@@ -1470,12 +1595,28 @@ long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_c
       t->unsetFuse();
     }
   }
-  long situation_num = pow(2, non_io_tensors.size());
+  long situation_num = fusePatternNum(non_io_tensors.size());
 
+  std::vector<long> fuse_patterns;
+  if (bounds && bounds->seed_pattern >= 0 && bounds->seed_pattern < situation_num) {
+    fuse_patterns.push_back(bounds->seed_pattern);
+  }
   for (long f = 0; f < situation_num; f++) {
-    assert(tensors.size() <= MAX_TENSOR_NUM);
-    DAT::OperatorChain *op_chain[MAX_TENSOR_NUM] = {nullptr};
-    std::bitset<MAX_TENSOR_NUM> fuse_or_not(f);
+    if (fuse_patterns.empty() || f != fuse_patterns.front()) {
+      fuse_patterns.push_back(f);
+    }
+  }
+
+  for (long f : fuse_patterns) {
+    if (bounds && bounds->pattern_costs.count(f)) {
+      long bound = bounds->pattern_costs[f];
+      if (bound == FuseBounds::infeasible || bound >= best_total_cost) {
+        ++bounds->skipped_pattern_num;
+        continue;
+      }
+    }
+    std::vector<DAT::OperatorChain *> op_chain(non_add_to_operator_chain.size(), nullptr);
+    FusePattern fuse_or_not(non_io_tensors.size(), f);
     long f_i = 0;
     for (auto t : non_io_tensors) {
       if (fuse_or_not[f_i]) {
@@ -1486,7 +1627,7 @@ long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_c
       ++f_i;
     }
     LogRecord6 log_record;
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.id = 2;
       log_record.defineAlgroithm(non_add_to_operator_chain);
       log_record.mem_size = mem_size;
@@ -1496,25 +1637,48 @@ long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_c
     if (print_log)
       std::cout << "----------------situation " << f << "-----------------" << std::endl;
     long operator_chain_num =
-        DAT::createToOperatorChain(op_chain, non_add_to_operator_chain, tensors);
+        DAT::createToOperatorChain(op_chain.data(), non_add_to_operator_chain, tensors);
     long total_access_volume = 0;
+    long total_cost = 0;
     long mem_footprint = 0;
     long infeasible = 0;
+    bool pruned = false;
+    // the non-dominated schedules of this fuse pattern, built up chain by chain
+    ParetoArchive pattern_archive;
+    if (archive) {
+      std::string fused;
+      for (auto t : non_io_tensors) {
+        if (t->isFused()) {
+          fused += (fused.empty() ? "" : ",") + t->getName();
+        }
+      }
+      pattern_archive.insert({0, 0, 0, "fused{" + fused + "}"});
+    }
     for (long i = 0; i < operator_chain_num; ++i) {
       DAT::OperatorChain *mul_chain = op_chain[i];
       const size_t dims_num = mul_chain->getDims().size();
       const std::set<Tensor *> external_tensors = mul_chain->getExternalTensors();
+      ParetoArchive chain_archive;
       const size_t external_tensors_num = external_tensors.size();
       long sub_best_fuse_pattern = 0;
       OperatorTree sub_best_order_tree = mul_chain->getOperatorTree();
       long sub_best_access_volume = LONG_MAX;
+      long sub_best_cost = LONG_MAX;
       long sub_mem_footprint = 0;
-      long sub_situation_num = pow(2, external_tensors_num);
+      long sub_situation_num = fusePatternNum(external_tensors_num);
       bool sub_infeasible = true;
       for (long sf = 0; sf < sub_situation_num; sf++) {
+        auto sub_key = std::make_tuple(f, i, sf);
+        if (bounds && bounds->sub_pattern_costs.count(sub_key)) {
+          long bound = bounds->sub_pattern_costs[sub_key];
+          if (bound == FuseBounds::infeasible || bound >= sub_best_cost) {
+            ++bounds->skipped_sub_pattern_num;
+            continue;
+          }
+        }
         mul_chain->setExternalTensorsFusePattern(sf);
         LogRecord2 sub_log_record;
-        if (Options::save_log_file >= 2) {
+        if (options().save_log_file >= 2) {
           sub_log_record.id = 2;
           sub_log_record.defineAlgroithm(mul_chain->getOperators());
           sub_log_record.mem_size = mem_size;
@@ -1526,32 +1690,53 @@ long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_c
         double best_obj = FLT_MAX;
         OperatorTree best_op_tree = mul_chain->getOperatorTree();
         bool sf_infeasible = true;
-        sf_infeasible = optimizeOrder(mul_chain, mem_size, best_obj, best_op_tree);
+        sf_infeasible = optimizeOrderCached(mul_chain, mem_size, best_obj, best_op_tree);
         if (!sf_infeasible) {
           sub_infeasible = false;
           mul_chain->setOrder(best_op_tree.getOrderInfos());
           DAT::optimizeBlockSize(mul_chain, mem_size);
           mul_chain->setOrder(best_op_tree.getOrderInfos());
           long mem_access_volume = mul_chain->getMemAccessVolume();
-          if (mem_access_volume < sub_best_access_volume) {
+          long cost = objectiveValue(mul_chain);
+          if (archive) {
+            std::string ops, fused;
+            for (auto op : mul_chain->getOperators()) {
+              ops += (ops.empty() ? "" : ",") + op->getName();
+            }
+            for (auto t : mul_chain->getExternalTensors()) {
+              if (t->isFused()) {
+                fused += (fused.empty() ? "" : ",") + t->getName();
+              }
+            }
+            chain_archive.insert({mem_access_volume, mul_chain->getMemFootprint(),
+                                  mul_chain->compute_time(), "(" + ops + " fused{" + fused + "})"});
+          }
+          if (bounds) {
+            bounds->sub_pattern_costs[sub_key] = cost;
+          }
+          if (cost < sub_best_cost) {
             sub_best_fuse_pattern = sf;
             sub_best_order_tree = best_op_tree;
             sub_best_access_volume = mem_access_volume;
+            sub_best_cost = cost;
             sub_mem_footprint = mul_chain->getMemFootprint();
           }
-          if (Options::save_log_file >= 2) {
+          if (options().save_log_file >= 2) {
             sub_log_record.mem_access_volume = mem_access_volume;
             sub_log_record.compute_time = mul_chain->compute_time();
             sub_log_record.mem_footprint = mul_chain->getMemFootprint();
           }
         } else {
-          if (Options::save_log_file >= 2) {
+          if (bounds) {
+            bounds->sub_pattern_costs[sub_key] = FuseBounds::infeasible;
+          }
+          if (options().save_log_file >= 2) {
             sub_log_record.mem_access_volume = -1;
             sub_log_record.compute_time = -1;
           }
         }
-        if (Options::save_log_file >= 2) {
-          sub_log_record.writeToFile(Options::log_directory + "/log2s.csv");
+        if (options().save_log_file >= 2) {
+          sub_log_record.writeToFile(options().log_directory + "/log2s.csv");
         }
       }
       if (!sub_infeasible) {
@@ -1561,6 +1746,7 @@ long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_c
           std::cout << "SRAM footprint: " << sub_mem_footprint << std::endl;
         }
         total_access_volume += sub_best_access_volume;
+        total_cost += sub_best_cost;
         mem_footprint = std::max(mem_footprint, sub_mem_footprint);
         mul_chain->recordExternalTensorsFuseInfo(sub_best_fuse_pattern);
         mul_chain->recordOrder(sub_best_order_tree.getOrderInfos());
@@ -1570,14 +1756,37 @@ long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_c
         }
       }
       infeasible += sub_infeasible;
+      if (archive && !sub_infeasible) {
+        pattern_archive = ParetoArchive::sequence(pattern_archive, chain_archive);
+      }
+      // the rest operator chains can only add to the cost
+      if (bounds && i + 1 < operator_chain_num
+          && (infeasible || total_cost >= best_total_cost)) {
+        pruned = true;
+        break;
+      }
+    }
+    if (bounds) {
+      bounds->pattern_costs[f] = infeasible ? FuseBounds::infeasible : total_cost;
+    }
+    if (pruned) {
+      ++bounds->skipped_pattern_num;
+      for (long i = 0; i < operator_chain_num; ++i) {
+        delete op_chain[i];
+        op_chain[i] = nullptr;
+      }
+      continue;
     }
     if (!infeasible) {
-      if (total_access_volume < best_total_access_volume) {
+      if (archive) {
+        archive->insert(pattern_archive);
+      }
+      if (total_cost < best_total_cost) {
         for (long i = 0; i < best_operator_chain_num; ++i) {
           delete best_op_chain[i];
           best_op_chain[i] = nullptr;
         }
-        best_total_access_volume = total_access_volume;
+        best_total_cost = total_cost;
         best_operator_chain_num = operator_chain_num;
         best_fuse_pattern = f;
         for (long i = 0; i < operator_chain_num; ++i) {
@@ -1585,23 +1794,23 @@ long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_c
           *(best_op_chain[i]) = *(op_chain[i]);
         }
       }
-      if (Options::save_log_file >= 2) {
+      if (options().save_log_file >= 2) {
         log_record.mem_access_volume = total_access_volume;
         log_record.mem_footprint = mem_footprint;
       }
       if (print_log) {
         std::cout << "total access volume: " << total_access_volume << std::endl;
-        std::cout << "best total access volume: " << best_total_access_volume << std::endl;
+        std::cout << "best total " << options().objective << ": " << best_total_cost << std::endl;
       }
     } else {
-      if (Options::save_log_file >= 2) {
+      if (options().save_log_file >= 2) {
         log_record.mem_access_volume = -1;
       }
       if (print_log)
         std::cerr << "Can not use this fuse pattern with mem_size: " << mem_size << std::endl;
     }
 
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       long total_compute_time = 0;
       for (long i = 0; i < operator_chain_num; ++i) {
         op_chain[i]->setInternalTensorsFuse();
@@ -1616,7 +1825,7 @@ long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_c
         total_compute_time += op_chain[i]->compute_time();
       }
       log_record.compute_time = total_compute_time;
-      log_record.writeToFile(Options::log_directory + "/log2.csv");
+      log_record.writeToFile(options().log_directory + "/log2.csv");
     }
     for (long i = 0; i < operator_chain_num; ++i) {
       delete op_chain[i];
@@ -1624,7 +1833,7 @@ long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_c
     }
   }
 
-  std::bitset<MAX_TENSOR_NUM> fuse_or_not(best_fuse_pattern);
+  FusePattern fuse_or_not(non_io_tensors.size(), best_fuse_pattern);
   long f_i = 0;
   for (auto t : non_io_tensors) {
     if (fuse_or_not[f_i]) {
@@ -1634,9 +1843,402 @@ long traversalFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_c
     }
     ++f_i;
   }
+  // the trees of the best operator chains link the operator nodes of the best fuse pattern, not of
+  // the last one explored
+  updateOperatorTreeRelationship(tensors);
+  if (bounds && best_operator_chain_num > 0) {
+    bounds->seed_pattern = best_fuse_pattern;
+  }
+  return best_operator_chain_num;
+}
+
+// Hill climbing over a fuse pattern: flip the bit lowering the cost the most, until no flip
+// lowers it. cost is LONG_MAX for infeasible patterns. Each step evaluates one flip per bit, so
+// the search grows with the square of the bits instead of their power of two.
+FusePattern greedyFusePattern(FusePattern pattern,
+                              const std::function<long(const FusePattern &)> &cost,
+                              long &best_cost) {
+  best_cost = cost(pattern);
+  while (true) {
+    long step_cost = best_cost;
+    size_t step_bit = pattern.size();
+    for (size_t b = 0; b < pattern.size(); ++b) {
+      pattern.flip(b);
+      long c = cost(pattern);
+      pattern.flip(b);
+      if (c < step_cost) {
+        step_cost = c;
+        step_bit = b;
+      }
+    }
+    if (step_bit == pattern.size()) {
+      return pattern;
+    }
+    pattern.flip(step_bit);
+    best_cost = step_cost;
+  }
+}
+
+// The sub fuse pattern of an operator chain found by greedyFusePattern, each pattern with its
+// best orders and block sizes. The best one is recorded in the chain. Returns its cost, or
+// LONG_MAX if no sub fuse pattern fits mem_size.
+long greedyChain(OperatorChain *mul_chain, long mem_size) {
+  std::map<FusePattern, OperatorTree> order_trees;
+  auto cost = [&](const FusePattern &sf) {
+    mul_chain->setExternalTensorsFusePattern(sf);
+    double best_obj = FLT_MAX;
+    OperatorTree best_op_tree = mul_chain->getOperatorTree();
+    if (optimizeOrderCached(mul_chain, mem_size, best_obj, best_op_tree)) {
+      return LONG_MAX;
+    }
+    mul_chain->setOrder(best_op_tree.getOrderInfos());
+    DAT::optimizeBlockSize(mul_chain, mem_size);
+    mul_chain->setOrder(best_op_tree.getOrderInfos());
+    order_trees.emplace(sf, best_op_tree);
+    return objectiveValue(mul_chain);
+  };
+  long best_cost;
+  FusePattern best_fuse_pattern =
+      greedyFusePattern(FusePattern(mul_chain->getExternalTensors().size()), cost, best_cost);
+  if (best_cost != LONG_MAX) {
+    mul_chain->recordExternalTensorsFuseInfo(best_fuse_pattern);
+    mul_chain->recordOrder(order_trees.at(best_fuse_pattern).getOrderInfos());
+  }
+  return best_cost;
+}
+
+// Fusion search for graphs with too many tensors to enumerate their fuse patterns: starting from
+// no tensor fused, greedyFusePattern over the non-IO tensors, and greedyChain for the sub fuse
+// pattern of every operator chain. The result of an operator chain is reused by all fuse patterns
+// creating the same chain, so each step only optimizes the chains changed by its flip.
+long greedyFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
+                 const std::set<DAT::Tensor *> &tensors,
+                 long mem_size,
+                 DAT::OperatorChain *best_op_chain[],
+                 bool print_log = false) {
+  std::vector<Tensor *> non_io_tensors;
+  for (auto t : tensors) {
+    if (!t->isIO()) {
+      non_io_tensors.push_back(t);
+    } else {
+      t->unsetFuse();
+    }
+  }
+  auto setFusePattern = [&non_io_tensors](const FusePattern &f) {
+    for (size_t f_i = 0; f_i < non_io_tensors.size(); ++f_i) {
+      if (f[f_i]) {
+        non_io_tensors[f_i]->setFuse();
+      } else {
+        non_io_tensors[f_i]->unsetFuse();
+      }
+    }
+  };
+
+  struct ChainResult {
+    long cost{LONG_MAX};
+    FusePattern sub_fuse_pattern;
+    std::map<OperatorNode *, OrderInfo> o_infos;
+  };
+  // keyed by OrderCache::key with no external tensor fused, per layer since the results hold the
+  // operators of the chain
+  std::map<std::string, ChainResult> chain_results;
+  auto optimizeChain = [&](OperatorChain *mul_chain) {
+    mul_chain->setExternalTensorsFusePattern(0L);
+    std::string key = OrderCache::key(mul_chain, mem_size, false);
+    auto it = key.empty() ? chain_results.end() : chain_results.find(key);
+    if (it != chain_results.end()) {
+      return it->second;
+    }
+    ChainResult result;
+    result.cost = greedyChain(mul_chain, mem_size);
+    if (result.cost != LONG_MAX) {
+      result.sub_fuse_pattern = mul_chain->getExternalTensorsFusePattern();
+      result.o_infos = mul_chain->getOperatorTree().getOrderInfos();
+    }
+    if (!key.empty()) {
+      chain_results[key] = result;
+    }
+    return result;
+  };
+
+  std::vector<DAT::OperatorChain *> op_chain(non_add_to_operator_chain.size(), nullptr);
+  auto cost = [&](const FusePattern &f) {
+    setFusePattern(f);
+    long operator_chain_num = DAT::createToOperatorChain(op_chain.data(), non_add_to_operator_chain, tensors);
+    long total_cost = 0;
+    for (long i = 0; i < operator_chain_num; ++i) {
+      if (total_cost != LONG_MAX) {
+        long chain_cost = optimizeChain(op_chain[i]).cost;
+        total_cost = chain_cost == LONG_MAX ? LONG_MAX : total_cost + chain_cost;
+      }
+      delete op_chain[i];
+      op_chain[i] = nullptr;
+    }
+    if (print_log) {
+      std::cout << "fused {";
+      for (size_t f_i = 0; f_i < non_io_tensors.size(); ++f_i) {
+        if (f[f_i]) {
+          std::cout << " " << non_io_tensors[f_i]->getName();
+        }
+      }
+      std::cout << " }: " << options().objective << " " << total_cost << std::endl;
+    }
+    return total_cost;
+  };
+  long best_total_cost;
+  FusePattern best_fuse_pattern = greedyFusePattern(FusePattern(non_io_tensors.size()), cost, best_total_cost);
+
+  setFusePattern(best_fuse_pattern);
+  if (best_total_cost == LONG_MAX) {
+    return 0;
+  }
+  long best_operator_chain_num =
+      DAT::createToOperatorChain(best_op_chain, non_add_to_operator_chain, tensors);
+  for (long i = 0; i < best_operator_chain_num; ++i) {
+    ChainResult result = optimizeChain(best_op_chain[i]);
+    best_op_chain[i]->recordExternalTensorsFuseInfo(result.sub_fuse_pattern);
+    best_op_chain[i]->recordOrder(result.o_infos);
+  }
+  if (print_log) {
+    std::cout << "best total " << options().objective << ": " << best_total_cost << std::endl;
+  }
   return best_operator_chain_num;
 }
 
+// The best sub fuse pattern of an operator chain over all of them, each with its best orders and
+// block sizes, as in traversalFused. The best one is recorded in the chain. Returns its cost, or
+// LONG_MAX if no sub fuse pattern fits mem_size.
+long traversalChain(OperatorChain *mul_chain, long mem_size) {
+  const size_t external_tensors_num = mul_chain->getExternalTensors().size();
+  long sub_situation_num = fusePatternNum(external_tensors_num);
+  long best_cost = LONG_MAX;
+  long best_fuse_pattern = 0;
+  OperatorTree best_order_tree = mul_chain->getOperatorTree();
+  for (long sf = 0; sf < sub_situation_num; ++sf) {
+    mul_chain->setExternalTensorsFusePattern(sf);
+    double best_obj = FLT_MAX;
+    OperatorTree order_tree = mul_chain->getOperatorTree();
+    if (optimizeOrderCached(mul_chain, mem_size, best_obj, order_tree)) {
+      continue;
+    }
+    mul_chain->setOrder(order_tree.getOrderInfos());
+    DAT::optimizeBlockSize(mul_chain, mem_size);
+    mul_chain->setOrder(order_tree.getOrderInfos());
+    long cost = objectiveValue(mul_chain);
+    if (cost < best_cost) {
+      best_cost = cost;
+      best_fuse_pattern = sf;
+      best_order_tree = order_tree;
+    }
+  }
+  if (best_cost != LONG_MAX) {
+    mul_chain->recordExternalTensorsFuseInfo(best_fuse_pattern);
+    mul_chain->recordOrder(best_order_tree.getOrderInfos());
+  }
+  return best_cost;
+}
+
+// Whether every non-IO tensor links one producer to one consumer, so the operators linked by the
+// non-IO tensors form trees, see dpFused.
+bool isOperatorTree(const std::set<DAT::Tensor *> &tensors) {
+  for (auto t : tensors) {
+    if (!t->isIO()) {
+      long producer_num = 0;
+      long consumer_num = 0;
+      for (const auto &ro : t->getRelatedOperator()) {
+        (ro.second == "output" ? producer_num : consumer_num)++;
+      }
+      if (producer_num != 1 || consumer_num != 1) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Fusion search over the operator trees when every non-IO tensor links one producer to one
+// consumer, see isOperatorTree. Other graphs are searched by greedyFused: a tensor read by several
+// operators couples the chains of its consumers, so the cost below an operator no longer splits
+// over its subtrees. A fuse pattern cuts the trees into operator chains, so the best cost of the
+// subtree below an operator is the best over the chains rooted at it of the cost of the chain plus
+// the best costs of the subtrees cut off below the chain. Every chain is optimized once, instead of
+// once per fuse pattern creating it, and not at all when the subtrees below it already cost more
+// than the best chain found: a path of n operators has n(n+1)/2 chains but 2^(n-1) fuse patterns,
+// while an operator with k children roots 2^k times the chains of each child. The sub fuse pattern
+// of a chain with at most options().max_traversal_tensors external tensors is traversed by
+// traversalChain, which doubles with each external tensor, so the result is the one of
+// traversalFused when no chain has more. Larger chains are searched by greedyChain.
+long dpFused(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
+             const std::set<DAT::Tensor *> &tensors,
+             long mem_size,
+             DAT::OperatorChain *best_op_chain[],
+             bool print_log = false) {
+  if (!isOperatorTree(tensors)) {
+    return greedyFused(non_add_to_operator_chain, tensors, mem_size, best_op_chain, print_log);
+  }
+  std::vector<Tensor *> non_io_tensors;
+  for (auto t : tensors) {
+    if (!t->isIO()) {
+      non_io_tensors.push_back(t);
+    } else {
+      t->unsetFuse();
+    }
+  }
+  // the children of an operator are the producers of its non-IO inputs
+  std::map<Tensor *, TensorOperator *> producers;
+  std::map<TensorOperator *, std::vector<Tensor *> > child_tensors;
+  std::set<TensorOperator *> roots = non_add_to_operator_chain;
+  for (auto t : non_io_tensors) {
+    for (const auto &ro : t->getRelatedOperator()) {
+      if (ro.second == "output") {
+        producers[t] = ro.first;
+        roots.erase(ro.first);
+      } else {
+        child_tensors[ro.first].push_back(t);
+      }
+    }
+  }
+
+  struct SubtreeResult {
+    long cost{LONG_MAX};
+    // the chain rooted at the operator
+    std::set<TensorOperator *> chain_operators;
+    std::set<Tensor *> fused_tensors;
+    FusePattern sub_fuse_pattern;
+    std::map<OperatorNode *, OrderInfo> o_infos;
+    // the roots of the subtrees cut off below the chain
+    std::vector<TensorOperator *> cut_roots;
+  };
+  std::map<TensorOperator *, SubtreeResult> subtrees;
+  long chain_num = 0;
+  std::function<const SubtreeResult &(TensorOperator *)> bestSubtree =
+      [&](TensorOperator *root) -> const SubtreeResult & {
+    auto it = subtrees.find(root);
+    if (it != subtrees.end()) {
+      return it->second;
+    }
+    SubtreeResult &best = subtrees[root];
+    std::set<TensorOperator *> chain_operators = {root};
+    std::set<Tensor *> fused_tensors;
+    std::vector<TensorOperator *> cut_roots;
+    auto evaluate = [&]() {
+      long cost = 0;
+      for (auto r : cut_roots) {
+        long subtree_cost = bestSubtree(r).cost;
+        if (subtree_cost == LONG_MAX) {
+          return;
+        }
+        cost += subtree_cost;
+      }
+      // the chain can only add to the cost
+      if (cost >= best.cost) {
+        return;
+      }
+      for (auto t : non_io_tensors) {
+        fused_tensors.count(t) ? t->setFuse() : t->unsetFuse();
+      }
+      DAT::OperatorChain *mul_chain[1] = {nullptr};
+      DAT::createToOperatorChain(mul_chain, chain_operators, tensors);
+      long external_tensors_num = static_cast<long>(mul_chain[0]->getExternalTensors().size());
+      long chain_cost = external_tensors_num <= options().max_traversal_tensors
+                            ? traversalChain(mul_chain[0], mem_size) : greedyChain(mul_chain[0], mem_size);
+      ++chain_num;
+      if (print_log) {
+        std::cout << mul_chain[0]->toString();
+        std::cout << options().objective << ": " << chain_cost << std::endl;
+      }
+      if (chain_cost != LONG_MAX && cost + chain_cost < best.cost) {
+        best.cost = cost + chain_cost;
+        best.chain_operators = chain_operators;
+        best.fused_tensors = fused_tensors;
+        best.sub_fuse_pattern = mul_chain[0]->getExternalTensorsFusePattern();
+        best.o_infos = mul_chain[0]->getOperatorTree().getOrderInfos();
+        best.cut_roots = cut_roots;
+      }
+      delete mul_chain[0];
+    };
+    // every tensor on the frontier of the chain is either fused, growing the chain into its
+    // producer, or cut
+    std::function<void(std::vector<Tensor *>)> enumerate = [&](std::vector<Tensor *> frontier) {
+      if (frontier.empty()) {
+        evaluate();
+        return;
+      }
+      Tensor *t = frontier.back();
+      frontier.pop_back();
+      TensorOperator *child = producers.at(t);
+      cut_roots.push_back(child);
+      enumerate(frontier);
+      cut_roots.pop_back();
+      fused_tensors.insert(t);
+      chain_operators.insert(child);
+      const std::vector<Tensor *> &grandchild_tensors = child_tensors[child];
+      frontier.insert(frontier.end(), grandchild_tensors.begin(), grandchild_tensors.end());
+      enumerate(frontier);
+      fused_tensors.erase(t);
+      chain_operators.erase(child);
+    };
+    enumerate(child_tensors[root]);
+    return best;
+  };
+
+  long best_total_cost = 0;
+  std::vector<const SubtreeResult *> chains;
+  std::vector<TensorOperator *> pending(roots.begin(), roots.end());
+  while (!pending.empty() && best_total_cost != LONG_MAX) {
+    const SubtreeResult &subtree = bestSubtree(pending.back());
+    if (roots.count(pending.back())) {
+      best_total_cost = subtree.cost == LONG_MAX ? LONG_MAX : best_total_cost + subtree.cost;
+    }
+    pending.pop_back();
+    chains.push_back(&subtree);
+    pending.insert(pending.end(), subtree.cut_roots.begin(), subtree.cut_roots.end());
+  }
+  if (print_log) {
+    std::cout << "optimized operator chains: " << chain_num << std::endl;
+  }
+  for (auto t : non_io_tensors) {
+    t->unsetFuse();
+  }
+  if (best_total_cost == LONG_MAX) {
+    return 0;
+  }
+  for (auto subtree : chains) {
+    for (auto t : subtree->fused_tensors) {
+      t->setFuse();
+    }
+  }
+  long best_operator_chain_num =
+      DAT::createToOperatorChain(best_op_chain, non_add_to_operator_chain, tensors);
+  for (long i = 0; i < best_operator_chain_num; ++i) {
+    for (auto subtree : chains) {
+      if (subtree->chain_operators == best_op_chain[i]->getOperators()) {
+        best_op_chain[i]->recordExternalTensorsFuseInfo(subtree->sub_fuse_pattern);
+        best_op_chain[i]->recordOrder(subtree->o_infos);
+      }
+    }
+  }
+  if (print_log) {
+    std::cout << "best total " << options().objective << ": " << best_total_cost << std::endl;
+  }
+  return best_operator_chain_num;
+}
+
+// The fusion search of exploreGraph per options().fuse_search: "traversal", "dp" or "greedy", see
+// traversalFused, dpFused and greedyFused. "auto" traverses graphs with at most
+// options().max_traversal_tensors non-IO tensors, and searches larger ones by dpFused if their
+// operators form trees, or by greedyFused. "dp" on other graphs is greedyFused as well.
+std::string fuseSearch(const std::set<DAT::Tensor *> &tensors) {
+  if (options().fuse_search != "auto") {
+    return options().fuse_search;
+  }
+  long non_io_tensor_num = std::count_if(tensors.begin(), tensors.end(), [](Tensor *t) { return !t->isIO(); });
+  if (non_io_tensor_num <= options().max_traversal_tensors) {
+    return "traversal";
+  }
+  return isOperatorTree(tensors) ? "dp" : "greedy";
+}
+
 long flatDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
              const std::set<DAT::Tensor *> &tensors,
              long mem_size,
@@ -1654,9 +2256,7 @@ long flatDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
       t->unsetFuse();
     }
   }
-  long situation_num = pow(2, non_io_tensors.size());
-
-  std::bitset<MAX_TENSOR_NUM> bit_tmp;
+  FusePattern bit_tmp(non_io_tensors.size());
   long tmp = 0;
   for (auto t : non_io_tensors) {
     if (t->isFused()) {
@@ -1667,10 +2267,9 @@ long flatDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
     ++tmp;
   }
 
-  assert(tensors.size() <= MAX_TENSOR_NUM);
-  DAT::OperatorChain *op_chain[MAX_TENSOR_NUM] = {nullptr};
+  std::vector<DAT::OperatorChain *> op_chain(non_add_to_operator_chain.size(), nullptr);
   LogRecord6 log_record;
-  if (Options::save_log_file >= 2) {
+  if (options().save_log_file >= 2) {
     log_record.id = 2;
     log_record.defineAlgroithm(non_add_to_operator_chain);
     log_record.mem_size = mem_size;
@@ -1679,7 +2278,7 @@ long flatDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
   if (print_log)
     std::cout << "----------------situation " << -1 << "-----------------" << std::endl;
   long operator_chain_num =
-      DAT::createToOperatorChain(op_chain, non_add_to_operator_chain, tensors);
+      DAT::createToOperatorChain(op_chain.data(), non_add_to_operator_chain, tensors);
   long total_access_volume = 0;
   long mem_footprint = 0;
   long infeasible = 0;
@@ -1697,7 +2296,7 @@ long flatDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
     for (long sf = 0; sf < sub_situation_num; sf++) {
       mul_chain->setExternalTensorsFusePattern(sf);
       LogRecord2 sub_log_record;
-      if (Options::save_log_file >= 2) {
+      if (options().save_log_file >= 2) {
         sub_log_record.id = 2;
         sub_log_record.defineAlgroithm(mul_chain->getOperators());
         sub_log_record.mem_size = mem_size;
@@ -1728,17 +2327,17 @@ long flatDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
           sub_best_access_volume = mem_access_volume;
           sub_mem_footprint = mul_chain->getMemFootprint();
         }
-        if (Options::save_log_file >= 2) {
+        if (options().save_log_file >= 2) {
           sub_log_record.mem_access_volume = mem_access_volume;
           sub_log_record.mem_footprint = mul_chain->getMemFootprint();
         }
       } else {
-        if (Options::save_log_file >= 2) {
+        if (options().save_log_file >= 2) {
           sub_log_record.mem_access_volume = -1;
         }
       }
-      if (Options::save_log_file >= 2) {
-        sub_log_record.writeToFile(Options::log_directory + "/log2s.csv");
+      if (options().save_log_file >= 2) {
+        sub_log_record.writeToFile(options().log_directory + "/log2s.csv");
       }
     }
     if (!sub_infeasible) {
@@ -1771,7 +2370,7 @@ long flatDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
         *(best_op_chain[i]) = *(op_chain[i]);
       }
     }
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.mem_access_volume = total_access_volume;
       log_record.mem_footprint = mem_footprint;
     }
@@ -1780,14 +2379,14 @@ long flatDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
       std::cout << "best total access volume: " << best_total_access_volume << std::endl;
     }
   } else {
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.mem_access_volume = -1;
     }
     if (print_log)
       std::cerr << "Can not use this fuse pattern with mem_size: " << mem_size << std::endl;
   }
 
-  if (Options::save_log_file >= 2) {
+  if (options().save_log_file >= 2) {
     for (long i = 0; i < operator_chain_num; ++i) {
       op_chain[i]->setInternalTensorsFuse();
       op_chain[i]->setExternalTensorsFusePattern(op_chain[i]->getExternalTensorsFusePattern());
@@ -1798,14 +2397,14 @@ long flatDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
       log_record.recordDimBlocksizes(op_chain[i]);
       log_record.recordOpChainMemAccessVolume(op_chain[i]);
     }
-    log_record.writeToFile(Options::log_directory + "/log2.csv");
+    log_record.writeToFile(options().log_directory + "/log2.csv");
   }
   for (long i = 0; i < operator_chain_num; ++i) {
     delete op_chain[i];
     op_chain[i] = nullptr;
   }
 
-  std::bitset<MAX_TENSOR_NUM> fuse_or_not(bit_tmp);
+  FusePattern fuse_or_not(bit_tmp);
   long f_i = 0;
   for (auto t : non_io_tensors) {
     if (fuse_or_not[f_i]) {
@@ -1834,9 +2433,7 @@ long chimeraDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain
       t->unsetFuse();
     }
   }
-  long situation_num = pow(2, non_io_tensors.size());
-
-  std::bitset<MAX_TENSOR_NUM> bit_tmp;
+  FusePattern bit_tmp(non_io_tensors.size());
   long tmp = 0;
   for (auto t : non_io_tensors) {
     if (t->isFused()) {
@@ -1847,10 +2444,9 @@ long chimeraDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain
     ++tmp;
   }
 
-  assert(tensors.size() <= MAX_TENSOR_NUM);
-  DAT::OperatorChain *op_chain[MAX_TENSOR_NUM] = {nullptr};
+  std::vector<DAT::OperatorChain *> op_chain(non_add_to_operator_chain.size(), nullptr);
   LogRecord6 log_record;
-  if (Options::save_log_file >= 2) {
+  if (options().save_log_file >= 2) {
     log_record.id = 2;
     log_record.defineAlgroithm(non_add_to_operator_chain);
     log_record.mem_size = mem_size;
@@ -1859,7 +2455,7 @@ long chimeraDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain
   if (print_log)
     std::cout << "----------------situation " << -1 << "-----------------" << std::endl;
   long operator_chain_num =
-      DAT::createToOperatorChain(op_chain, non_add_to_operator_chain, tensors);
+      DAT::createToOperatorChain(op_chain.data(), non_add_to_operator_chain, tensors);
   long total_access_volume = 0;
   long mem_footprint = 0;
   long infeasible = 0;
@@ -1877,7 +2473,7 @@ long chimeraDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain
     for (long sf = 0; sf < sub_situation_num; sf++) {
       mul_chain->setExternalTensorsFusePattern(sf);
       LogRecord2 sub_log_record;
-      if (Options::save_log_file >= 2) {
+      if (options().save_log_file >= 2) {
         sub_log_record.id = 2;
         sub_log_record.defineAlgroithm(mul_chain->getOperators());
         sub_log_record.mem_size = mem_size;
@@ -1901,17 +2497,17 @@ long chimeraDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain
           sub_best_access_volume = mem_access_volume;
           sub_mem_footprint = mul_chain->getMemFootprint();
         }
-        if (Options::save_log_file >= 2) {
+        if (options().save_log_file >= 2) {
           sub_log_record.mem_access_volume = mem_access_volume;
           sub_log_record.mem_footprint = mul_chain->getMemFootprint();
         }
       } else {
-        if (Options::save_log_file >= 2) {
+        if (options().save_log_file >= 2) {
           sub_log_record.mem_access_volume = -1;
         }
       }
-      if (Options::save_log_file >= 2) {
-        sub_log_record.writeToFile(Options::log_directory + "/log2s.csv");
+      if (options().save_log_file >= 2) {
+        sub_log_record.writeToFile(options().log_directory + "/log2s.csv");
       }
     }
     if (!sub_infeasible) {
@@ -1944,7 +2540,7 @@ long chimeraDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain
         *(best_op_chain[i]) = *(op_chain[i]);
       }
     }
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.mem_access_volume = total_access_volume;
       log_record.mem_footprint = mem_footprint;
     }
@@ -1953,14 +2549,14 @@ long chimeraDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain
       std::cout << "best total access volume: " << best_total_access_volume << std::endl;
     }
   } else {
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.mem_access_volume = -1;
     }
     if (print_log)
       std::cerr << "Can not use this fuse pattern with mem_size: " << mem_size << std::endl;
   }
 
-  if (Options::save_log_file >= 2) {
+  if (options().save_log_file >= 2) {
     for (long i = 0; i < operator_chain_num; ++i) {
       op_chain[i]->setInternalTensorsFuse();
       op_chain[i]->setExternalTensorsFusePattern(op_chain[i]->getExternalTensorsFusePattern());
@@ -1971,14 +2567,14 @@ long chimeraDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain
       log_record.recordDimBlocksizes(op_chain[i]);
       log_record.recordOpChainMemAccessVolume(op_chain[i]);
     }
-    log_record.writeToFile(Options::log_directory + "/log2.csv");
+    log_record.writeToFile(options().log_directory + "/log2.csv");
   }
   for (long i = 0; i < operator_chain_num; ++i) {
     delete op_chain[i];
     op_chain[i] = nullptr;
   }
 
-  std::bitset<MAX_TENSOR_NUM> fuse_or_not(bit_tmp);
+  FusePattern fuse_or_not(bit_tmp);
   long f_i = 0;
   for (auto t : non_io_tensors) {
     if (fuse_or_not[f_i]) {
@@ -2007,9 +2603,7 @@ long baselineDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
       t->unsetFuse();
     }
   }
-  long situation_num = pow(2, non_io_tensors.size());
-
-  std::bitset<MAX_TENSOR_NUM> bit_tmp;
+  FusePattern bit_tmp(non_io_tensors.size());
   long tmp = 0;
   for (auto t : non_io_tensors) {
     if (t->isFused()) {
@@ -2020,10 +2614,9 @@ long baselineDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
     ++tmp;
   }
 
-  assert(tensors.size() <= MAX_TENSOR_NUM);
-  DAT::OperatorChain *op_chain[MAX_TENSOR_NUM] = {nullptr};
+  std::vector<DAT::OperatorChain *> op_chain(non_add_to_operator_chain.size(), nullptr);
   LogRecord6 log_record;
-  if (Options::save_log_file >= 2) {
+  if (options().save_log_file >= 2) {
     log_record.id = 2;
     log_record.defineAlgroithm(non_add_to_operator_chain);
     log_record.mem_size = mem_size;
@@ -2032,7 +2625,7 @@ long baselineDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
   if (print_log)
     std::cout << "----------------situation " << -1 << "-----------------" << std::endl;
   long operator_chain_num =
-      DAT::createToOperatorChain(op_chain, non_add_to_operator_chain, tensors);
+      DAT::createToOperatorChain(op_chain.data(), non_add_to_operator_chain, tensors);
   long total_access_volume = 0;
   long mem_footprint = 0;
   long infeasible = 0;
@@ -2050,7 +2643,7 @@ long baselineDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
     for (long sf = 0; sf < sub_situation_num; sf++) {
       mul_chain->setExternalTensorsFusePattern(sf);
       LogRecord2 sub_log_record;
-      if (Options::save_log_file >= 2) {
+      if (options().save_log_file >= 2) {
         sub_log_record.id = 2;
         sub_log_record.defineAlgroithm(mul_chain->getOperators());
         sub_log_record.mem_size = mem_size;
@@ -2074,17 +2667,17 @@ long baselineDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
           sub_best_access_volume = mem_access_volume;
           sub_mem_footprint = mul_chain->getMemFootprint();
         }
-        if (Options::save_log_file >= 2) {
+        if (options().save_log_file >= 2) {
           sub_log_record.mem_access_volume = mem_access_volume;
           sub_log_record.mem_footprint = mul_chain->getMemFootprint();
         }
       } else {
-        if (Options::save_log_file >= 2) {
+        if (options().save_log_file >= 2) {
           sub_log_record.mem_access_volume = -1;
         }
       }
-      if (Options::save_log_file >= 2) {
-        sub_log_record.writeToFile(Options::log_directory + "/log2s.csv");
+      if (options().save_log_file >= 2) {
+        sub_log_record.writeToFile(options().log_directory + "/log2s.csv");
       }
     }
     if (!sub_infeasible) {
@@ -2117,7 +2710,7 @@ long baselineDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
         *(best_op_chain[i]) = *(op_chain[i]);
       }
     }
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.mem_access_volume = total_access_volume;
       log_record.mem_footprint = mem_footprint;
     }
@@ -2126,14 +2719,14 @@ long baselineDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
       std::cout << "best total access volume: " << best_total_access_volume << std::endl;
     }
   } else {
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.mem_access_volume = -1;
     }
     if (print_log)
       std::cerr << "Can not use this fuse pattern with mem_size: " << mem_size << std::endl;
   }
 
-  if (Options::save_log_file >= 2) {
+  if (options().save_log_file >= 2) {
     for (long i = 0; i < operator_chain_num; ++i) {
       op_chain[i]->setInternalTensorsFuse();
       op_chain[i]->setExternalTensorsFusePattern(op_chain[i]->getExternalTensorsFusePattern());
@@ -2144,14 +2737,14 @@ long baselineDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chai
       log_record.recordDimBlocksizes(op_chain[i]);
       log_record.recordOpChainMemAccessVolume(op_chain[i]);
     }
-    log_record.writeToFile(Options::log_directory + "/log2.csv");
+    log_record.writeToFile(options().log_directory + "/log2.csv");
   }
   for (long i = 0; i < operator_chain_num; ++i) {
     delete op_chain[i];
     op_chain[i] = nullptr;
   }
 
-  std::bitset<MAX_TENSOR_NUM> fuse_or_not(bit_tmp);
+  FusePattern fuse_or_not(bit_tmp);
   long f_i = 0;
   for (auto t : non_io_tensors) {
     if (fuse_or_not[f_i]) {
@@ -2181,9 +2774,7 @@ long nonDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
       t->unsetFuse();
     }
   }
-  long situation_num = pow(2, non_io_tensors.size());
-
-  std::bitset<MAX_TENSOR_NUM> bit_tmp;
+  FusePattern bit_tmp(non_io_tensors.size());
   long tmp = 0;
   for (auto t : non_io_tensors) {
     if (t->isFused()) {
@@ -2194,10 +2785,9 @@ long nonDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
     ++tmp;
   }
 
-  assert(tensors.size() <= MAX_TENSOR_NUM);
-  DAT::OperatorChain *op_chain[MAX_TENSOR_NUM] = {nullptr};
+  std::vector<DAT::OperatorChain *> op_chain(non_add_to_operator_chain.size(), nullptr);
   LogRecord6 log_record;
-  if (Options::save_log_file >= 2) {
+  if (options().save_log_file >= 2) {
     log_record.id = 2;
     log_record.defineAlgroithm(non_add_to_operator_chain);
     log_record.mem_size = mem_size;
@@ -2206,7 +2796,7 @@ long nonDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
   if (print_log)
     std::cout << "----------------situation " << -1 << "-----------------" << std::endl;
   long operator_chain_num =
-      DAT::createToOperatorChain(op_chain, non_add_to_operator_chain, tensors);
+      DAT::createToOperatorChain(op_chain.data(), non_add_to_operator_chain, tensors);
   long total_access_volume = 0;
   long mem_footprint = 0;
   long infeasible = 0;
@@ -2224,7 +2814,7 @@ long nonDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
     for (long sf = 0; sf < sub_situation_num; sf++) {
       mul_chain->setExternalTensorsFusePattern(sf);
       LogRecord2 sub_log_record;
-      if (Options::save_log_file >= 2) {
+      if (options().save_log_file >= 2) {
         sub_log_record.id = 2;
         sub_log_record.defineAlgroithm(mul_chain->getOperators());
         sub_log_record.mem_size = mem_size;
@@ -2249,17 +2839,17 @@ long nonDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
           sub_best_access_volume = mem_access_volume;
           sub_mem_footprint = mul_chain->getMemFootprint();
         }
-        if (Options::save_log_file >= 2) {
+        if (options().save_log_file >= 2) {
           sub_log_record.mem_access_volume = mem_access_volume;
           sub_log_record.mem_footprint = mul_chain->getMemFootprint();
         }
       } else {
-        if (Options::save_log_file >= 2) {
+        if (options().save_log_file >= 2) {
           sub_log_record.mem_access_volume = -1;
         }
       }
-      if (Options::save_log_file >= 2) {
-        sub_log_record.writeToFile(Options::log_directory + "/log2s.csv");
+      if (options().save_log_file >= 2) {
+        sub_log_record.writeToFile(options().log_directory + "/log2s.csv");
       }
     }
     if (!sub_infeasible) {
@@ -2292,7 +2882,7 @@ long nonDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
         *(best_op_chain[i]) = *(op_chain[i]);
       }
     }
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.mem_access_volume = total_access_volume;
       log_record.mem_footprint = mem_footprint;
     }
@@ -2301,14 +2891,14 @@ long nonDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
       std::cout << "best total access volume: " << best_total_access_volume << std::endl;
     }
   } else {
-    if (Options::save_log_file >= 2) {
+    if (options().save_log_file >= 2) {
       log_record.mem_access_volume = -1;
     }
     if (print_log)
       std::cerr << "Can not use this fuse pattern with mem_size: " << mem_size << std::endl;
   }
 
-  if (Options::save_log_file >= 2) {
+  if (options().save_log_file >= 2) {
     for (long i = 0; i < operator_chain_num; ++i) {
       op_chain[i]->setInternalTensorsFuse();
       op_chain[i]->setExternalTensorsFusePattern(op_chain[i]->getExternalTensorsFusePattern());
@@ -2318,14 +2908,14 @@ long nonDSE(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
       log_record.recordDimBlocksizes(op_chain[i]);
       log_record.recordOpChainMemAccessVolume(op_chain[i]);
     }
-    log_record.writeToFile(Options::log_directory + "/log2.csv");
+    log_record.writeToFile(options().log_directory + "/log2.csv");
   }
   for (long i = 0; i < operator_chain_num; ++i) {
     delete op_chain[i];
     op_chain[i] = nullptr;
   }
 
-  std::bitset<MAX_TENSOR_NUM> fuse_or_not(bit_tmp);
+  FusePattern fuse_or_not(bit_tmp);
   long f_i = 0;
   for (auto t : non_io_tensors) {
     if (fuse_or_not[f_i]) {
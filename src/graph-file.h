@@ -0,0 +1,387 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_GRAPH_FILE_H
+#define MMCHAIN_ANALYSIS_SRC_GRAPH_FILE_H
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include "operator-tree.h"
+#include "options.h"
+#include "tensor-operator.h"
+
+namespace DAT {
+
+// A graph read from a text file, owning its dims, tensors and operators. Each line declares one
+// of them, '#' starts a comment, and attributes are key=value words anywhere after the name:
+//   dim <name> <size>
+//   tensor <name> <dim>... [role=activation|weight|score]
+//   matmul <name> <input> <input> -> <output> [bias=0|1]
+//   softmax|layernorm <name> <input> -> <output> dim=<normalize dim>
+//   elementwise <name> <input>... -> <output> [function=add] [ops=1]
+//   boundary <output> -> <input>... [stored=0|1]
+// Operators also take batch=0|1 and head=0|1, whether they share their weights over the batch
+// and the heads, 0 by default. A size is a product "a*b" of integers and integer options such as
+// seq_length, so a sweep over the options resizes the graph. The bsc, hsc and gsc block sizes
+// start from batch_blocksize, head_blocksize and 1, as in the built-in workloads.
+// The graph is a layer repeated layer_num times, each layer with its own tensors and operators
+// named <name>_<layer> from 1, and the dims shared. A boundary feeds the output of a layer to the
+// inputs of the next one, which have its dims: they are the same tensor, which may be fused
+// across the layers. stored=1 marks an output the next layer also reads from DRAM through other
+// inputs, which must be stored even when fused.
+class GraphFile {
+public:
+  explicit GraphFile(std::istream &is, long layer_num = 1) : layer_num(layer_num) {
+    read(is);
+  }
+  explicit GraphFile(const std::string &file_name, long layer_num = 1) : layer_num(layer_num) {
+    std::ifstream ifs(file_name);
+    if (!ifs) {
+      throw std::invalid_argument("can not open graph file: " + file_name);
+    }
+    read(ifs);
+  }
+  GraphFile(const GraphFile &) = delete;
+  GraphFile &operator=(const GraphFile &) = delete;
+
+  std::set<TensorOperator *> getOperators() {
+    std::set<TensorOperator *> ops;
+    for (auto &op : operators) {
+      ops.insert(op.get());
+    }
+    return ops;
+  }
+  std::set<Tensor *> getTensors() {
+    std::set<Tensor *> ts;
+    for (auto &nt : tensors) {
+      ts.insert(nt.second.get());
+    }
+    return ts;
+  }
+  // The boundary outputs of every layer but the last, which the next layer reads, and whether
+  // they are stored anyway.
+  std::map<Tensor *, bool> getBoundaryTensors() {
+    std::map<Tensor *, bool> boundary_tensors;
+    for (long layer = 0; layer + 1 < layer_num; ++layer) {
+      for (const auto &b : boundaries) {
+        boundary_tensors[tensors[layerName(b.output, layer)].get()] = b.stored;
+      }
+    }
+    return boundary_tensors;
+  }
+
+private:
+  struct Declaration {
+    long line_num;
+    std::vector<std::string> args;
+    std::map<std::string, std::string> attrs;
+  };
+  struct Boundary {
+    long line_num;
+    std::string output;
+    std::vector<std::string> inputs;
+    bool stored;
+  };
+
+  void read(std::istream &is) {
+    if (layer_num < 1) {
+      throw std::invalid_argument("a graph should have at least one layer");
+    }
+    std::vector<Declaration> declarations;
+    std::string line;
+    for (long line_num = 1; std::getline(is, line); ++line_num) {
+      std::istringstream words(line.substr(0, line.find('#')));
+      std::vector<std::string> args;
+      std::map<std::string, std::string> attrs;
+      std::string word;
+      while (words >> word) {
+        size_t eq = word.find('=');
+        if (eq == std::string::npos) {
+          args.push_back(word);
+        } else {
+          attrs[word.substr(0, eq)] = word.substr(eq + 1);
+        }
+      }
+      if (!args.empty()) {
+        declarations.push_back({line_num, args, attrs});
+      }
+    }
+    auto atLine = [](long line_num, const std::exception &e) {
+      return std::invalid_argument("line " + std::to_string(line_num) + " of the graph file: " + e.what());
+    };
+    for (const auto &d : declarations) {
+      if (d.args[0] == "boundary") {
+        try {
+          readBoundary(d.args, d.attrs, d.line_num);
+        } catch (const std::exception &e) {
+          throw atLine(d.line_num, e);
+        }
+      }
+    }
+    if (layer_num > 1 && boundaries.empty()) {
+      throw std::invalid_argument("a graph of several layers should have a boundary");
+    }
+    for (long layer = 0; layer < layer_num; ++layer) {
+      for (const auto &d : declarations) {
+        try {
+          readLine(d.args, d.attrs, layer);
+        } catch (const std::exception &e) {
+          throw atLine(d.line_num, e);
+        }
+      }
+      if (layer == 0) {
+        for (const auto &b : boundaries) {
+          try {
+            checkBoundary(b);
+          } catch (const std::exception &e) {
+            throw atLine(b.line_num, e);
+          }
+        }
+      }
+    }
+    for (auto &nt : tensors) {
+      if (nt.second->getRelatedOperator().empty()) {
+        throw std::invalid_argument("tensor " + nt.first + " is used by no operator");
+      }
+    }
+  }
+
+  void readBoundary(const std::vector<std::string> &args, std::map<std::string, std::string> attrs, long line_num) {
+    auto arrow = std::find(args.begin(), args.end(), "->");
+    if (args.size() < 4 || arrow != args.begin() + 2) {
+      throw std::invalid_argument("a boundary should be boundary <output> -> <input>...");
+    }
+    Boundary b{line_num, args[1], std::vector<std::string>(arrow + 1, args.end()),
+               std::stol(takeAttr(attrs, "stored", "0")) != 0};
+    checkAttrs(attrs);
+    for (const auto &input : b.inputs) {
+      if (boundary_inputs.count(input)) {
+        throw std::invalid_argument("tensor " + input + " is the input of two boundaries");
+      }
+      boundary_inputs[input] = b.output;
+    }
+    boundaries.push_back(b);
+  }
+  // The inputs of a boundary are graph inputs with the dims of its output, a graph output.
+  void checkBoundary(const Boundary &b) {
+    std::vector<std::string> names = b.inputs;
+    names.push_back(b.output);
+    for (const auto &name : names) {
+      if (findTensor(layerName(name, 0))->getRelatedOperator().empty()) {
+        throw std::invalid_argument("tensor " + name + " is used by no operator");
+      }
+    }
+    Tensor *output = findTensor(layerName(b.output, 0));
+    if (!output->isIO() || output->getRelatedOperator().begin()->second != "output") {
+      throw std::invalid_argument("the boundary output " + b.output + " should be an output of the graph");
+    }
+    for (const auto &name : b.inputs) {
+      Tensor *input = findTensor(layerName(name, 0));
+      bool same_dims = input->getDims().size() == output->getDims().size();
+      for (auto d : output->getDims()) {
+        same_dims &= input->hasDim(d);
+      }
+      if (!same_dims || !input->isIO() || input->getRelatedOperator().begin()->second != "input") {
+        throw std::invalid_argument("the boundary input " + name + " should be an input of the graph with the dims of "
+                                        + b.output);
+      }
+    }
+  }
+
+  void readLine(const std::vector<std::string> &args, std::map<std::string, std::string> attrs, long layer) {
+    const std::string &kind = args[0];
+    if (args.size() < 2) {
+      throw std::invalid_argument(kind + " should have a name");
+    }
+    if (kind == "boundary" || (kind == "dim" && layer > 0)) {
+      return;
+    }
+    if (kind == "tensor" && layer > 0 && boundary_inputs.count(args[1])) {
+      return;
+    }
+    const std::string name = kind == "dim" ? args[1] : layerName(args[1], layer);
+    if (kind == "dim") {
+      if (args.size() != 3 || dims.count(name)) {
+        throw std::invalid_argument("a dim should be dim <name> <size>, once for each name");
+      }
+      dims[name] = std::make_unique<Dim>(name, readSize(args[2]));
+      return;
+    }
+    if (kind == "tensor") {
+      if (tensors.count(name)) {
+        throw std::invalid_argument("tensor " + name + " is declared twice");
+      }
+      std::vector<Dim *> tensor_dims;
+      for (size_t i = 2; i < args.size(); ++i) {
+        Dim *d = findDim(args[i]);
+        if (std::find(tensor_dims.begin(), tensor_dims.end(), d) != tensor_dims.end()) {
+          throw std::invalid_argument("tensor " + name + " has dim " + args[i] + " twice");
+        }
+        tensor_dims.push_back(d);
+      }
+      if (tensor_dims.empty()) {
+        throw std::invalid_argument("tensor " + name + " should have dims");
+      }
+      auto tensor = std::make_unique<TensorND>(name, tensor_dims);
+      std::string role = takeAttr(attrs, "role", "activation");
+      if (role == "weight") {
+        tensor->setRole(TensorRole::Weight);
+      } else if (role == "score") {
+        tensor->setRole(TensorRole::Score);
+      } else if (role != "activation") {
+        throw std::invalid_argument("unknown tensor role: " + role);
+      }
+      checkAttrs(attrs);
+      tensors[name] = std::move(tensor);
+      return;
+    }
+
+    // an operator: <kind> <name> <input>... -> <output>
+    if (kind != "matmul" && kind != "softmax" && kind != "layernorm" && kind != "elementwise") {
+      throw std::invalid_argument("unknown declaration: " + kind);
+    }
+    auto arrow = std::find(args.begin(), args.end(), "->");
+    if (arrow == args.end() || arrow + 2 != args.end() || arrow == args.begin() + 2) {
+      throw std::invalid_argument("an operator should be " + kind + " <name> <input>... -> <output>");
+    }
+    for (auto &op : operators) {
+      if (op->getName() == name) {
+        throw std::invalid_argument("operator " + name + " is declared twice");
+      }
+    }
+    std::vector<Tensor *> inputs;
+    for (auto it = args.begin() + 2; it != arrow; ++it) {
+      inputs.push_back(findTensor(tensorName(*it, layer)));
+    }
+    Tensor *output = findTensor(tensorName(args.back(), layer));
+    for (const auto &ro : output->getRelatedOperator()) {
+      if (ro.second == "output") {
+        throw std::invalid_argument("tensor " + output->getName() + " is the output of two operators");
+      }
+    }
+    std::unique_ptr<TensorOperator> op;
+    if (kind == "matmul") {
+      if (inputs.size() != 2) {
+        throw std::invalid_argument("a matmul should have two inputs");
+      }
+      for (auto d : output->getDims()) {
+        if (!inputs[0]->hasDim(d) && !inputs[1]->hasDim(d)) {
+          throw std::invalid_argument("dim " + d->getName() + " of the output is in no input");
+        }
+      }
+      op = std::make_unique<MatrixMul>(name, inputs[0], inputs[1], output);
+      op->is_with_bias(std::stol(takeAttr(attrs, "bias", "0")) != 0);
+    } else {
+      for (auto t : inputs) {
+        bool same_dims = t->getDims().size() == output->getDims().size();
+        for (auto d : output->getDims()) {
+          same_dims &= t->hasDim(d);
+        }
+        if (!same_dims) {
+          throw std::invalid_argument("the inputs of " + kind + " should have the dims of the output");
+        }
+      }
+      if (kind == "elementwise") {
+        long ops = std::stol(takeAttr(attrs, "ops", "1"));
+        op = std::make_unique<ElementWise>(name, takeAttr(attrs, "function", "add"), inputs, output, ops);
+      } else {
+        if (inputs.size() != 1 || !attrs.count("dim")) {
+          throw std::invalid_argument(kind + " should have one input and a dim=<normalize dim>");
+        }
+        Dim *normalize_dim = findDim(takeAttr(attrs, "dim", ""));
+        if (!output->hasDim(normalize_dim)) {
+          throw std::invalid_argument("the normalize dim should be a dim of the output");
+        }
+        if (kind == "softmax") {
+          op = std::make_unique<Softmax>(name, inputs[0], output, normalize_dim);
+        } else {
+          op = std::make_unique<LayerNorm>(name, inputs[0], output, normalize_dim);
+        }
+      }
+    }
+    op->isBatchDependent(std::stol(takeAttr(attrs, "batch", "0")) != 0);
+    op->isHeadDependent(std::stol(takeAttr(attrs, "head", "0")) != 0);
+    checkAttrs(attrs);
+    std::map<std::string, long> fixed_block_sizes = {
+        {"bsc", std::max(1L, options().batch_blocksize)}, {"hsc", std::max(1L, options().head_blocksize)},
+        {"gsc", 1}};
+    for (const auto &fb : fixed_block_sizes) {
+      if (op->getDim(fb.first)) {
+        op->getDim(fb.first)->setBlockSize(op.get(), fb.second);
+      }
+    }
+    nodes.push_back(std::make_unique<OperatorNode>(op.get()));
+    operators.push_back(std::move(op));
+  }
+
+  std::string layerName(const std::string &name, long layer) const {
+    return layer_num == 1 ? name : name + "_" + std::to_string(layer + 1);
+  }
+  // A boundary input of a layer after the first is the boundary output of the layer before.
+  std::string tensorName(const std::string &name, long layer) const {
+    auto it = boundary_inputs.find(name);
+    if (layer > 0 && it != boundary_inputs.end()) {
+      return layerName(it->second, layer - 1);
+    }
+    return layerName(name, layer);
+  }
+
+  static long readSize(const std::string &str) {
+    std::map<std::string, long *> long_options = options().longOptions();
+    long size = 1;
+    std::istringstream factors(str);
+    std::string factor;
+    while (std::getline(factors, factor, '*')) {
+      if (long_options.count(factor)) {
+        size *= *long_options[factor];
+      } else if (!factor.empty() && factor.find_first_not_of("0123456789") == std::string::npos) {
+        size *= std::stol(factor);
+      } else {
+        throw std::invalid_argument("a size should be a product of integers and integer options, but got " + str);
+      }
+    }
+    if (size <= 0) {
+      throw std::invalid_argument("size " + str + " should be positive");
+    }
+    return size;
+  }
+  static std::string takeAttr(std::map<std::string, std::string> &attrs, const std::string &key,
+                              const std::string &default_value) {
+    auto it = attrs.find(key);
+    if (it == attrs.end()) {
+      return default_value;
+    }
+    std::string value = it->second;
+    attrs.erase(it);
+    return value;
+  }
+  static void checkAttrs(const std::map<std::string, std::string> &attrs) {
+    if (!attrs.empty()) {
+      throw std::invalid_argument("unknown attribute: " + attrs.begin()->first);
+    }
+  }
+  Dim *findDim(const std::string &name) {
+    if (!dims.count(name)) {
+      throw std::invalid_argument("unknown dim: " + name);
+    }
+    return dims[name].get();
+  }
+  Tensor *findTensor(const std::string &name) {
+    if (!tensors.count(name)) {
+      throw std::invalid_argument("unknown tensor: " + name);
+    }
+    return tensors[name].get();
+  }
+
+  long layer_num;
+  std::vector<Boundary> boundaries;
+  std::map<std::string, std::string> boundary_inputs;
+  std::map<std::string, std::unique_ptr<Dim> > dims;
+  std::map<std::string, std::unique_ptr<Tensor> > tensors;
+  std::vector<std::unique_ptr<TensorOperator> > operators;
+  std::vector<std::unique_ptr<OperatorNode> > nodes;
+};
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_GRAPH_FILE_H
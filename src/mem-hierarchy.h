@@ -0,0 +1,182 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_MEM_HIERARCHY_H
+#define MMCHAIN_ANALYSIS_SRC_MEM_HIERARCHY_H
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <sstream>
+#include "tensor-operator.h"
+#include "util.h"
+
+namespace DAT {
+
+// The tiling of one memory level inside the SRAM, e.g. the register files of the PEs. Every
+// operator tiles each tile of the level above again, with its own tile sizes and dims order.
+// Operators are not fused inside the SRAM, so every tensor of an operator streams from the
+// level above.
+struct LevelTiling {
+  long capacity{0};
+  bool feasible{true};
+  // traffic between this level and the level above
+  long access_volume{0};
+  // the max over operators
+  long mem_footprint{0};
+  std::map<TensorOperator *, std::map<Dim *, long> > tile_sizes;
+  std::map<TensorOperator *, std::vector<Dim *> > dims_orders;
+};
+
+// The capacities of the levels inside the SRAM, from a list "c1, c2, ..." outermost first.
+std::vector<long> parseInnerMemSizes(const std::string &str) {
+  std::vector<long> capacities;
+  std::stringstream ss(str);
+  std::string value;
+  while (std::getline(ss, value, ',')) {
+    if (value.find_first_not_of(" \t") != std::string::npos) {
+      capacities.push_back(std::stol(value));
+    }
+  }
+  return capacities;
+}
+
+// Footprint of an operator holding tiles of tile_sizes, see MatrixMul::analyzeMemFootprint.
+long tileFootprint(TensorOperator *op, const std::map<Dim *, long> &tile_sizes) {
+  long footprint = 0;
+  for (auto t : op->getTensors()) {
+    long tile = t->getFootprintBytes();
+    for (auto d : t->getDims()) {
+      tile *= tile_sizes.at(d);
+    }
+    footprint += tile;
+  }
+  return footprint;
+}
+
+// Traffic between a level holding tiles of outer_sizes and a level holding tiles of inner_sizes,
+// with the same access rule as MatrixMul::analyzeMemAccess: a tensor is reloaded by every loop
+// from its outermost dim inward, and outputs are stored and reloaded as partial sums.
+long tileTraffic(TensorOperator *op,
+                 const std::map<Dim *, long> &outer_sizes,
+                 const std::map<Dim *, long> &inner_sizes,
+                 const std::vector<Dim *> &dims_order) {
+  long outer_tiles = 1;
+  for (auto d : op->getDims()) {
+    outer_tiles *= d->getSize() / outer_sizes.at(d);
+  }
+  auto tensorTraffic = [&](Tensor *t, bool output) {
+    long times = 1;
+    bool access_tensor = false;
+    for (auto d : dims_order) {
+      access_tensor |= t->hasDim(d);
+      if (access_tensor) {
+        times *= outer_sizes.at(d) / inner_sizes.at(d);
+      }
+    }
+    long inner_tile = 1;
+    long outer_tile = 1;
+    for (auto d : t->getDims()) {
+      inner_tile *= inner_sizes.at(d);
+      outer_tile *= outer_sizes.at(d);
+    }
+    if (output) {
+      // the first load of partial sums is skipped
+      return (2 * times * inner_tile - outer_tile) * t->getFootprintBytes();
+    }
+    return times * inner_tile * t->getElementBytes();
+  };
+  long traffic = 0;
+  for (auto t : op->getInputTensors()) {
+    traffic += tensorTraffic(t, false);
+  }
+  for (auto t : op->getOutputTensors()) {
+    traffic += tensorTraffic(t, true);
+  }
+  return outer_tiles * traffic;
+}
+
+// The tiling of one level minimizing its traffic under capacity, by enumerating the factors of
+// the outer tile sizes, pruned by the footprint, and the orders of the dims split at this level.
+// Dims not split run one iteration, so their place in the order never triggers a reload.
+bool optimizeLevelTiling(TensorOperator *op,
+                         const std::map<Dim *, long> &outer_sizes,
+                         long capacity,
+                         std::map<Dim *, long> &best_sizes,
+                         std::vector<Dim *> &best_order,
+                         long &best_traffic) {
+  const std::set<Dim *> op_dims = op->getDims();
+  std::vector<Dim *> dims(op_dims.begin(), op_dims.end());
+  std::map<Dim *, long> sizes;
+  for (auto d : dims) {
+    sizes[d] = 1;
+  }
+  best_traffic = LONG_MAX;
+  std::function<void(size_t)> enumerate = [&](size_t i) {
+    if (tileFootprint(op, sizes) > capacity) {
+      return;
+    }
+    if (i == dims.size()) {
+      std::vector<Dim *> split;
+      std::vector<Dim *> whole;
+      for (auto d : dims) {
+        (sizes[d] < outer_sizes.at(d) ? split : whole).push_back(d);
+      }
+      std::sort(split.begin(), split.end());
+      do {
+        std::vector<Dim *> order = split;
+        order.insert(order.end(), whole.begin(), whole.end());
+        long traffic = tileTraffic(op, outer_sizes, sizes, order);
+        if (traffic < best_traffic) {
+          best_traffic = traffic;
+          best_sizes = sizes;
+          best_order = order;
+        }
+      } while (std::next_permutation(split.begin(), split.end()));
+      return;
+    }
+    // footprints only grow with tile sizes
+    for (auto f : findFactors(outer_sizes.at(dims[i]))) {
+      sizes[dims[i]] = f;
+      if (tileFootprint(op, sizes) > capacity) {
+        break;
+      }
+      enumerate(i + 1);
+    }
+    sizes[dims[i]] = 1;
+  };
+  enumerate(0);
+  return best_traffic != LONG_MAX;
+}
+
+// Tile the block sizes recorded in the dims of operators level by level into the capacities,
+// outermost first. Each level is optimized on the tiles chosen for the level above.
+std::vector<LevelTiling> optimizeInnerLevels(const std::set<TensorOperator *> &operators,
+                                             const std::vector<long> &capacities) {
+  std::vector<LevelTiling> levels;
+  std::map<TensorOperator *, std::map<Dim *, long> > outer_sizes;
+  for (auto op : operators) {
+    outer_sizes[op] = op->getBlockSizes();
+  }
+  for (auto capacity : capacities) {
+    LevelTiling level;
+    level.capacity = capacity;
+    for (auto op : operators) {
+      long traffic;
+      if (!optimizeLevelTiling(op, outer_sizes[op], capacity, level.tile_sizes[op],
+                               level.dims_orders[op], traffic)) {
+        level.feasible = false;
+        break;
+      }
+      level.access_volume += traffic;
+      level.mem_footprint = std::max(level.mem_footprint, tileFootprint(op, level.tile_sizes[op]));
+    }
+    levels.push_back(level);
+    if (!level.feasible) {
+      break;
+    }
+    outer_sizes = level.tile_sizes;
+  }
+  return levels;
+}
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_MEM_HIERARCHY_H
@@ -7,12 +7,15 @@
 
 #include "tensor-operator.h"
 #include "defines.h"
-#include <bitset>
 #include <utility>
 #include "operator-tree.h"
+#include "chain-layout.h"
 
 namespace DAT {
 
+// Link the producer of each fused tensor as a child of its consumers. A tensor with several
+// consumers makes a DAG, whose tree keeps the producer as the child of its first consumer only,
+// see OperatorNode::getConsumers.
 void updateOperatorTreeRelationship(const std::set<DAT::Tensor *> &tensors) {
   for (auto t : tensors) {
     for (auto to : t->getRelatedOperator()) {
@@ -23,21 +26,24 @@ void updateOperatorTreeRelationship(const std::set<DAT::Tensor *> &tensors) {
   for (auto t : tensors) {
     if ((!t->isIO()) && t->isFused()) {
       auto related_ops = t->getRelatedOperator();
-      OperatorNode *parent = nullptr;
       OperatorNode *child = nullptr;
+      std::vector<OperatorNode *> consumers;
       for (auto op : related_ops) {
-        if (op.second == "output" && child == nullptr) {
+        if (op.second == "output") {
+          assert(child == nullptr);
           child = op.first->getLinkedNode();
-        } else if (op.second == "input" && parent == nullptr) {
-          parent = op.first->getLinkedNode();
         } else {
-          assert(0);
+          consumers.push_back(op.first->getLinkedNode());
         }
       }
       assert(child != nullptr);
-      assert(parent != nullptr);
-      parent->addChild(child);
-      child->setParent(parent);
+      assert(!consumers.empty());
+      consumers.front()->addChild(child);
+      child->setParent(consumers.front());
+      for (auto consumer : consumers) {
+        child->addConsumer(consumer);
+        consumer->addProducer(child);
+      }
     }
   }
 }
@@ -46,6 +52,10 @@ class OperatorChain {
 public:
   void setOrder(std::map<OperatorNode *, OrderInfo> o_infos) {
     tree.setOrder(std::move(o_infos));
+    // the loader of a shared input depends on the execute ranks
+    for (auto t : external_tensors) {
+      updateLoadedElsewhere(t);
+    }
     analysisEnvTensors();
     analyzeMemFootprint();
   }
@@ -123,40 +133,38 @@ public:
   [[nodiscard]] long getMemFootprint() const {
     return mem_footprint;
   }
-  [[nodiscard]] long getExternalTensorsFusePattern() const {
-    assert(external_tensors_fuse_pattern >= 0);
+  [[nodiscard]] FusePattern getExternalTensorsFusePattern() const {
+    assert(external_tensors_fuse_pattern.size() == external_tensors.size());
     return external_tensors_fuse_pattern;
   }
   [[nodiscard]] std::map<Tensor *, bool> getExternalTensorsFuseStatus() const {
     assert(!external_tensor_fuse_status.empty());
     return external_tensor_fuse_status;
   }
-  void recordExternalTensorsFuseInfo(long fp) {
-    assert(fp >= 0);
+  void recordExternalTensorsFuseInfo(const FusePattern &fp) {
+    assert(fp.size() == external_tensors.size());
     external_tensors_fuse_pattern = fp;
     external_tensor_fuse_status.clear();
-    std::bitset<MAX_TENSOR_NUM> sub_fuse_or_not(fp);
     long sf_i = 0;
     for (auto t : external_tensors) {
-      if (sub_fuse_or_not[sf_i]) {
-        external_tensor_fuse_status[t] = true;
-      } else {
-        external_tensor_fuse_status[t] = false;
-      }
+      external_tensor_fuse_status[t] = fp[sf_i];
       ++sf_i;
     }
   }
+  void recordExternalTensorsFuseInfo(long fp) {
+    assert(fp >= 0);
+    recordExternalTensorsFuseInfo(FusePattern(external_tensors.size(), fp));
+  }
   void setInternalTensorsFuse() {
     for (auto t : internal_tensors) {
       t->setFuse();
     }
   }
-  void setExternalTensorsFusePattern(long fp) {
+  void setExternalTensorsFusePattern(const FusePattern &fp) {
     recordExternalTensorsFuseInfo(fp);
-    std::bitset<MAX_TENSOR_NUM> sub_fuse_or_not(fp);
     long sf_i = 0;
     for (auto t : external_tensors) {
-      if (sub_fuse_or_not[sf_i]) {
+      if (fp[sf_i]) {
         t->setFuse();
       } else {
         t->unsetFuse();
@@ -164,6 +172,10 @@ public:
       ++sf_i;
     }
   }
+  void setExternalTensorsFusePattern(long fp) {
+    assert(fp >= 0);
+    setExternalTensorsFusePattern(FusePattern(external_tensors.size(), fp));
+  }
   std::string toString() {
     std::string str;
     for (auto op : operators) {
@@ -194,10 +206,12 @@ public:
   void addInternalTensor(Tensor *t) {
     internal_tensors.insert(t);
     t->isExternal(false);
+    updateLoadedElsewhere(t);
   }
   void addExternalTensor(Tensor *t) {
     external_tensors.insert(t);
     t->isExternal(true);
+    updateLoadedElsewhere(t);
   }
   void removeInternalTensor(Tensor *t) {
     internal_tensors.erase(t);
@@ -217,9 +231,11 @@ public:
   void setTensorsIsExternal() {
     for (auto t : internal_tensors) {
       t->isExternal(false);
+      updateLoadedElsewhere(t);
     }
     for (auto t : external_tensors) {
       t->isExternal(true);
+      updateLoadedElsewhere(t);
     }
   }
   long compute_time() {
@@ -229,10 +245,69 @@ public:
     }
     return t;
   }
+  // Roofline latency: operator groups run one after another, each taking the longer of its
+  // compute time and its DRAM traffic over options().dram_bandwidth. Pipelined groups run at the
+  // same time on compute partitions sized by their compute times, so the pipeline is bound by
+  // the total compute time or the total traffic over the shared bandwidth.
+  long latency() {
+    if (options().pipeline) {
+      long compute = 0;
+      long traffic = 0;
+      for (auto to : operators) {
+        compute += to->compute_time();
+        traffic += to->getAccessVolume();
+      }
+      return std::max(compute, (traffic + options().dram_bandwidth - 1) / options().dram_bandwidth);
+    }
+    long t = 0;
+    for (const auto &og : operator_groups) {
+      long compute = 0;
+      long traffic = 0;
+      for (auto to : og) {
+        compute += to->compute_time();
+        traffic += to->getAccessVolume();
+      }
+      t += std::max(compute, (traffic + options().dram_bandwidth - 1) / options().dram_bandwidth);
+    }
+    return t;
+  }
 
   std::vector<std::set<TensorOperator *> > getOperatorGroups() {
     return operator_groups;
   }
+  // A fused tensor passed between two operator groups, which is an inter-stage buffer when the
+  // groups are pipelined.
+  bool isStageTensor(Tensor *t) {
+    int group_ind = -1;
+    for (const auto &ro : t->getRelatedOperator()) {
+      if (operators.count(ro.first)) {
+        if (group_ind >= 0 && ro.first->getGroupInd() != group_ind) {
+          return true;
+        }
+        group_ind = ro.first->getGroupInd();
+      }
+    }
+    return false;
+  }
+
+  BlockSizes getBlockSizes() {
+    BlockSizes block_sizes;
+    for (auto op : operators) {
+      block_sizes[op] = op->getBlockSizes();
+    }
+    return block_sizes;
+  }
+  // Evaluate the costs of many candidate orders at once. The chain itself, its tensors and dims
+  // are left unchanged, so the result of each candidate equals setOrder followed by the getters.
+  std::vector<ChainCost> evaluateOrders(const std::vector<OperatorTree> &order_trees,
+                                        const std::vector<BlockSizes> &block_sizes,
+                                        const SimdKernels &kernels = simdKernels()) {
+    ChainLayout layout(operators, tree.getNodes());
+    return layout.evaluate(order_trees, block_sizes, kernels);
+  }
+  std::vector<ChainCost> evaluateOrders(const std::vector<OperatorTree> &order_trees) {
+    return evaluateOrders(order_trees, {getBlockSizes()});
+  }
 
 
 protected:
@@ -254,25 +329,62 @@ protected:
     }
   }
 
+  // A fused tensor stays in SRAM from the first to the last operator of the chain using it, e.g.
+  // an output until its last consumer runs, so the operators executed in between hold it as well.
+  // A larger execute rank runs earlier.
   void analysisEnvTensors() {
     auto op_nodes = tree.getNodes();
     auto order_infos = tree.getOrderInfos();
     for (auto node : op_nodes) {
       node->getOperator()->clearEnvTensors();
     }
-    for (auto node : op_nodes) {
-      auto exec_rank_this = order_infos[node].execute_rank;
-      auto exec_rank_parent = order_infos[node->getParent()].execute_rank;
-      for (auto op : op_nodes) {
-        if (op != node && op != node->getParent()) {
-          auto exec_rank = order_infos[op].execute_rank;
-          // the ">=, <=" is desired when allow multi-operators execute together
-          if (exec_rank > exec_rank_parent && exec_rank < exec_rank_this) {
-            op->getOperator()->addEnvTensor(node->getOperator()->getOutputTensors());
-          }
+    for (auto t : tensors) {
+      if (!t->isFused()) {
+        continue;
+      }
+      std::vector<int> ranks;
+      for (const auto &ro : t->getRelatedOperator()) {
+        if (operators.count(ro.first)) {
+          ranks.push_back(order_infos[ro.first->getLinkedNode()].execute_rank);
+        }
+      }
+      if (ranks.size() < 2) {
+        continue;
+      }
+      auto rank_range = std::minmax_element(ranks.begin(), ranks.end());
+      for (auto node : op_nodes) {
+        auto exec_rank = order_infos[node].execute_rank;
+        // the ">=, <=" is desired when allow multi-operators execute together
+        if (exec_rank > *rank_range.first && exec_rank < *rank_range.second
+            && !node->getOperator()->hasTensor(t)) {
+          node->getOperator()->addEnvTensor(t);
+        }
+      }
+    }
+  }
+
+  // A fused input shared by several operators of the chain is loaded by the first of them to run
+  // only, the one of the largest execute rank, or the first in address order among equal ranks.
+  void updateLoadedElsewhere(Tensor *t) {
+    auto order_infos = tree.getOrderInfos();
+    TensorOperator *loader = nullptr;
+    int loader_rank = 0;
+    for (auto op : operators) {
+      auto inputs = op->getInputTensors();
+      if (std::find(inputs.begin(), inputs.end(), t) != inputs.end()) {
+        int rank = order_infos.count(op->getLinkedNode()) ? order_infos[op->getLinkedNode()].execute_rank : -1;
+        if (!loader || rank > loader_rank) {
+          loader = op;
+          loader_rank = rank;
         }
       }
     }
+    for (auto op : operators) {
+      auto inputs = op->getInputTensors();
+      if (std::find(inputs.begin(), inputs.end(), t) != inputs.end()) {
+        t->isLoadedElsewhere(op, op != loader && t->isExternal());
+      }
+    }
   }
 
   void clearMemAccess() {
@@ -315,7 +427,13 @@ protected:
 
     buildOperatorGroup();
 
-    for (const auto& og : operator_groups) {
+    // pipelined operator groups run at the same time, so their tensors are all in SRAM, and a
+    // tensor passed between two stages is double buffered
+    std::vector<std::set<TensorOperator *> > footprint_groups = operator_groups;
+    if (options().pipeline) {
+      footprint_groups = {operators};
+    }
+    for (const auto& og : footprint_groups) {
       long og_mem_footprint = 0;
       std::string og_mem_footprint_str = "0";
       std::vector<Tensor *> op_tensors;
@@ -347,6 +465,10 @@ protected:
               }
             }
           }
+          if (options().pipeline && isStageTensor(t)) {
+            max_footprint *= 2;
+            max_footprint_str = "2 * " + max_footprint_str;
+          }
           og_mem_footprint += max_footprint;
           og_mem_footprint_str += " + " + max_footprint_str;
         } else {
@@ -359,6 +481,12 @@ protected:
           }
         }
       }
+      for (auto op : og) {
+        if (op->getStateFootprint() > 0) {
+          og_mem_footprint += op->getStateFootprint();
+          og_mem_footprint_str += " + state " + op->getStateFootprintStr();
+        }
+      }
       total_mem_footprint = std::max(total_mem_footprint, og_mem_footprint);
       total_mem_footprint_str += og_mem_footprint_str + ", ";
     }
@@ -366,25 +494,21 @@ protected:
     mem_footprint_str = total_mem_footprint_str;
   }
 
+  // Every root, the sinks of a DAG, starts a group, and a child joins the group of its parent
+  // when the parent expands its reduce dim in the output of the child.
   void buildOperatorGroup() {
     operator_groups.clear();
-    std::set<TensorOperator *> og;
-    og.insert(tree.getRoot()->getOperator());
-    operator_groups.push_back(og);
-    tree.getRoot()->getOperator()->setGroupInd(0);
     for (auto op_node : tree.getNodes()) {
-      if (!op_node->isRoot()) {
-        TensorOperator *op = op_node->getOperator();
-        TensorOperator *op_p = op_node->getParent()->getOperator();
-        if (op_p->isReduceDimExpended(op->getOutputTensor(0))) {
-          operator_groups.at(op_p->getGroupInd()).insert(op);
-          op->setGroupInd(op_p->getGroupInd());
-        } else {
-          std::set<TensorOperator *> new_og;
-          new_og.insert(op);
-          op->setGroupInd(operator_groups.size());
-          operator_groups.push_back(new_og);
-        }
+      TensorOperator *op = op_node->getOperator();
+      TensorOperator *op_p = op_node->isRoot() ? nullptr : op_node->getParent()->getOperator();
+      if (op_p && op_p->isReduceDimExpended(op->getOutputTensor(0))) {
+        operator_groups.at(op_p->getGroupInd()).insert(op);
+        op->setGroupInd(op_p->getGroupInd());
+      } else {
+        std::set<TensorOperator *> new_og;
+        new_og.insert(op);
+        op->setGroupInd(operator_groups.size());
+        operator_groups.push_back(new_og);
       }
     }
   }
@@ -402,7 +526,7 @@ protected:
   long mem_access_volume;
   long mem_footprint;
   std::string mem_footprint_str;
-  long external_tensors_fuse_pattern{-1};
+  FusePattern external_tensors_fuse_pattern;
   std::map<Tensor *, bool> external_tensor_fuse_status;
 };
 
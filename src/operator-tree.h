@@ -47,6 +47,22 @@ public:
   [[nodiscard]] std::vector<OperatorNode *> getChildren() const {
     return children;
   }
+  // All operators consuming the output in the chain, the parent first. A tensor consumed by
+  // several operators makes the chain a DAG, whose tree keeps the first consumer as the parent.
+  [[nodiscard]] std::vector<OperatorNode *> getConsumers() const {
+    return consumers;
+  }
+  void addConsumer(OperatorNode *op_node) {
+    consumers.push_back(op_node);
+  }
+  // All operators producing an input in the chain, the children and the producers of tensors
+  // shared with other consumers.
+  [[nodiscard]] std::vector<OperatorNode *> getProducers() const {
+    return producers;
+  }
+  void addProducer(OperatorNode *op_node) {
+    producers.push_back(op_node);
+  }
   bool isRoot() {
     return parent == nullptr;
   }
@@ -141,12 +157,14 @@ public:
   }
   void clearParent() {
     parent = nullptr;
+    consumers.clear();
   }
   void clearChildren() {
     for (auto &c : children) {
       c = nullptr;
     }
     children.clear();
+    producers.clear();
   }
 
 private:
@@ -154,6 +172,8 @@ private:
   OrderInfo order_info{this};
   OperatorNode *parent{nullptr};
   std::vector<OperatorNode *> children;
+  std::vector<OperatorNode *> consumers;
+  std::vector<OperatorNode *> producers;
 };
 
 class OperatorTree {
@@ -170,20 +190,51 @@ public:
       root = root->getParent();
     }
   }
+  // The nodes of the tree from the root, then of the trees of the other sinks of a DAG, which
+  // are reached through the consumers of shared tensors.
   void updateNodes() {
     if (!root->isRoot()) {
       updateRoot();
     }
-    nodes = breadthFirstSort(root);
-    root->getOperator();
+    roots = {root};
+    std::set<OperatorNode *> visited{root};
+    std::queue<OperatorNode *> queue;
+    queue.push(root);
+    while (!queue.empty()) {
+      OperatorNode *node = queue.front();
+      queue.pop();
+      std::vector<OperatorNode *> linked = node->getConsumers();
+      std::vector<OperatorNode *> producers = node->getProducers();
+      linked.insert(linked.end(), producers.begin(), producers.end());
+      for (auto l : linked) {
+        if (visited.insert(l).second) {
+          queue.push(l);
+          if (l->isRoot()) {
+            roots.push_back(l);
+          }
+        }
+      }
+    }
+    nodes.clear();
+    for (auto r : roots) {
+      auto tree_nodes = breadthFirstSort(r);
+      nodes.insert(nodes.end(), tree_nodes.begin(), tree_nodes.end());
+    }
   }
   [[nodiscard]] std::vector<OperatorNode *> getNodes() const {
     return nodes;
   }
+  // The root first, then the other sinks of a DAG.
+  [[nodiscard]] std::vector<OperatorNode *> getRoots() const {
+    return roots;
+  }
+  // The other sinks of a DAG are not constrained by any consumer.
   void setDimsOrder(const std::vector<Dim *> &init_dims_order_c,
                     std::vector<std::vector<int>> offsets) {
     assert(offsets.size() == nodes.size());
-    root->setDimsOrderConstraint(init_dims_order_c);
+    for (auto r : roots) {
+      r->setDimsOrderConstraint(r == root ? init_dims_order_c : std::vector<Dim *>());
+    }
     int i = 0;
     for (const auto &node : nodes) {
       node->setDimsOrder(offsets[i]);
@@ -219,7 +270,7 @@ public:
       order_infos[o_i.first].execute_rank = o_i.second.execute_rank;
     }
   }
-  std::map<OperatorNode *, OrderInfo> getOrderInfos() {
+  [[nodiscard]] std::map<OperatorNode *, OrderInfo> getOrderInfos() const {
     return order_infos;
   }
   void setOrderInfos(std::map<OperatorNode *, OrderInfo> o_infos) {
@@ -272,7 +323,11 @@ public:
   }
 
   std::string toStringExecuteOrder() {
-    return toStringExecuteOrder(root);
+    std::string ret;
+    for (auto r : roots) {
+      ret += toStringExecuteOrder(r);
+    }
+    return ret;
   }
 
 private:
@@ -284,6 +339,7 @@ private:
   }
 
   OperatorNode *root{nullptr};
+  std::vector<OperatorNode *> roots;
   std::vector<OperatorNode *> nodes;
   std::map<OperatorNode *, OrderInfo> order_infos;
 };
@@ -11,30 +11,65 @@
 #include <boost/filesystem.hpp>
 #include <iomanip>
 #include <fstream>
+#include <random>
+#include <memory>
+#include <map>
+#include <stdexcept>
+#include <climits>
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
 
 namespace DAT {
 
+class OrderCache;
+
 class Options {
 public:
-  static std::string log_directory;
-  static bool print_to_screen;
-  static int save_log_file;
-  static bool store_whole_block;
-  static long mem_size;
-  static long seq_length;
-  static long hid_size;
-  static long head_num;
-  static long head_blocksize;
-  static long batch_size;
-  static long batch_blocksize;
-  static std::string dim_order_opt;
-  static long compute_power;
-  static bool enable_compute_utilization_constraint;
-
-  static int parse(int argc, char *argv[]) {
+  std::string log_directory;
+  bool print_to_screen{false};
+  int save_log_file{0};
+  bool store_whole_block{true};
+  long mem_size{LONG_MAX};
+  long seq_length{0};
+  long hid_size{0};
+  long head_num{0};
+  long kv_head_num{0};
+  long head_blocksize{0};
+  long batch_size{0};
+  long batch_blocksize{0};
+  long kv_cache_length{0};
+  long decode_tokens{1};
+  bool softmax{false};
+  std::string workload{"attention"};
+  std::string graph_file;
+  long layer_num{1};
+  long ffn_size{0};
+  bool shared_tensors{false};
+  std::string dim_order_opt;
+  std::string fuse_search{"auto"};
+  long max_traversal_tensors{16};
+  std::string mip_formulation{"nonconvex"};
+  long compute_power{1024};
+  std::string objective{"access_volume"};
+  long dram_bandwidth{64};
+  long weight_bytes{1};
+  long activation_bytes{1};
+  long score_bytes{1};
+  long accumulator_bytes{1};
+  long buffer_num{1};
+  long core_num{1};
+  bool pipeline{false};
+  bool simulate{false};
+  std::string inner_mem_sizes;
+  bool enable_compute_utilization_constraint{false};
+  std::string sweep;
+  std::string sweep_result{"sweep.csv"};
+  long threads{0};
+  bool monotone_mem_sweep{true};
+  std::string pareto_result;
+
+  int parse(int argc, char *argv[]) {
     std::time_t t = std::time(nullptr);
     std::tm tm = *std::localtime(&t);
     // format date and time
@@ -57,6 +92,36 @@ public:
         ("dim_order_opt",
          po::value<std::string>(&dim_order_opt)->default_value(""),
          "The dimension orders optimization method(random, genetic, traversal)")
+        ("fuse_search",
+         po::value<std::string>(&fuse_search)->default_value("auto"),
+         "The fusion search method(traversal, dp, greedy, auto)")
+        ("max_traversal_tensors",
+         po::value<long>(&max_traversal_tensors)->default_value(16),
+         "The most non-IO tensors auto traverses the fuse patterns of")
+        ("objective",
+         po::value<std::string>(&objective)->default_value("access_volume"),
+         "The objective of the search(access_volume, latency)")
+        ("mip_formulation",
+         po::value<std::string>(&mip_formulation)->default_value("nonconvex"),
+         "The block size MIP formulation(nonconvex, log)")
+        ("sweep",
+         po::value<std::string>(&sweep)->default_value(""),
+         "name of a sweep spec file, run every point of it in one process")
+        ("sweep_result",
+         po::value<std::string>(&sweep_result)->default_value("sweep.csv"),
+         "the result table of a sweep")
+        ("threads",
+         po::value<long>(&threads)->default_value(0),
+         "number of threads running sweep points, 0 for the hardware concurrency")
+        ("monotone_mem_sweep",
+         po::value<bool>(&monotone_mem_sweep)->default_value(true),
+         "run the mem_size points of a sweep from large to small, pruning by the larger ones")
+        ("simulate",
+         po::value<bool>(&simulate)->default_value(false),
+         "replay the chosen schedules over tiles and print the simulated traffic and footprint")
+        ("pareto_result",
+         po::value<std::string>(&pareto_result)->default_value(""),
+         "write the (access volume, SRAM footprint, compute time) Pareto front to this file")
         ("store_whole_block",
          po::value<bool>(&store_whole_block)->default_value(true),
          "Compute whole block size in mem footprint");
@@ -69,21 +134,56 @@ public:
 
     po::options_description hw_constraints("Hardware constraints options");
     hw_constraints.add_options()
-        ("mem_size", po::value<long>(&mem_size)->default_value(LONG_MAX), "memory size constraint")
+        ("mem_size", po::value<long>(&mem_size)->default_value(LONG_MAX), "memory size constraint in bytes")
         ("enable_compute_utilization_constraint",
          po::value<bool>(&enable_compute_utilization_constraint)->default_value(false),
          "enable compute utilization constraint")
-        ("compute_power", po::value<long>(&compute_power)->default_value(1024), "compute power");
+        ("compute_power", po::value<long>(&compute_power)->default_value(1024), "compute power")
+        ("weight_bytes", po::value<long>(&weight_bytes)->default_value(1), "bytes of a weight element")
+        ("activation_bytes", po::value<long>(&activation_bytes)->default_value(1),
+         "bytes of an activation element")
+        ("score_bytes", po::value<long>(&score_bytes)->default_value(1),
+         "bytes of an attention score element")
+        ("accumulator_bytes", po::value<long>(&accumulator_bytes)->default_value(1),
+         "bytes of a partial sum element")
+        ("core_num", po::value<long>(&core_num)->default_value(1),
+         "number of cores, each with mem_size of SRAM, sharing the DRAM bandwidth")
+        ("pipeline", po::value<bool>(&pipeline)->default_value(false),
+         "run the operator groups of a chain at the same time on disjoint compute partitions")
+        ("buffer_num", po::value<long>(&buffer_num)->default_value(1),
+         "SRAM buffers of each streamed tile, 2 for double buffering")
+        ("inner_mem_sizes", po::value<std::string>(&inner_mem_sizes)->default_value(""),
+         "capacities of the memory levels inside the SRAM in bytes, outermost first, e.g. \"4096, 256\"")
+        ("dram_bandwidth", po::value<long>(&dram_bandwidth)->default_value(64),
+         "DRAM bandwidth in bytes per cycle, for the latency objective");
 
     po::options_description app_config("Application configuration options");
     app_config.add_options()
         ("seq_length", po::value<long>(&seq_length)->default_value(0), "sequence length")
         ("hid_size", po::value<long>(&hid_size)->default_value(0), "hidden dimension size")
         ("head_num", po::value<long>(&head_num)->default_value(0), "head number")
+        ("kv_head_num", po::value<long>(&kv_head_num)->default_value(0),
+         "K/V head number of grouped query attention, 1 for multi-query attention, 0 for head_num")
         ("head_blocksize", po::value<long>(&head_blocksize)->default_value(0), "head block size")
         ("batch_size", po::value<long>(&batch_size)->default_value(0), "batch size")
         ("batch_blocksize", po::value<long>(&batch_blocksize)->default_value(0),
-         "batch block size");
+         "batch block size")
+        ("kv_cache_length", po::value<long>(&kv_cache_length)->default_value(0),
+         "cached keys and values each decode step attends to, 0 for the prefill of seq_length tokens")
+        ("decode_tokens", po::value<long>(&decode_tokens)->default_value(1),
+         "new tokens of each sequence in a decode step")
+        ("softmax", po::value<bool>(&softmax)->default_value(false),
+         "add the softmax of the attention scores to the graph")
+        ("workload", po::value<std::string>(&workload)->default_value("attention"),
+         "the graph explored(attention, transformer_block)")
+        ("graph_file", po::value<std::string>(&graph_file)->default_value(""),
+         "a text file of the graph explored instead of the workload")
+        ("layer_num", po::value<long>(&layer_num)->default_value(1),
+         "layers of the graph file explored back to back, fused across the boundary of the file")
+        ("ffn_size", po::value<long>(&ffn_size)->default_value(0),
+         "FFN hidden size of a transformer block, 0 for 4 times head_num * hid_size")
+        ("shared_tensors", po::value<bool>(&shared_tensors)->default_value(false),
+         "share a tensor read by several operators instead of copying it for each of them");
 
     po::options_description all_options("Allows options");
     all_options.add(desc);
@@ -109,27 +209,115 @@ public:
       exit(0);
     }
 
+    check();
+
     if (!fs::exists(log_directory) && save_log_file)
       fs::create_directory(log_directory);
 
     return 0;
   }
+
+  // Throw std::invalid_argument on option values no graph can be built from.
+  void check() const {
+    if (workload != "attention" && workload != "transformer_block") {
+      throw std::invalid_argument("unknown workload: " + workload);
+    }
+    if (kv_head_num < 0 || (kv_head_num > 0 && head_num % kv_head_num != 0)) {
+      throw std::invalid_argument("head_num " + std::to_string(head_num) + " should be a multiple of kv_head_num "
+                                  + std::to_string(kv_head_num));
+    }
+  }
+
+  // The options of integer values by name, for the options swept over and the dim sizes of graph
+  // files.
+  std::map<std::string, long *> longOptions() {
+    return {
+        {"mem_size", &mem_size}, {"seq_length", &seq_length}, {"hid_size", &hid_size},
+        {"head_num", &head_num}, {"kv_head_num", &kv_head_num}, {"head_blocksize", &head_blocksize},
+        {"batch_size", &batch_size}, {"batch_blocksize", &batch_blocksize}, {"kv_cache_length", &kv_cache_length},
+        {"decode_tokens", &decode_tokens}, {"compute_power", &compute_power},
+        {"dram_bandwidth", &dram_bandwidth}, {"weight_bytes", &weight_bytes},
+        {"activation_bytes", &activation_bytes}, {"score_bytes", &score_bytes},
+        {"accumulator_bytes", &accumulator_bytes}, {"buffer_num", &buffer_num},
+        {"core_num", &core_num}, {"ffn_size", &ffn_size}, {"max_traversal_tensors", &max_traversal_tensors},
+        {"layer_num", &layer_num}};
+  }
+
+  // Set an option by its name, for the options swept over.
+  void set(const std::string &name, const std::string &value) {
+    std::map<std::string, long *> long_options = longOptions();
+    std::map<std::string, std::string *> string_options = {
+        {"dim_order_opt", &dim_order_opt}, {"mip_formulation", &mip_formulation},
+        {"objective", &objective}, {"inner_mem_sizes", &inner_mem_sizes}, {"workload", &workload},
+        {"fuse_search", &fuse_search}, {"graph_file", &graph_file}};
+    if (long_options.count(name)) {
+      *long_options[name] = std::stol(value);
+    } else if (string_options.count(name)) {
+      *string_options[name] = value;
+    } else if (name == "enable_compute_utilization_constraint") {
+      enable_compute_utilization_constraint = std::stol(value) != 0;
+    } else if (name == "pipeline") {
+      pipeline = std::stol(value) != 0;
+    } else if (name == "softmax") {
+      softmax = std::stol(value) != 0;
+    } else if (name == "shared_tensors") {
+      shared_tensors = std::stol(value) != 0;
+    } else {
+      throw std::invalid_argument("option can not be swept: " + name);
+    }
+  }
+};
+
+// The state of one exploration besides its graph: its options and its random engine. Every
+// thread reads the options and draws random numbers from its current context, so explorations
+// with different options can run concurrently in one process.
+class Context {
+public:
+  Context() : rng(std::random_device{}()) {}
+  explicit Context(Options o) : options(std::move(o)), rng(std::random_device{}()) {}
+  Context(Options o, unsigned seed) : options(std::move(o)), rng(seed) {}
+
+  Options options;
+  std::default_random_engine rng;
+  // shared by the contexts of a sweep, none by default
+  std::shared_ptr<OrderCache> order_cache;
+};
+
+Context *&currentContextPtr() {
+  thread_local Context *current = nullptr;
+  return current;
+}
+
+// The context of the calling thread, a default one if none is installed.
+Context &currentContext() {
+  thread_local Context default_context;
+  Context *current = currentContextPtr();
+  return current ? *current : default_context;
+}
+
+// Install a context as the current one of the calling thread within a scope.
+class ContextScope {
+public:
+  explicit ContextScope(Context &context) : previous(currentContextPtr()) {
+    currentContextPtr() = &context;
+  }
+  ~ContextScope() {
+    currentContextPtr() = previous;
+  }
+  ContextScope(const ContextScope &) = delete;
+  ContextScope &operator=(const ContextScope &) = delete;
+
+private:
+  Context *previous;
 };
 
-std::string Options::log_directory;
-bool Options::print_to_screen;
-int Options::save_log_file;
-bool Options::store_whole_block = true;
-long Options::mem_size;
-long Options::seq_length;
-long Options::hid_size;
-long Options::head_num;
-long Options::head_blocksize;
-long Options::batch_size;
-long Options::batch_blocksize;
-std::string Options::dim_order_opt;
-long Options::compute_power;
-bool Options::enable_compute_utilization_constraint;
+Options &options() {
+  return currentContext().options;
+}
+
+std::default_random_engine &rng() {
+  return currentContext().rng;
+}
 
 }
 
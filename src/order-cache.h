@@ -0,0 +1,209 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_ORDER_CACHE_H
+#define MMCHAIN_ANALYSIS_SRC_ORDER_CACHE_H
+
+#include <atomic>
+#include <cctype>
+#include <cfloat>
+#include <mutex>
+#include <sstream>
+#include <typeinfo>
+#include "operator-chain.h"
+#include "options.h"
+
+namespace DAT {
+
+// Results of the execute and dims order search of operator chains, keyed by everything the
+// search depends on. Operators and dims are identified by names instead of pointers, so one
+// cache is shared by the explorations of different graphs, e.g. all points of a sweep. The layers
+// of the names <name>_<layer> of a graph file of several layers are counted from the first layer
+// of the chain, so the same chain in every layer shares one entry.
+class OrderCache {
+public:
+  struct Entry {
+    bool infeasible{true};
+    double obj{FLT_MAX};
+    // indexed by operator names
+    std::map<std::string, std::vector<std::string> > dims_orders;
+    std::map<std::string, std::vector<std::string> > dims_order_constraints;
+    std::map<std::string, int> execute_ranks;
+  };
+
+  // An empty key means the chain can not be cached, e.g. its operators have no names. With
+  // relative_layers false, the chains of different layers have different keys.
+  static std::string key(OperatorChain *op_chain, long mem_size, bool relative_layers = true) {
+    const Options &o = options();
+    std::ostringstream key;
+    key << mem_size << "|" << o.dim_order_opt << "|" << o.mip_formulation << "|" << o.objective << "|"
+        << o.dram_bandwidth << "|" << o.buffer_num << "|" << o.pipeline << "|"
+        << o.enable_compute_utilization_constraint << "|" << o.compute_power << "|"
+        << o.store_whole_block << "|" << o.batch_blocksize << "|" << o.head_blocksize;
+    std::set<TensorOperator *> ops = op_chain->getOperators();
+    for (auto op : ops) {
+      if (!op->hasName()) {
+        return "";
+      }
+    }
+    long first_layer = relative_layers ? firstLayer(ops) : 0;
+    std::map<std::string, TensorOperator *> named_ops;
+    for (auto op : ops) {
+      named_ops[relativeName(op->getName(), first_layer)] = op;
+    }
+    for (const auto &named_op : named_ops) {
+      TensorOperator *op = named_op.second;
+      key << "|" << named_op.first << ":" << typeid(*op).name() << ":" << op->is_with_bias();
+      // the names no longer tell apart operators of a graph differing only in these
+      if (auto element_wise = dynamic_cast<ElementWise *>(op)) {
+        key << ":o" << element_wise->getOpsPerElement();
+      }
+      if (auto row_norm = dynamic_cast<RowNormalization *>(op)) {
+        key << ":n" << row_norm->getNormalizeDim()->getName();
+      }
+      if (op->getDim("bsc")) {
+        key << ":b" << op->isBatchDependent();
+      }
+      if (op->getDim("hsc")) {
+        key << ":h" << op->isHeadDependent();
+      }
+      std::map<std::string, long> dim_sizes;
+      for (auto d : op->getDims()) {
+        dim_sizes[d->getName()] = d->getSize();
+      }
+      if (dim_sizes.size() != op->getDims().size()) {
+        return "";
+      }
+      for (const auto &ds : dim_sizes) {
+        key << "," << ds.first << "=" << ds.second;
+      }
+      for (auto t : op->getTensors()) {
+        key << "," << relativeName(t->getName(), first_layer) << (t->isFused() ? "F" : "U") << (t->isIO() ? "I" : "")
+            << (t->isExternal() ? "E" : "") << t->getElementBytes() << "/" << t->getFootprintBytes() << "(";
+        for (auto d : t->getDims()) {
+          key << d->getName() << " ";
+        }
+        key << ")";
+      }
+    }
+    return key.str();
+  }
+
+  bool lookup(const std::string &key, Entry &entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+      ++miss_num;
+      return false;
+    }
+    ++hit_num;
+    entry = it->second;
+    return true;
+  }
+  void store(const std::string &key, const Entry &entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[key] = entry;
+  }
+
+  static Entry toEntry(bool infeasible, double obj, const OperatorTree &order_tree) {
+    Entry entry;
+    entry.infeasible = infeasible;
+    entry.obj = obj;
+    if (!infeasible) {
+      auto o_infos = order_tree.getOrderInfos();
+      long first_layer = firstLayer(treeOperators(order_tree));
+      for (auto node : order_tree.getNodes()) {
+        const OrderInfo &o_info = o_infos[node];
+        std::string op_name = relativeName(node->getOperator()->getName(), first_layer);
+        for (auto d : o_info.dims_order) {
+          entry.dims_orders[op_name].push_back(d->getName());
+        }
+        for (auto d : o_info.dims_order_constraint) {
+          entry.dims_order_constraints[op_name].push_back(d->getName());
+        }
+        entry.execute_ranks[op_name] = o_info.execute_rank;
+      }
+    }
+    return entry;
+  }
+  // The order tree of the entry on the operators and dims of op_chain.
+  static OperatorTree toOrderTree(OperatorChain *op_chain, const Entry &entry) {
+    OperatorTree order_tree = op_chain->getOperatorTree();
+    std::map<OperatorNode *, OrderInfo> o_infos;
+    long first_layer = firstLayer(treeOperators(order_tree));
+    for (auto node : order_tree.getNodes()) {
+      TensorOperator *op = node->getOperator();
+      std::string op_name = relativeName(op->getName(), first_layer);
+      OrderInfo o_info(node);
+      o_info.free_dims = op->getDims();
+      for (const auto &name : entry.dims_orders.at(op_name)) {
+        o_info.dims_order.push_back(op->getDim(name));
+      }
+      if (entry.dims_order_constraints.count(op_name)) {
+        for (const auto &name : entry.dims_order_constraints.at(op_name)) {
+          o_info.dims_order_constraint.push_back(op->getDim(name));
+          o_info.free_dims.erase(op->getDim(name));
+        }
+      }
+      o_info.execute_rank = entry.execute_ranks.at(op_name);
+      o_infos[node] = o_info;
+    }
+    order_tree.setOrderInfos(o_infos);
+    return order_tree;
+  }
+
+  [[nodiscard]] long getHitNum() const {
+    return hit_num;
+  }
+  [[nodiscard]] long getMissNum() const {
+    return miss_num;
+  }
+
+private:
+  // The layer of a name <name>_<layer>, see GraphFile, or 0.
+  static long nameLayer(const std::string &name) {
+    size_t underscore = name.rfind('_');
+    if (underscore == std::string::npos || underscore + 1 == name.size() || name.size() - underscore > 10) {
+      return 0;
+    }
+    for (size_t i = underscore + 1; i < name.size(); ++i) {
+      if (!std::isdigit(static_cast<unsigned char>(name[i]))) {
+        return 0;
+      }
+    }
+    return std::stol(name.substr(underscore + 1));
+  }
+  // The first layer of the names of the operators, 0 if none has a layer.
+  static long firstLayer(const std::set<TensorOperator *> &ops) {
+    long first_layer = 0;
+    for (auto op : ops) {
+      long layer = nameLayer(op->getName());
+      if (layer > 0 && (first_layer == 0 || layer < first_layer)) {
+        first_layer = layer;
+      }
+    }
+    return first_layer;
+  }
+  // The name with its layer counted from first_layer, which may be 0 or less for a tensor of a
+  // layer before the chain.
+  static std::string relativeName(const std::string &name, long first_layer) {
+    long layer = nameLayer(name);
+    if (layer == 0 || first_layer == 0) {
+      return name;
+    }
+    return name.substr(0, name.rfind('_') + 1) + std::to_string(layer - first_layer + 1);
+  }
+  static std::set<TensorOperator *> treeOperators(const OperatorTree &order_tree) {
+    std::set<TensorOperator *> ops;
+    for (auto node : order_tree.getNodes()) {
+      ops.insert(node->getOperator());
+    }
+    return ops;
+  }
+
+  std::mutex mutex;
+  std::map<std::string, Entry> entries;
+  std::atomic<long> hit_num{0};
+  std::atomic<long> miss_num{0};
+};
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_ORDER_CACHE_H
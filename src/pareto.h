@@ -0,0 +1,107 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_PARETO_H
+#define MMCHAIN_ANALYSIS_SRC_PARETO_H
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace DAT {
+
+// A schedule in the objective space, every objective is minimized.
+struct ParetoPoint {
+  long access_volume{0};
+  long mem_footprint{0};
+  long compute_time{0};
+  std::string schedule;
+
+  // no worse in every objective
+  [[nodiscard]] bool covers(const ParetoPoint &p) const {
+    return access_volume <= p.access_volume && mem_footprint <= p.mem_footprint
+        && compute_time <= p.compute_time;
+  }
+};
+
+// The non-dominated schedules of (access volume, SRAM footprint, compute time). Points are kept
+// sorted by access volume, so the points which may dominate a new point are a prefix and the
+// points it may dominate are a suffix, and most of the archive is never compared.
+class ParetoArchive {
+public:
+  // Insert p unless a point of the archive covers it, removing the points p dominates. Return
+  // whether p is inserted.
+  bool insert(const ParetoPoint &p) {
+    auto first_not_better = std::upper_bound(
+        points.begin(), points.end(), p.access_volume,
+        [](long v, const ParetoPoint &q) { return v < q.access_volume; });
+    for (auto it = points.begin(); it != first_not_better; ++it) {
+      if (it->covers(p)) {
+        return false;
+      }
+    }
+    auto first_not_worse = std::lower_bound(
+        points.begin(), points.end(), p.access_volume,
+        [](const ParetoPoint &q, long v) { return q.access_volume < v; });
+    auto end = std::remove_if(first_not_worse, points.end(),
+                              [&p](const ParetoPoint &q) { return p.covers(q); });
+    points.erase(end, points.end());
+    points.insert(std::lower_bound(
+        points.begin(), points.end(), p,
+        [](const ParetoPoint &a, const ParetoPoint &b) {
+          return std::tie(a.access_volume, a.mem_footprint, a.compute_time)
+              < std::tie(b.access_volume, b.mem_footprint, b.compute_time);
+        }), p);
+    return true;
+  }
+  void insert(const ParetoArchive &archive) {
+    for (const auto &p : archive.points) {
+      insert(p);
+    }
+  }
+
+  // The non-dominated schedules running one schedule of a then one of b: access volumes and
+  // compute times add up, the SRAM is reused so footprints take the max.
+  static ParetoArchive sequence(const ParetoArchive &a, const ParetoArchive &b) {
+    ParetoArchive archive;
+    for (const auto &pa : a.points) {
+      for (const auto &pb : b.points) {
+        archive.insert({pa.access_volume + pb.access_volume,
+                        std::max(pa.mem_footprint, pb.mem_footprint),
+                        pa.compute_time + pb.compute_time,
+                        pa.schedule.empty() ? pb.schedule : pa.schedule + " " + pb.schedule});
+      }
+    }
+    return archive;
+  }
+
+  [[nodiscard]] const std::vector<ParetoPoint> &getPoints() const {
+    return points;
+  }
+  [[nodiscard]] size_t size() const {
+    return points.size();
+  }
+  [[nodiscard]] bool empty() const {
+    return points.empty();
+  }
+
+  void writeToFile(const std::string &file_name) const {
+    std::ofstream ofs(file_name);
+    if (!ofs) {
+      std::cerr << "can not open pareto result file: " << file_name << std::endl;
+      return;
+    }
+    ofs << "mem_access_volume,mem_footprint,compute_time,schedule\n";
+    for (const auto &p : points) {
+      ofs << p.access_volume << "," << p.mem_footprint << "," << p.compute_time << ",\""
+          << p.schedule << "\"\n";
+    }
+  }
+
+private:
+  std::vector<ParetoPoint> points;
+};
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_PARETO_H
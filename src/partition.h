@@ -0,0 +1,140 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_PARTITION_H
+#define MMCHAIN_ANALYSIS_SRC_PARTITION_H
+
+#include <functional>
+#include <numeric>
+#include <string>
+#include "tensor-operator.h"
+
+namespace DAT {
+
+// A split of a graph over cores: every core runs the graph on a slice of each partitioned dim,
+// with its own SRAM. The slices are ceil(size / factor) long, the last one may be shorter.
+struct CorePartition {
+  std::map<Dim *, long> factors;
+
+  [[nodiscard]] long coreSize(Dim *d) const {
+    auto it = factors.find(d);
+    return it == factors.end() ? d->getSize() : (d->getSize() + it->second - 1) / it->second;
+  }
+  // The work of the graph over the work of all cores running the largest slice, 1 if the
+  // partition is balanced.
+  [[nodiscard]] double balance() const {
+    double balance = 1;
+    for (const auto &df : factors) {
+      balance *= static_cast<double>(df.first->getSize()) / static_cast<double>(df.second * coreSize(df.first));
+    }
+    return balance;
+  }
+  // Tensors without a partitioned dim are loaded by every core, e.g. weights when the batch or
+  // the sequence is split.
+  [[nodiscard]] bool isReplicated(Tensor *t) const {
+    for (auto d : t->getDims()) {
+      auto it = factors.find(d);
+      if (it != factors.end() && it->second > 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+  [[nodiscard]] std::string toString() const {
+    std::string str;
+    for (const auto &df : factors) {
+      if (df.second > 1) {
+        str += (str.empty() ? "" : ";") + df.first->getName() + "=" + std::to_string(df.second);
+      }
+    }
+    return str.empty() ? "none" : str;
+  }
+};
+
+// The dims which can be split over cores: dims no operator reduces or normalizes, as a split
+// reduction would need partial sums or row statistics exchanged between cores. Ordered by name, so partitions are enumerated in
+// the same order on every graph.
+std::vector<Dim *> partitionDims(const std::set<TensorOperator *> &operators) {
+  std::map<std::string, Dim *> named_dims;
+  std::set<Dim *> reduce_dims;
+  for (auto op : operators) {
+    for (auto d : op->getDims()) {
+      named_dims[d->getName()] = d;
+    }
+    for (auto d : op->getReduceDims()) {
+      reduce_dims.insert(d);
+    }
+    if (auto row_norm = dynamic_cast<RowNormalization *>(op)) {
+      reduce_dims.insert(row_norm->getNormalizeDim());
+    }
+  }
+  std::vector<Dim *> dims;
+  for (const auto &nd : named_dims) {
+    if (!reduce_dims.count(nd.second)) {
+      dims.push_back(nd.second);
+    }
+  }
+  return dims;
+}
+
+// All partitions of dims over exactly core_num cores, no dim split into more slices than its size.
+std::vector<CorePartition> enumeratePartitions(const std::vector<Dim *> &dims, long core_num) {
+  std::vector<CorePartition> partitions;
+  CorePartition partition;
+  std::function<void(size_t, long)> enumerate = [&](size_t i, long cores) {
+    if (i == dims.size()) {
+      if (cores == 1) {
+        partitions.push_back(partition);
+      }
+      return;
+    }
+    for (long f = 1; f <= std::min(cores, dims[i]->getSize()); ++f) {
+      if (cores % f == 0) {
+        partition.factors[dims[i]] = f;
+        enumerate(i + 1, cores / f);
+      }
+    }
+    partition.factors.erase(dims[i]);
+  };
+  enumerate(0, core_num);
+  return partitions;
+}
+
+// Shrink the partitioned dims of operators to the slice of one core within a scope. Fixed block
+// sizes, e.g. of bsc and hsc, are kept where they divide the slice.
+class PartitionScope {
+public:
+  PartitionScope(const std::set<TensorOperator *> &operators, const CorePartition &partition) {
+    for (const auto &df : partition.factors) {
+      Dim *d = df.first;
+      if (df.second == 1) {
+        continue;
+      }
+      long core_size = partition.coreSize(d);
+      sizes[d] = d->getSize();
+      d->setSize(core_size);
+      for (auto op : operators) {
+        if (op->hasDim(d)) {
+          long block_size = d->getBlockSize(op);
+          block_sizes[{op, d}] = block_size;
+          d->setBlockSize(op, std::gcd(block_size, core_size));
+        }
+      }
+    }
+  }
+  ~PartitionScope() {
+    for (const auto &ds : sizes) {
+      ds.first->setSize(ds.second);
+    }
+    for (const auto &bs : block_sizes) {
+      bs.first.second->setBlockSize(bs.first.first, bs.second);
+    }
+  }
+  PartitionScope(const PartitionScope &) = delete;
+  PartitionScope &operator=(const PartitionScope &) = delete;
+
+private:
+  std::map<Dim *, long> sizes;
+  std::map<std::pair<TensorOperator *, Dim *>, long> block_sizes;
+};
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_PARTITION_H
@@ -0,0 +1,244 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_SIMD_KERNEL_H
+#define MMCHAIN_ANALYSIS_SRC_SIMD_KERNEL_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define DAT_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace DAT {
+
+// Element-wise kernels over the candidate axis of a ChainLayout. All arrays hold n values.
+struct SimdKernels {
+  std::string isa;
+  // acc *= b
+  void (*mul)(long *acc, const long *b, long n);
+  // acc = min(acc, b)
+  void (*min)(long *acc, const long *b, long n);
+  // acc = max(acc, b)
+  void (*max)(long *acc, const long *b, long n);
+  // acc *= (pos >= bound ? b : 1), the loops reloading a tensor
+  void (*mulIfNotBefore)(long *acc, const long *pos, const long *bound, const long *b, long n);
+  // acc *= (pos < bound ? b : 1) and mark the expanded ones, the loops kept on chip
+  void (*mulIfBefore)(long *acc, long *expanded, const long *pos, const long *bound, const long *b, long n);
+  // acc += c + a * b
+  void (*mulAdd)(long *acc, const long *a, const long *b, long c, long n);
+};
+
+namespace scalar {
+
+void mul(long *acc, const long *b, long n) {
+  for (long i = 0; i < n; ++i) {
+    acc[i] *= b[i];
+  }
+}
+void min(long *acc, const long *b, long n) {
+  for (long i = 0; i < n; ++i) {
+    acc[i] = std::min(acc[i], b[i]);
+  }
+}
+void max(long *acc, const long *b, long n) {
+  for (long i = 0; i < n; ++i) {
+    acc[i] = std::max(acc[i], b[i]);
+  }
+}
+void mulIfNotBefore(long *acc, const long *pos, const long *bound, const long *b, long n) {
+  for (long i = 0; i < n; ++i) {
+    acc[i] *= pos[i] >= bound[i] ? b[i] : 1;
+  }
+}
+void mulIfBefore(long *acc, long *expanded, const long *pos, const long *bound, const long *b, long n) {
+  for (long i = 0; i < n; ++i) {
+    bool before = pos[i] < bound[i];
+    acc[i] *= before ? b[i] : 1;
+    expanded[i] |= before;
+  }
+}
+void mulAdd(long *acc, const long *a, const long *b, long c, long n) {
+  for (long i = 0; i < n; ++i) {
+    acc[i] += c + a[i] * b[i];
+  }
+}
+
+}
+
+#ifdef DAT_SIMD_X86
+
+namespace avx2 {
+
+// AVX2 has no 64-bit multiply, build it from the 32-bit ones (low 64 bits of the product)
+__attribute__((target("avx2"))) inline __m256i mul64(__m256i a, __m256i b) {
+  __m256i lo = _mm256_mul_epu32(a, b);
+  __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                   _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+__attribute__((target("avx2"))) inline __m256i load(const long *p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+__attribute__((target("avx2"))) inline void store(long *p, __m256i v) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+}
+
+__attribute__((target("avx2"))) void mul(long *acc, const long *b, long n) {
+  long i = 0;
+  for (; i + 4 <= n; i += 4) {
+    store(acc + i, mul64(load(acc + i), load(b + i)));
+  }
+  scalar::mul(acc + i, b + i, n - i);
+}
+__attribute__((target("avx2"))) void min(long *acc, const long *b, long n) {
+  long i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i va = load(acc + i), vb = load(b + i);
+    store(acc + i, _mm256_blendv_epi8(va, vb, _mm256_cmpgt_epi64(va, vb)));
+  }
+  scalar::min(acc + i, b + i, n - i);
+}
+__attribute__((target("avx2"))) void max(long *acc, const long *b, long n) {
+  long i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i va = load(acc + i), vb = load(b + i);
+    store(acc + i, _mm256_blendv_epi8(va, vb, _mm256_cmpgt_epi64(vb, va)));
+  }
+  scalar::max(acc + i, b + i, n - i);
+}
+__attribute__((target("avx2"))) void mulIfNotBefore(long *acc, const long *pos, const long *bound,
+                                                    const long *b, long n) {
+  const __m256i one = _mm256_set1_epi64x(1);
+  long i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i before = _mm256_cmpgt_epi64(load(bound + i), load(pos + i));
+    __m256i factor = _mm256_blendv_epi8(load(b + i), one, before);
+    store(acc + i, mul64(load(acc + i), factor));
+  }
+  scalar::mulIfNotBefore(acc + i, pos + i, bound + i, b + i, n - i);
+}
+__attribute__((target("avx2"))) void mulIfBefore(long *acc, long *expanded, const long *pos,
+                                                 const long *bound, const long *b, long n) {
+  const __m256i one = _mm256_set1_epi64x(1);
+  long i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i before = _mm256_cmpgt_epi64(load(bound + i), load(pos + i));
+    __m256i factor = _mm256_blendv_epi8(one, load(b + i), before);
+    store(acc + i, mul64(load(acc + i), factor));
+    store(expanded + i, _mm256_or_si256(load(expanded + i), _mm256_and_si256(before, one)));
+  }
+  scalar::mulIfBefore(acc + i, expanded + i, pos + i, bound + i, b + i, n - i);
+}
+__attribute__((target("avx2"))) void mulAdd(long *acc, const long *a, const long *b, long c, long n) {
+  const __m256i vc = _mm256_set1_epi64x(c);
+  long i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_add_epi64(load(acc + i), _mm256_add_epi64(vc, mul64(load(a + i), load(b + i))));
+    store(acc + i, v);
+  }
+  scalar::mulAdd(acc + i, a + i, b + i, c, n - i);
+}
+
+}
+
+namespace avx512 {
+
+#define DAT_AVX512_TARGET __attribute__((target("avx512f,avx512dq")))
+
+DAT_AVX512_TARGET inline __m512i load(const long *p) {
+  return _mm512_loadu_si512(p);
+}
+DAT_AVX512_TARGET inline void store(long *p, __m512i v) {
+  _mm512_storeu_si512(p, v);
+}
+
+DAT_AVX512_TARGET void mul(long *acc, const long *b, long n) {
+  long i = 0;
+  for (; i + 8 <= n; i += 8) {
+    store(acc + i, _mm512_mullo_epi64(load(acc + i), load(b + i)));
+  }
+  scalar::mul(acc + i, b + i, n - i);
+}
+// the unmasked min and max leave their pass-through vector undefined, which gcc warns about, so
+// they are masked over all lanes with a zeroed one
+DAT_AVX512_TARGET void min(long *acc, const long *b, long n) {
+  long i = 0;
+  for (; i + 8 <= n; i += 8) {
+    store(acc + i, _mm512_mask_min_epi64(_mm512_setzero_si512(), 0xff, load(acc + i), load(b + i)));
+  }
+  scalar::min(acc + i, b + i, n - i);
+}
+DAT_AVX512_TARGET void max(long *acc, const long *b, long n) {
+  long i = 0;
+  for (; i + 8 <= n; i += 8) {
+    store(acc + i, _mm512_mask_max_epi64(_mm512_setzero_si512(), 0xff, load(acc + i), load(b + i)));
+  }
+  scalar::max(acc + i, b + i, n - i);
+}
+DAT_AVX512_TARGET void mulIfNotBefore(long *acc, const long *pos, const long *bound, const long *b, long n) {
+  long i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __mmask8 not_before = _mm512_cmpge_epi64_mask(load(pos + i), load(bound + i));
+    __m512i va = load(acc + i);
+    store(acc + i, _mm512_mask_mullo_epi64(va, not_before, va, load(b + i)));
+  }
+  scalar::mulIfNotBefore(acc + i, pos + i, bound + i, b + i, n - i);
+}
+DAT_AVX512_TARGET void mulIfBefore(long *acc, long *expanded, const long *pos, const long *bound,
+                                   const long *b, long n) {
+  const __m512i one = _mm512_set1_epi64(1);
+  long i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __mmask8 before = _mm512_cmplt_epi64_mask(load(pos + i), load(bound + i));
+    __m512i va = load(acc + i);
+    store(acc + i, _mm512_mask_mullo_epi64(va, before, va, load(b + i)));
+    __m512i ve = load(expanded + i);
+    store(expanded + i, _mm512_mask_or_epi64(ve, before, ve, one));
+  }
+  scalar::mulIfBefore(acc + i, expanded + i, pos + i, bound + i, b + i, n - i);
+}
+DAT_AVX512_TARGET void mulAdd(long *acc, const long *a, const long *b, long c, long n) {
+  const __m512i vc = _mm512_set1_epi64(c);
+  long i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512i v = _mm512_add_epi64(load(acc + i), _mm512_add_epi64(vc, _mm512_mullo_epi64(load(a + i), load(b + i))));
+    store(acc + i, v);
+  }
+  scalar::mulAdd(acc + i, a + i, b + i, c, n - i);
+}
+
+#undef DAT_AVX512_TARGET
+
+}
+
+#endif
+
+// All kernel sets supported by the running CPU, the widest first.
+std::vector<SimdKernels> supportedSimdKernels() {
+  std::vector<SimdKernels> kernels;
+#ifdef DAT_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+    kernels.push_back({"avx512", avx512::mul, avx512::min, avx512::max, avx512::mulIfNotBefore,
+                       avx512::mulIfBefore, avx512::mulAdd});
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.push_back({"avx2", avx2::mul, avx2::min, avx2::max, avx2::mulIfNotBefore,
+                       avx2::mulIfBefore, avx2::mulAdd});
+  }
+#endif
+  kernels.push_back({"scalar", scalar::mul, scalar::min, scalar::max, scalar::mulIfNotBefore,
+                     scalar::mulIfBefore, scalar::mulAdd});
+  return kernels;
+}
+
+// The kernel set used by default, decided once at runtime.
+const SimdKernels &simdKernels() {
+  static const SimdKernels kernels = supportedSimdKernels().front();
+  return kernels;
+}
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_SIMD_KERNEL_H
@@ -0,0 +1,291 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_SIMULATOR_H
+#define MMCHAIN_ANALYSIS_SRC_SIMULATOR_H
+
+#include <algorithm>
+#include <utility>
+#include "operator-chain.h"
+
+namespace DAT {
+
+// DRAM traffic and SRAM occupancy of a chain, counted by replaying the loop nests over tiles.
+struct SimulationResult {
+  long access_volume{0};
+  long mem_footprint{0};
+  // peak bytes of each tensor in SRAM during each operator
+  std::map<std::pair<Tensor *, TensorOperator *>, long> tensor_footprints;
+  // peak bytes of the row statistics of each row normalization
+  std::map<TensorOperator *, long> state_footprints;
+};
+
+// The most tiles alive at once, a tile being alive from its first to its last use. Tiles never
+// used have a first step of -1.
+long peakAlive(const std::vector<long> &first_step, const std::vector<long> &last_step) {
+  std::vector<std::pair<long, int> > events;
+  for (size_t tile = 0; tile < first_step.size(); ++tile) {
+    if (first_step[tile] >= 0) {
+      events.emplace_back(first_step[tile], 1);
+      events.emplace_back(last_step[tile] + 1, -1);
+    }
+  }
+  std::sort(events.begin(), events.end());
+  long alive = 0;
+  long peak = 0;
+  for (const auto &e : events) {
+    alive += e.second;
+    peak = std::max(peak, alive);
+  }
+  return peak;
+}
+
+// Replay the loop nest of op over its blocks, dims_order from the innermost loop, with an
+// explicit SRAM: an unfused tensor holds the tile of the current iteration and loads a tile
+// whenever it changes, an output stores its tile as partial sums when it changes. A fused tensor
+// stays in SRAM from the first to the last iteration using a tile, and only IO or external fused
+// tensors move each tile once, unless another operator of the chain loads them. A row
+// normalization reads an unfused input once per pass, and keeps the statistics of a row from the
+// first to the last iteration on it.
+void simulateOperator(TensorOperator *op, const std::vector<Dim *> &dims_order, SimulationResult &result) {
+  std::vector<Dim *> loops;
+  for (auto d : dims_order) {
+    if (op->hasDim(d)) {
+      loops.push_back(d);
+    }
+  }
+  std::vector<long> blocks;
+  for (auto d : loops) {
+    blocks.push_back(d->getBlocks(op));
+  }
+
+  struct SimTensor {
+    Tensor *tensor{};
+    bool output{};
+    bool fused{};
+    bool io{};
+    long passes{1};
+    size_t min_level{};
+    // (loop level, stride) of the tensor dims in the linear tile index
+    std::vector<std::pair<size_t, long> > strides;
+    long tile_elements{};
+    long current{-1};
+    std::vector<char> visited;
+    std::vector<long> first_step;
+    std::vector<long> last_step;
+  };
+  std::vector<SimTensor> sim_tensors;
+  auto addTensor = [&](Tensor *t, bool output) {
+    SimTensor s;
+    s.tensor = t;
+    s.output = output;
+    s.fused = t->isFused();
+    s.io = (t->isIO() || t->isExternal()) && !t->isLoadedElsewhere(op);
+    if (auto element_wise = dynamic_cast<ElementWise *>(op)) {
+      s.passes = output ? 1 : element_wise->getPasses();
+    }
+    s.min_level = loops.size();
+    s.tile_elements = t->getBlockSize(op);
+    long tiles = 1;
+    for (auto d : t->getDims()) {
+      size_t level = std::find(loops.begin(), loops.end(), d) - loops.begin();
+      assert(level < loops.size() && "dims order should cover all dims of the operator");
+      s.min_level = std::min(s.min_level, level);
+      s.strides.emplace_back(level, tiles);
+      tiles *= blocks[level];
+    }
+    s.visited.assign(tiles, 0);
+    if (s.fused) {
+      s.first_step.assign(tiles, -1);
+      s.last_step.assign(tiles, 0);
+    }
+    sim_tensors.push_back(std::move(s));
+  };
+  for (auto t : op->getInputTensors()) {
+    addTensor(t, false);
+  }
+  for (auto t : op->getOutputTensors()) {
+    addTensor(t, true);
+  }
+
+  std::vector<long> index(loops.size(), 0);
+  long traffic = 0;
+  auto enter = [&](SimTensor &s, long step) {
+    long tile = 0;
+    for (const auto &ls : s.strides) {
+      tile += index[ls.first] * ls.second;
+    }
+    s.current = tile;
+    long element_bytes = s.tensor->getElementBytes();
+    bool first = !s.visited[tile];
+    s.visited[tile] = 1;
+    if (s.fused) {
+      if (first) {
+        s.first_step[tile] = step;
+        if (s.io) {
+          traffic += s.tile_elements * element_bytes;
+        }
+        if (s.output && op->is_with_bias()) {
+          traffic += s.tile_elements * element_bytes;
+        }
+      }
+    } else if (!s.output) {
+      traffic += s.passes * s.tile_elements * element_bytes;
+    } else if (!first) {
+      traffic += s.tile_elements * s.tensor->getFootprintBytes();
+    } else if (op->is_with_bias()) {
+      traffic += s.tile_elements * element_bytes;
+    }
+  };
+  auto leave = [&](SimTensor &s, long step) {
+    if (s.fused) {
+      s.last_step[s.current] = step;
+    } else if (s.output) {
+      traffic += s.tile_elements * s.tensor->getFootprintBytes();
+    }
+  };
+
+  // the rows are the tiles of the loops other than the normalize loop
+  auto row_norm = dynamic_cast<RowNormalization *>(op);
+  std::vector<std::pair<size_t, long> > row_strides;
+  long rows = 1;
+  if (row_norm) {
+    for (size_t level = 0; level < loops.size(); ++level) {
+      if (loops[level] != row_norm->getNormalizeDim()) {
+        row_strides.emplace_back(level, rows);
+        rows *= blocks[level];
+      }
+    }
+  }
+  std::vector<long> row_first(rows, -1);
+  std::vector<long> row_last(rows, -1);
+  auto visitRow = [&](long step) {
+    long row = 0;
+    for (const auto &ls : row_strides) {
+      row += index[ls.first] * ls.second;
+    }
+    if (row_first[row] < 0) {
+      row_first[row] = step;
+    }
+    row_last[row] = step;
+  };
+
+  long step = 0;
+  for (auto &s : sim_tensors) {
+    enter(s, step);
+  }
+  visitRow(step);
+  while (true) {
+    size_t level = 0;
+    while (level < loops.size() && ++index[level] == blocks[level]) {
+      index[level] = 0;
+      ++level;
+    }
+    if (level == loops.size()) {
+      break;
+    }
+    ++step;
+    // the tiles of tensors with a dim in a changed loop change
+    for (auto &s : sim_tensors) {
+      if (s.min_level <= level) {
+        leave(s, step - 1);
+        enter(s, step);
+      }
+    }
+    visitRow(step);
+  }
+  for (auto &s : sim_tensors) {
+    leave(s, step);
+  }
+
+  for (auto &s : sim_tensors) {
+    long tile_bytes = s.tile_elements * s.tensor->getFootprintBytes();
+    long peak_tiles = 1;
+    if (s.fused) {
+      peak_tiles = peakAlive(s.first_step, s.last_step);
+    } else {
+      // the last store of each tile is the output, not a partial sum
+      if (s.output) {
+        long tiles = std::count(s.visited.begin(), s.visited.end(), 1);
+        traffic -= tiles * s.tile_elements * (s.tensor->getFootprintBytes() - s.tensor->getElementBytes());
+      }
+      // a tile changing every iteration is prefetched into the other buffers
+      if (!loops.empty() && s.tensor->hasDim(loops.front())) {
+        peak_tiles = options().buffer_num;
+      }
+    }
+    result.tensor_footprints[{s.tensor, op}] = peak_tiles * tile_bytes;
+  }
+  if (row_norm) {
+    long row_bytes = 2 * op->getOutputTensors().front()->getFootprintBytes();
+    for (size_t level = 0; level < loops.size(); ++level) {
+      if (loops[level] != row_norm->getNormalizeDim()) {
+        row_bytes *= loops[level]->getBlockSize(op);
+      }
+    }
+    result.state_footprints[op] = peakAlive(row_first, row_last) * row_bytes;
+  }
+  result.access_volume += traffic;
+}
+
+// Simulate every operator of op_chain in its current order and block sizes. The SRAM of an
+// operator group holds the peak of each of its tensors, see OperatorChain::analyzeMemFootprint.
+SimulationResult simulateChain(OperatorChain *op_chain) {
+  SimulationResult result;
+  for (auto op : op_chain->getOperators()) {
+    simulateOperator(op, op->getLinkedNode()->getDimsOrder(), result);
+  }
+  auto peak = [&result](Tensor *t) {
+    long footprint = 0;
+    for (const auto &tf : result.tensor_footprints) {
+      if (tf.first.first == t) {
+        footprint = std::max(footprint, tf.second);
+      }
+    }
+    return footprint;
+  };
+
+  std::vector<std::set<TensorOperator *> > groups = op_chain->getOperatorGroups();
+  if (options().pipeline) {
+    groups = {op_chain->getOperators()};
+  }
+  for (const auto &og : groups) {
+    std::set<Tensor *> group_tensors;
+    for (auto op : og) {
+      for (auto t : op->getTensors()) {
+        group_tensors.insert(t);
+      }
+      for (auto t : op->getEnvTensors()) {
+        group_tensors.insert(t);
+      }
+    }
+    long footprint = 0;
+    for (auto op : og) {
+      if (result.state_footprints.count(op)) {
+        footprint += result.state_footprints[op];
+      }
+    }
+    for (auto t : group_tensors) {
+      if (t->isFused()) {
+        long tensor_footprint = peak(t);
+        for (auto pt : t->getParTensors()) {
+          tensor_footprint = std::max(tensor_footprint, peak(pt));
+        }
+        if (options().pipeline && op_chain->isStageTensor(t)) {
+          tensor_footprint *= 2;
+        }
+        footprint += tensor_footprint;
+      } else {
+        for (const auto &ro : t->getRelatedOperator()) {
+          if (og.count(ro.first)) {
+            footprint += result.tensor_footprints[{t, ro.first}];
+            break;
+          }
+        }
+      }
+    }
+    result.mem_footprint = std::max(result.mem_footprint, footprint);
+  }
+  return result;
+}
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_SIMULATOR_H
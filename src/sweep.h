@@ -0,0 +1,305 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_SWEEP_H
+#define MMCHAIN_ANALYSIS_SRC_SWEEP_H
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "options.h"
+#include "order-cache.h"
+#include "thread-pool.h"
+#include "workload.h"
+
+namespace DAT {
+
+struct SweepAxis {
+  std::string name;
+  std::vector<std::string> values;
+};
+
+std::string trim(const std::string &str) {
+  size_t begin = str.find_first_not_of(" \t\r");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  size_t end = str.find_last_not_of(" \t\r");
+  return str.substr(begin, end - begin + 1);
+}
+
+// Values of one axis: a list "v1, v2, v3", an arithmetic range "start:stop:step" or a
+// geometric range "start:stop:*factor". Ranges include stop.
+std::vector<std::string> parseSweepValues(const std::string &str) {
+  std::vector<std::string> values;
+  if (str.find(':') != std::string::npos) {
+    std::vector<std::string> fields;
+    std::stringstream ss(str);
+    std::string field;
+    while (std::getline(ss, field, ':')) {
+      fields.push_back(trim(field));
+    }
+    if (fields.size() != 3) {
+      throw std::invalid_argument("a range should be start:stop:step, but got " + str);
+    }
+    if (fields[2].empty()) {
+      throw std::invalid_argument("a range should have a step, but got " + str);
+    }
+    long start = std::stol(fields[0]);
+    long stop = std::stol(fields[1]);
+    bool geometric = fields[2].front() == '*';
+    long step = std::stol(geometric ? fields[2].substr(1) : fields[2]);
+    if (step <= (geometric ? 1 : 0) || (geometric && start <= 0)) {
+      throw std::invalid_argument("a range should grow, but got " + str);
+    }
+    for (long v = start; v <= stop; v = geometric ? v * step : v + step) {
+      values.push_back(std::to_string(v));
+      // the next value would overflow, so it is beyond stop anyway
+      if (v > (geometric ? LONG_MAX / step : LONG_MAX - step)) {
+        break;
+      }
+    }
+  } else {
+    std::stringstream ss(str);
+    std::string value;
+    while (std::getline(ss, value, ',')) {
+      if (!trim(value).empty()) {
+        values.push_back(trim(value));
+      }
+    }
+  }
+  return values;
+}
+
+// A sweep spec has one "name = values" line per axis, '#' starts a comment.
+std::vector<SweepAxis> parseSweepSpec(const std::string &file_name) {
+  std::ifstream ifs(file_name);
+  if (!ifs) {
+    throw std::invalid_argument("can not open sweep spec file: " + file_name);
+  }
+  std::vector<SweepAxis> axes;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    line = trim(line.substr(0, line.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+    size_t eq = line.find('=');
+    if (eq == std::string::npos) {
+      throw std::invalid_argument("a sweep axis should be name = values, but got " + line);
+    }
+    axes.push_back({trim(line.substr(0, eq)), parseSweepValues(line.substr(eq + 1))});
+  }
+  return axes;
+}
+
+// The cartesian product of all axes, the last axis changing fastest.
+std::vector<std::vector<std::string> > expandSweepPoints(const std::vector<SweepAxis> &axes) {
+  std::vector<std::vector<std::string> > points{{}};
+  for (const auto &axis : axes) {
+    std::vector<std::vector<std::string> > new_points;
+    for (const auto &point : points) {
+      for (const auto &value : axis.values) {
+        new_points.push_back(point);
+        new_points.back().push_back(value);
+      }
+    }
+    points = new_points;
+  }
+  return points;
+}
+
+// Groups of points run one after another on one graph. With monotone, points differing only in
+// mem_size form a group, from the largest mem_size to the smallest; otherwise every point is a
+// group of its own.
+std::vector<std::vector<size_t> > groupSweepPoints(const std::vector<SweepAxis> &axes,
+                                                   const std::vector<std::vector<std::string> > &points,
+                                                   bool monotone) {
+  size_t mem_axis = axes.size();
+  for (size_t a = 0; a < axes.size(); ++a) {
+    if (axes[a].name == "mem_size") {
+      mem_axis = a;
+    }
+  }
+  std::vector<std::vector<size_t> > groups;
+  if (!monotone || mem_axis == axes.size()) {
+    for (size_t i = 0; i < points.size(); ++i) {
+      groups.push_back({i});
+    }
+    return groups;
+  }
+  std::map<std::vector<std::string>, size_t> group_indices;
+  for (size_t i = 0; i < points.size(); ++i) {
+    std::vector<std::string> others = points[i];
+    others.erase(others.begin() + mem_axis);
+    if (!group_indices.count(others)) {
+      group_indices[others] = groups.size();
+      groups.emplace_back();
+    }
+    groups[group_indices[others]].push_back(i);
+  }
+  for (auto &group : groups) {
+    std::stable_sort(group.begin(), group.end(), [&](size_t x, size_t y) {
+      return std::stol(points[x][mem_axis]) > std::stol(points[y][mem_axis]);
+    });
+  }
+  return groups;
+}
+
+// Whether each point is on the access volume vs. mem_size Pareto curve of its group, i.e. it is
+// feasible and every smaller mem_size of the group has a larger access volume.
+std::vector<bool> paretoSweepPoints(const std::vector<SweepAxis> &axes,
+                                    const std::vector<std::vector<std::string> > &points,
+                                    const std::vector<ExploreResult> &results) {
+  std::vector<bool> pareto(points.size(), false);
+  for (auto group : groupSweepPoints(axes, points, true)) {
+    long min_access_volume = LONG_MAX;
+    for (auto it = group.rbegin(); it != group.rend(); ++it) {
+      const ExploreResult &r = results[*it];
+      if (r.feasible && r.access_volume < min_access_volume) {
+        pareto[*it] = true;
+        min_access_volume = r.access_volume;
+      }
+    }
+  }
+  return pareto;
+}
+
+// Run every point of the sweep spec in options().sweep on top of the current options. Groups of
+// points run concurrently on a thread pool, each in its own context, and share one order cache.
+// The mem_size points of a group reuse one graph: a schedule feasible at some mem_size is
+// feasible at every larger one, so the fuse patterns infeasible at a larger mem_size are skipped
+// at the smaller ones, whose incumbent is seeded by the best fuse pattern of the larger one. The
+// bounds need the exact order search, see FuseBounds. Points of several layers are explored by
+// exploreLayers, without bounds. The options of every point are set before any point runs, so a
+// bad axis stops the sweep at once, and a point failing while it runs, e.g. on a graph file, is
+// reported after the others ran. Returns 1 if any failed.
+int runSweep() {
+  const Options base = options();
+  std::vector<SweepAxis> axes;
+  std::vector<std::vector<std::string> > points;
+  try {
+    axes = parseSweepSpec(base.sweep);
+    points = expandSweepPoints(axes);
+    for (const auto &point : points) {
+      Options point_options = base;
+      for (size_t a = 0; a < axes.size(); ++a) {
+        point_options.set(axes[a].name, point[a]);
+      }
+      point_options.check();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "bad sweep spec " << base.sweep << ": " << e.what() << std::endl;
+    return 1;
+  }
+  std::vector<std::vector<size_t> > groups = groupSweepPoints(axes, points, base.monotone_mem_sweep);
+
+  auto order_cache = std::make_shared<OrderCache>();
+  std::vector<ExploreResult> results(points.size());
+  std::vector<double> seconds(points.size());
+  std::vector<long> skipped_pattern_nums(points.size());
+  // the error of each failed point, empty for the others
+  std::vector<std::string> errors(points.size());
+  {
+    std::mutex print_mutex;
+    // run the points of a group in order, counting those done
+    auto runGroup = [&](const std::vector<size_t> &group, size_t &done_num) {
+      Context context(base);
+      context.order_cache = order_cache;
+      for (size_t a = 0; a < axes.size(); ++a) {
+        context.options.set(axes[a].name, points[group.front()][a]);
+      }
+      ContextScope scope(context);
+      withWorkloadGraph([&](const std::set<TensorOperator *> &operators,
+                            const std::set<Tensor *> &tensors) {
+        FuseBounds bounds;
+        for (size_t i : group) {
+          for (size_t a = 0; a < axes.size(); ++a) {
+            context.options.set(axes[a].name, points[i][a]);
+          }
+          context.options.log_directory = base.log_directory + "/point" + std::to_string(i);
+          if (!base.pareto_result.empty()) {
+            context.options.pareto_result = context.options.log_directory + "/"
+                + fs::path(base.pareto_result).filename().string();
+          }
+          if (context.options.save_log_file || !base.pareto_result.empty()) {
+            fs::create_directories(context.options.log_directory);
+          }
+          long skipped_pattern_num = bounds.skipped_pattern_num;
+          auto start = std::chrono::steady_clock::now();
+          results[i] = context.options.layer_num > 1
+                       ? exploreLayers(context.options.mem_size, nullptr)
+                       : explorePartitioned(operators, tensors, context.options.mem_size, nullptr,
+                                            group.size() > 1 && isExhaustiveDimOrderOpt()
+                                            ? &bounds : nullptr);
+          seconds[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+          skipped_pattern_nums[i] = bounds.skipped_pattern_num - skipped_pattern_num;
+          ++done_num;
+          if (base.print_to_screen) {
+            std::lock_guard<std::mutex> lock(print_mutex);
+            std::cout << "point " << i << " done in " << seconds[i] << "s" << std::endl;
+          }
+        }
+        return 0;
+      });
+    };
+    ThreadPool pool(base.threads > 0 ? base.threads : std::thread::hardware_concurrency());
+    for (const auto &group : groups) {
+      pool.submit([&, group]() {
+        size_t done_num = 0;
+        try {
+          runGroup(group, done_num);
+        } catch (const std::exception &e) {
+          // the point running and the later points of its group fail
+          for (size_t g = done_num; g < group.size(); ++g) {
+            results[group[g]] = ExploreResult();
+            errors[group[g]] = e.what();
+          }
+        }
+      });
+    }
+    pool.wait();
+  }
+
+  std::ofstream ofs(base.sweep_result);
+  if (!ofs) {
+    std::cerr << "can not open sweep result file: " << base.sweep_result << std::endl;
+    return 1;
+  }
+  std::vector<bool> pareto = paretoSweepPoints(axes, points, results);
+  for (const auto &axis : axes) {
+    ofs << axis.name << ",";
+  }
+  ofs << "feasible,operator_chain_num,mem_access_volume,compute_time,mem_footprint,latency,pareto,"
+         "skipped_fuse_patterns,seconds,level_access_volumes,partition,access_volume_per_token,boundary_saving\n";
+  long skipped_pattern_num = 0;
+  for (size_t i = 0; i < points.size(); ++i) {
+    for (const auto &value : points[i]) {
+      ofs << value << ",";
+    }
+    const ExploreResult &r = results[i];
+    ofs << r.feasible << "," << r.operator_chain_num << "," << r.access_volume << ","
+        << r.compute_time << "," << r.mem_footprint << "," << r.latency << "," << pareto[i] << ","
+        << skipped_pattern_nums[i] << "," << seconds[i] << ",";
+    for (size_t l = 0; l < r.level_access_volumes.size(); ++l) {
+      ofs << (l ? ";" : "") << r.level_access_volumes[l];
+    }
+    ofs << "," << r.partition << "," << r.access_volume_per_token << "," << r.boundary_saving << "\n";
+    skipped_pattern_num += skipped_pattern_nums[i];
+  }
+  std::cout << "sweep points: " << points.size() << ", order cache hits: " << order_cache->getHitNum()
+            << ", misses: " << order_cache->getMissNum() << ", skipped fuse patterns: "
+            << skipped_pattern_num << std::endl;
+  long failed_num = 0;
+  for (size_t i = 0; i < points.size(); ++i) {
+    if (!errors[i].empty()) {
+      std::cerr << "point " << i << " failed: " << errors[i] << std::endl;
+      ++failed_num;
+    }
+  }
+  return failed_num > 0 ? 1 : 0;
+}
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_SWEEP_H
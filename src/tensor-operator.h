@@ -15,6 +15,7 @@ class OperatorNode;
 
 class TensorOperator {
 public:
+  virtual ~TensorOperator() = default;
   Tensor *getInputTensor(long i) {
     assert(i < inputs.size());
     return inputs[i];
@@ -152,6 +153,15 @@ public:
     for (auto t : outputs) {
       t->clearMemFootprint();
     }
+    state_footprint = 0;
+    state_footprint_str.clear();
+  }
+  // SRAM kept by the operator besides its tensors, e.g. the statistics of a row normalization.
+  [[nodiscard]] long getStateFootprint() const {
+    return state_footprint;
+  }
+  [[nodiscard]] std::string getStateFootprintStr() const {
+    return state_footprint_str;
   }
   virtual std::string toString() = 0;
   virtual long getOpsNum() = 0;
@@ -191,9 +201,23 @@ public:
   void is_with_bias(bool w) {
     with_bias = w;
   }
+  std::map<Dim *, long> getBlockSizes() {
+    std::map<Dim *, long> block_sizes;
+    for (auto d : dims) {
+      block_sizes[d] = d->getBlockSize(this);
+    }
+    return block_sizes;
+  }
   virtual long compute_time() {
+    return compute_time(getBlockSizes());
+  };
+  // compute_time() with the given block sizes instead of the ones recorded in dims.
+  virtual long compute_time(const std::map<Dim *, long> &block_sizes) {
     return INT64_MIN;
   };
+  [[nodiscard]] bool hasName() const {
+    return name_set;
+  }
   std::string getName() {
     assert(name_set);
     return name;
@@ -241,6 +265,8 @@ protected:
   std::set<Dim *> actual_dims;
   long access_times{};
   long access_volume{};
+  long state_footprint{};
+  std::string state_footprint_str;
 
 };
 
@@ -282,36 +308,47 @@ public:
     }
     return ops;
   }
-  long compute_time() override {
+  using TensorOperator::compute_time;
+  long compute_time(const std::map<Dim *, long> &block_sizes) override {
+    auto tensorBlockSize = [&block_sizes](Tensor *t) {
+      long ret = 1;
+      for (auto d : t->getDims()) {
+        ret *= block_sizes.at(d);
+      }
+      return ret;
+    };
     double t = 0;
-    Dim *time_d;
+    Dim *time_d = nullptr;
     for (auto d : dims) {
       if (!outputs[0]->hasDim(d))
         time_d = d;
     }
-    long reduce_d_block_size = time_d->getBlockSize(this);
-    t = std::ceil(outputs[0]->getBlockSize(this) / static_cast<double>(Options::compute_power))
-        * getOpsNum() / outputs[0]->getBlockSize(this)
+    long reduce_d_block_size = block_sizes.at(time_d);
+    long tensor_block_size = tensorBlockSize(outputs[0]);
+    t = std::ceil(tensor_block_size / static_cast<double>(options().compute_power))
+        * getOpsNum() / tensor_block_size
         * (reduce_d_block_size + 2.0) / reduce_d_block_size;
 
     for (auto d : dims) {
       if (!inputs[0]->hasDim(d))
         time_d = d;
     }
-    reduce_d_block_size = time_d->getBlockSize(this);
+    reduce_d_block_size = block_sizes.at(time_d);
+    tensor_block_size = tensorBlockSize(inputs[0]);
     t = std::min(t,
-                 std::ceil(inputs[0]->getBlockSize(this) / static_cast<double>(Options::compute_power))
-                     * getOpsNum() / inputs[0]->getBlockSize(this)
+                 std::ceil(tensor_block_size / static_cast<double>(options().compute_power))
+                     * getOpsNum() / tensor_block_size
                      * (reduce_d_block_size + 2.0) / reduce_d_block_size);
 
     for (auto d : dims) {
       if (!inputs[1]->hasDim(d))
         time_d = d;
     }
-    reduce_d_block_size = time_d->getBlockSize(this);
+    reduce_d_block_size = block_sizes.at(time_d);
+    tensor_block_size = tensorBlockSize(inputs[1]);
     t = std::min(t,
-                 std::ceil(inputs[1]->getBlockSize(this) / static_cast<double>(Options::compute_power))
-                     * getOpsNum() / inputs[1]->getBlockSize(this)
+                 std::ceil(tensor_block_size / static_cast<double>(options().compute_power))
+                     * getOpsNum() / tensor_block_size
                      * (reduce_d_block_size + 2.0) / reduce_d_block_size);
 
     return std::ceil(t);
@@ -358,12 +395,12 @@ protected:
     long op_access_volume = 0;
     for (auto input : inputs) {
       if (input->isFused()) {
-        if (input->isIO() || input->isExternal()) {
+        if ((input->isIO() || input->isExternal()) && !input->isLoadedElsewhere(this)) {
           long access_times = input->getBlocks(this);
           input->updateAccessTimesStr(this, "fused io(" + std::to_string(access_times) + ")");
           input->updateAccessTimes(this, access_times);
           op_access_times += access_times;
-          op_access_volume += access_times * input->getBlockSize(this);
+          op_access_volume += access_times * input->getBlockSize(this) * input->getElementBytes();
         } else {
           input->updateAccessTimesStr(this, "fused");
           input->updateAccessTimes(this, 0);
@@ -391,27 +428,31 @@ protected:
         input->updateAccessTimesStr(this, access_times_str);
         input->updateAccessTimes(this, access_times);
         op_access_times += access_times;
-        op_access_volume += access_times * input->getBlockSize(this);
+        op_access_volume += access_times * input->getBlockSize(this) * input->getElementBytes();
       }
     }
     for (auto output : outputs) {
       if (output->isFused()) {
         if (is_with_bias())
-          op_access_volume += output->getSize();
+          op_access_volume += output->getSize() * output->getElementBytes();
         if (output->isIO() || output->isExternal()) {
           long access_times = output->getBlocks(this);
           output->updateAccessTimesStr(this, "fused io(" + std::to_string(access_times) + ")");
           output->updateAccessTimes(this, access_times);
           op_access_times += access_times;
-          op_access_volume += access_times * output->getBlockSize(this);
+          op_access_volume += access_times * output->getBlockSize(this) * output->getElementBytes();
         } else {
           output->updateAccessTimesStr(this, "fused");
           output->updateAccessTimes(this, 0);
         }
         output->isReused(true);
       } else {
-        if (!is_with_bias())
-          op_access_volume -= output->getSize();
+        // partial sums are stored and reloaded as accumulators, but the first load is skipped
+        // without bias, and the first load of bias and the last store are outputs
+        long output_bytes = output->getElementBytes();
+        long accumulator_bytes = output->getFootprintBytes();
+        op_access_volume -= (2 * (accumulator_bytes - output_bytes) + (is_with_bias() ? 0 : output_bytes))
+            * output->getSize();
         output->isReused(false);
         std::string access_times_str;
         long access_times = 1;
@@ -436,7 +477,7 @@ protected:
         output->updateAccessTimesStr(this, access_times_str);
         output->updateAccessTimes(this, access_times);
         op_access_times += access_times;
-        op_access_volume += access_times * output->getBlockSize(this);
+        op_access_volume += access_times * output->getBlockSize(this) * accumulator_bytes;
       }
     }
     access_times = op_access_times;
@@ -450,6 +491,16 @@ protected:
     auto b = outputs;
     tensors.insert(tensors.end(), a.begin(), a.end());
     tensors.insert(tensors.end(), b.begin(), b.end());
+    // an unfused tensor with the innermost dim changes its block every iteration, and is
+    // multi-buffered to overlap the load of the next block with compute. Fused tensors stay.
+    // dims_order lists the loops from the innermost one.
+    Dim *innermost_dim = nullptr;
+    for (auto d : dims_order) {
+      if (this->hasDim(d)) {
+        innermost_dim = d;
+        break;
+      }
+    }
     for (auto t : tensors) {
       if (t->isFused()) {
         long tensor_footprint = t->getBlockSize(this);
@@ -471,15 +522,17 @@ protected:
           }
         }
         t->updateMemFootprintStr(this, tensor_footprint_str);
-        t->updateMemFootprint(this, tensor_footprint);
+        t->updateMemFootprint(this, tensor_footprint * t->getFootprintBytes());
       } else {
+        long buffers = innermost_dim && t->hasDim(innermost_dim) ? options().buffer_num : 1;
+        t->updateMemBuffers(this, buffers);
         if (t->isReused()) {
           t->updateMemFootprintStr(this, t->getBlockSizeStr(this));
-          t->updateMemFootprint(this, t->getBlockSize(this));
+          t->updateMemFootprint(this, t->getBlockSize(this) * t->getFootprintBytes() * buffers);
         } else {
-          if (Options::store_whole_block) {
+          if (options().store_whole_block) {
             t->updateMemFootprintStr(this, t->getBlockSizeStr(this));
-            t->updateMemFootprint(this, t->getBlockSize(this));
+            t->updateMemFootprint(this, t->getBlockSize(this) * t->getFootprintBytes() * buffers);
           } else {
             assert(0);
           }
@@ -489,6 +542,206 @@ protected:
   }
 };
 
+// An operator computing each output element from the elements at the same index of its inputs,
+// such as a residual add, an activation or a scaling. All tensors have the dims of the operator,
+// so every block is loaded and stored once, and a fused producer or consumer joins its group.
+class ElementWise : public TensorOperator {
+public:
+  ElementWise(std::string n, std::string function, const std::vector<Tensor *> &input_tensors, Tensor *output,
+              long ops_per_element = 1)
+      : function(std::move(function)), ops_per_element(ops_per_element) {
+    setName(std::move(n));
+    inputs.resize(input_tensors.size());
+    outputs.resize(1);
+    for (long i = 0; i < input_tensors.size(); ++i) {
+      setInputTensor(i, input_tensors[i]);
+    }
+    setOutputTensor(0, output);
+    for (auto t : input_tensors) {
+      for (auto d : output->getDims()) {
+        assert(t->hasDim(d) && t->getDims().size() == output->getDims().size()
+                   && "inputs should have the dims of the output");
+      }
+    }
+  }
+  // Passes over an unfused input.
+  virtual long getPasses() {
+    return 1;
+  }
+  [[nodiscard]] long getOpsPerElement() const {
+    return ops_per_element;
+  }
+  long getOpsNum() override {
+    return outputs[0]->getSize() * ops_per_element;
+  }
+  using TensorOperator::compute_time;
+  // The elements of a block run on the compute_power lanes.
+  long compute_time(const std::map<Dim *, long> &block_sizes) override {
+    long block_size = 1;
+    for (auto d : outputs[0]->getDims()) {
+      block_size *= block_sizes.at(d);
+    }
+    return static_cast<long>(std::ceil(block_size / static_cast<double>(options().compute_power)))
+        * (outputs[0]->getSize() / block_size) * ops_per_element;
+  }
+  bool isReduceDimExpended(Tensor *t) override {
+    return true;
+  }
+  std::set<Dim *> getBatchDims() override {
+    return dims;
+  }
+  std::set<Dim *> getReduceDims() override {
+    return {};
+  }
+  std::set<Dim *> getShapeDims(int i) override {
+    return {};
+  }
+  std::string toString() override {
+    std::string str = outputs[0]->toString(this) + " = " + function + "(";
+    for (long i = 0; i < inputs.size(); ++i) {
+      str += (i ? ", " : "") + inputs[i]->toString(this);
+    }
+    return str + ")";
+  }
+
+protected:
+  void analyzeMemAccess(const std::vector<Dim *> &dims_order) override {
+    long op_access_times = 0;
+    long op_access_volume = 0;
+    auto tensorAccess = [&](Tensor *t, long passes) {
+      if (t->isFused()) {
+        if ((t->isIO() || t->isExternal()) && !t->isLoadedElsewhere(this)) {
+          long times = t->getBlocks(this);
+          t->updateAccessTimesStr(this, "fused io(" + std::to_string(times) + ")");
+          t->updateAccessTimes(this, times);
+          op_access_times += times;
+          op_access_volume += times * t->getBlockSize(this) * t->getElementBytes();
+        } else {
+          t->updateAccessTimesStr(this, "fused");
+          t->updateAccessTimes(this, 0);
+        }
+        t->isReused(true);
+        return;
+      }
+      // every dim of the operator is a tensor dim, so each block moves once per pass
+      t->isReused(false);
+      std::string times_str = passes == 1 ? "1" : "1 * " + std::to_string(passes);
+      long times = passes;
+      for (auto d : dims_order) {
+        if (this->hasDim(d)) {
+          times *= d->getBlocks(this);
+          times_str.append(" * " + d->getName() + "(" + std::to_string(d->getBlocks(this)) + ")");
+        }
+      }
+      t->updateAccessTimesStr(this, times_str);
+      t->updateAccessTimes(this, times);
+      op_access_times += times;
+      op_access_volume += times * t->getBlockSize(this) * t->getElementBytes();
+    };
+    for (auto t : inputs) {
+      tensorAccess(t, getPasses());
+    }
+    tensorAccess(outputs[0], 1);
+    access_times = op_access_times;
+    access_volume = op_access_volume;
+  }
+
+  void analyzeMemFootprint(const std::vector<Dim *> &dims_order) override {
+    // every unfused tensor has the innermost dim, see MatrixMul::analyzeMemFootprint
+    bool streamed = std::any_of(dims_order.begin(), dims_order.end(), [this](Dim *d) { return hasDim(d); });
+    for (auto t : getTensors()) {
+      long buffers = !t->isFused() && streamed ? options().buffer_num : 1;
+      t->updateMemBuffers(this, buffers);
+      t->updateMemFootprintStr(this, t->getBlockSizeStr(this));
+      t->updateMemFootprint(this, t->getBlockSize(this) * t->getFootprintBytes() * buffers);
+    }
+  }
+
+  std::string function;
+  long ops_per_element;
+};
+
+// An operator normalizing each row of its input along one dim, keeping the statistics of the rows
+// in SRAM: max and sum for softmax, mean and variance for layer norm. Every output element
+// depends on its whole row, so an unfused input is read twice, once for the statistics and once
+// for the output, unless the output is fused: its consumer then normalizes online from the
+// running statistics, as the rescaled accumulators of flash attention, in a single pass.
+class RowNormalization : public ElementWise {
+public:
+  RowNormalization(std::string n, std::string function, Tensor *input, Tensor *output, Dim *normalize_dim,
+                   long ops_per_element)
+      : ElementWise(std::move(n), std::move(function), {input}, output, ops_per_element),
+        normalize_dim(normalize_dim) {
+    assert(input->hasDim(normalize_dim) && output->hasDim(normalize_dim));
+  }
+  Dim *getNormalizeDim() {
+    return normalize_dim;
+  }
+  long getPasses() override {
+    return outputs[0]->isFused() ? 1 : 2;
+  }
+  std::set<Dim *> getBatchDims() override {
+    std::set<Dim *> batch_dims = dims;
+    batch_dims.erase(normalize_dim);
+    return batch_dims;
+  }
+  std::set<Dim *> getShapeDims(int i) override {
+    if (i == 0) {
+      return {normalize_dim};
+    }
+    return {};
+  }
+  std::string toString() override {
+    return outputs[0]->toString(this) + " = " + function + "_" + normalize_dim->getName() + "("
+        + inputs[0]->toString(this) + ")";
+  }
+
+protected:
+  void analyzeMemFootprint(const std::vector<Dim *> &dims_order) override {
+    ElementWise::analyzeMemFootprint(dims_order);
+    // the statistics of a row live while its blocks along the normalize dim are visited, so the
+    // rows inside the normalize loop are all kept
+    state_footprint = 2 * outputs[0]->getFootprintBytes();
+    state_footprint_str.clear();
+    bool inside = true;
+    for (auto d : dims_order) {
+      if (!this->hasDim(d)) {
+        continue;
+      }
+      if (d == normalize_dim) {
+        inside = false;
+        continue;
+      }
+      state_footprint *= d->getBlockSize(this);
+      state_footprint_str += (state_footprint_str.empty() ? "" : " * ") + d->getName() + "_blocksize("
+          + std::to_string(d->getBlockSize(this)) + ")";
+      if (inside) {
+        state_footprint *= d->getBlocks(this);
+        state_footprint_str.append(" * " + d->getName() + "(" + std::to_string(d->getBlocks(this)) + ")");
+      }
+    }
+    if (state_footprint_str.empty()) {
+      state_footprint_str = "1";
+    }
+  }
+
+  Dim *normalize_dim;
+};
+
+// Softmax along normalize_dim: max, subtract, exp, sum and divide per element.
+class Softmax : public RowNormalization {
+public:
+  Softmax(std::string n, Tensor *input, Tensor *output, Dim *normalize_dim)
+      : RowNormalization(std::move(n), "softmax", input, output, normalize_dim, 5) {}
+};
+
+// Layer norm along normalize_dim: mean, variance, normalize, scale and shift per element.
+class LayerNorm : public RowNormalization {
+public:
+  LayerNorm(std::string n, Tensor *input, Tensor *output, Dim *normalize_dim)
+      : RowNormalization(std::move(n), "layernorm", input, output, normalize_dim, 7) {}
+};
+
 // FIXME: BatchTensor and BatchMatrixMul are not maintained
 class BatchMatrixMul : public MatrixMul {
 public:
@@ -568,15 +821,15 @@ public:
           }
         }
         t->updateMemFootprintStr(this, tensor_footprint_str);
-        t->updateMemFootprint(this, tensor_footprint);
+        t->updateMemFootprint(this, tensor_footprint * t->getFootprintBytes());
       } else {
         if (t->isReused()) {
           t->updateMemFootprintStr(this, t->getBlockSizeStr(this));
-          t->updateMemFootprint(this, t->getBlockSize(this));
+          t->updateMemFootprint(this, t->getBlockSize(this) * t->getFootprintBytes());
         } else {
-          if (Options::store_whole_block) {
+          if (options().store_whole_block) {
             t->updateMemFootprintStr(this, t->getBlockSizeStr(this));
-            t->updateMemFootprint(this, t->getBlockSize(this));
+            t->updateMemFootprint(this, t->getBlockSize(this) * t->getFootprintBytes());
           } else {
             assert(0);
           }
@@ -9,8 +9,16 @@
 
 namespace DAT {
 
+// What a tensor holds, deciding its element width, see Tensor::getElementBytes.
+enum class TensorRole {
+  Activation,
+  Weight,
+  Score
+};
+
 class Tensor {
 public:
+  virtual ~Tensor() = default;
   std::string getName() {
     return name;
   }
@@ -96,6 +104,14 @@ public:
   void updateMemFootprint(TensorOperator *to, long fp) {
     mem_footprint[to] = fp;
   }
+  // Copies of the block in SRAM, more than one when the block is streamed and multi-buffered.
+  void updateMemBuffers(TensorOperator *to, long buffers) {
+    mem_buffers[to] = buffers;
+  }
+  long getMemBuffers(TensorOperator *to) {
+    auto it = mem_buffers.find(to);
+    return it == mem_buffers.end() ? 1 : it->second;
+  }
   std::map<TensorOperator *, std::string> getAccessTimesStr() {
     return access_times_str;
   }
@@ -114,7 +130,7 @@ public:
   std::map<TensorOperator *, long> getAccessVolume(TensorOperator *to) {
     std::map<TensorOperator *, long> access_volume;
     for (auto at : access_times) {
-      access_volume[at.first] = at.second * getBlockSize(to);
+      access_volume[at.first] = at.second * getBlockSize(to) * getElementBytes();
     }
     return access_volume;
   }
@@ -136,6 +152,45 @@ public:
   [[nodiscard]] bool isExternal() const {
     return is_external;
   }
+  // A fused input which another operator of the chain of to loads, so to reads it from SRAM.
+  void isLoadedElsewhere(TensorOperator *to, bool loaded) {
+    if (loaded) {
+      loaded_elsewhere.insert(to);
+    } else {
+      loaded_elsewhere.erase(to);
+    }
+  }
+  bool isLoadedElsewhere(TensorOperator *to) {
+    return loaded_elsewhere.count(to);
+  }
+  void setRole(TensorRole r) {
+    role = r;
+  }
+  [[nodiscard]] TensorRole getRole() const {
+    return role;
+  }
+  // Bytes of an element in DRAM, by the role of the tensor.
+  [[nodiscard]] long getElementBytes() const {
+    switch (role) {
+      case TensorRole::Weight:
+        return options().weight_bytes;
+      case TensorRole::Score:
+        return options().score_bytes;
+      default:
+        return options().activation_bytes;
+    }
+  }
+  // Bytes of an element in SRAM. The output of an operator stays there as partial sums, which
+  // are at least options().accumulator_bytes wide.
+  long getFootprintBytes() {
+    long bytes = getElementBytes();
+    for (const auto &ro : related_operators) {
+      if (ro.second == "output") {
+        bytes = std::max(bytes, options().accumulator_bytes);
+      }
+    }
+    return bytes;
+  }
   bool equal(Tensor *t) {
     if (t->dims.size() == this->dims.size()) {
       for (long i = 0; i < this->dims.size(); i++) {
@@ -208,8 +263,10 @@ public:
     access_times.clear();
     mem_footprint_str.clear();
     mem_footprint.clear();
+    mem_buffers.clear();
     is_reused = false;
     is_external = false;
+    loaded_elsewhere.clear();
     par_tensors.clear();
     expand_dims.clear();
   }
@@ -221,6 +278,7 @@ public:
   void clearMemFootprint() {
     mem_footprint_str.clear();
     mem_footprint.clear();
+    mem_buffers.clear();
     expand_dims.clear();
   }
   virtual std::string toString(TensorOperator *to) {
@@ -254,9 +312,12 @@ protected:
   std::map<TensorOperator *, long> access_times;
   std::map<TensorOperator *, std::string> mem_footprint_str;
   std::map<TensorOperator *, long> mem_footprint;
+  std::map<TensorOperator *, long> mem_buffers;
   bool is_reused{false};
   bool is_external{false};
+  std::set<TensorOperator *> loaded_elsewhere;
   std::set<Tensor *> par_tensors;
+  TensorRole role{TensorRole::Activation};
 };
 
 class Tensor2D : public Tensor {
@@ -378,6 +439,19 @@ public:
   }
 };
 
+// A tensor whose dims are only known at run time, e.g. the heads of the query side of grouped
+// query attention, which have a group dim only when K and V have fewer heads than Q.
+class TensorND : public Tensor {
+public:
+  TensorND(std::string n, const std::vector<Dim *> &ds) {
+    dims.resize(ds.size());
+    for (size_t i = 0; i < ds.size(); ++i) {
+      setDim(static_cast<long>(i), ds[i]);
+    }
+    setName(std::move(n));
+  }
+};
+
 }
 
 #endif //MMCHAIN_ANALYSIS_SRC_TENSOR_H
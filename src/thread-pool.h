@@ -0,0 +1,102 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_THREAD_POOL_H
+#define MMCHAIN_ANALYSIS_SRC_THREAD_POOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace DAT {
+
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t thread_num) {
+    if (thread_num == 0) {
+      thread_num = 1;
+    }
+    for (size_t i = 0; i < thread_num; ++i) {
+      workers.emplace_back([this]() { work(); });
+    }
+  }
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    task_cv.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push(std::move(task));
+      ++unfinished_num;
+    }
+    task_cv.notify_one();
+  }
+  // Block until every submitted task has finished, then rethrow the first exception a task threw
+  // since the last wait, if any.
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this]() { return unfinished_num == 0; });
+    if (error) {
+      std::exception_ptr e = error;
+      error = nullptr;
+      std::rethrow_exception(e);
+    }
+  }
+  [[nodiscard]] size_t size() const {
+    return workers.size();
+  }
+
+private:
+  void work() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        task_cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+        if (tasks.empty()) {
+          return;
+        }
+        task = std::move(tasks.front());
+        tasks.pop();
+      }
+      std::exception_ptr e;
+      try {
+        task();
+      } catch (...) {
+        e = std::current_exception();
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (e && !error) {
+          error = e;
+        }
+        --unfinished_num;
+      }
+      done_cv.notify_all();
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()> > tasks;
+  std::mutex mutex;
+  std::condition_variable task_cv;
+  std::condition_variable done_cv;
+  size_t unfinished_num{0};
+  std::exception_ptr error;
+  bool stopping{false};
+};
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_THREAD_POOL_H
@@ -72,9 +72,9 @@ std::vector<std::string> changeVarToConst(const std::vector<std::string> &mul_st
   for (const std::string &str : mul_strs) {
     if (str.compare(0, dim_name.length(), dim_name) == 0) {
       if (str.length() >= 10 && str.substr(str.length() - 10) == "_blocksize") {
-        ret_strs.push_back(std::to_string(t->getDim(dim_name)->getBlockSize(to)));
+        ret_strs.push_back(std::to_string(to->getDim(dim_name)->getBlockSize(to)));
       } else {
-        ret_strs.push_back(std::to_string(t->getDim(dim_name)->getBlocks(to)));
+        ret_strs.push_back(std::to_string(to->getDim(dim_name)->getBlocks(to)));
       }
     } else {
       ret_strs.push_back(str);
@@ -83,20 +83,21 @@ std::vector<std::string> changeVarToConst(const std::vector<std::string> &mul_st
   return ret_strs;
 }
 
-GRBQuadExpr convertToLocalGRBQuad(const std::vector<std::string> &mul_strs,
-                                  TensorOperator *to,
-                                  Tensor *t,
-                                  std::map<std::string, GRBVar> grb_vars_map) {
+// A product term coef * var_0 * var_1 * ..., each var is named "<op>_<dim>_bn" or "<op>_<dim>_bs".
+struct MonomialTerm {
+  double coef{1};
+  std::vector<std::string> var_names;
+};
 
-  GRBQuadExpr local_obj;
-  GRBVar mul_vars[2];
-  long mul_vars_index = 0;
-  double const_base = 1;
+MonomialTerm convertToMonomial(const std::vector<std::string> &mul_strs,
+                               TensorOperator *to,
+                               Tensor *t) {
+  MonomialTerm term;
   std::set<std::string> withBlocksize;
   std::set<std::string> withoutBlocksize;
   for (const std::string &str : mul_strs) {
     if (isInteger(str)) {
-      const_base *= std::stoi(str);
+      term.coef *= std::stoi(str);
     } else if (str.length() >= 10 && str.substr(str.length() - 10) == "_blocksize") {
       withBlocksize.insert(removeBlocksizeSuffix(str));
     } else {
@@ -105,36 +106,306 @@ GRBQuadExpr convertToLocalGRBQuad(const std::vector<std::string> &mul_strs,
   }
   for (const auto &d : withoutBlocksize) {
     if (withBlocksize.count(d)) {
-      const_base = const_base * t->getDim(d)->getSize();
+      term.coef = term.coef * t->getDim(d)->getSize();
       withBlocksize.erase(d);
     } else {
-      assert(mul_vars_index < 2 && "should not exceed quad");
-      mul_vars[mul_vars_index] = grb_vars_map.at(to->getName() + '_' + d + "_bn");
-      mul_vars_index++;
+      term.var_names.push_back(to->getName() + '_' + d + "_bn");
     }
   }
   for (const auto &dbs : withBlocksize) {
-    assert(mul_vars_index < 2 && "should not exceed quad");
-    mul_vars[mul_vars_index] = grb_vars_map.at(to->getName() + '_' + dbs + "_bs");
-    mul_vars_index++;
+    term.var_names.push_back(to->getName() + '_' + dbs + "_bs");
   }
-  if (mul_vars_index == 2) {
-    local_obj = mul_vars[0] * mul_vars[1];
-  } else if (mul_vars_index == 1) {
-    local_obj = mul_vars[0];
+  return term;
+}
+
+GRBQuadExpr convertToGRBQuad(const MonomialTerm &term,
+                             const std::map<std::string, GRBVar> &grb_vars_map) {
+  assert(term.var_names.size() <= 2 && "should not exceed quad");
+  GRBQuadExpr local_obj;
+  if (term.var_names.size() == 2) {
+    local_obj = grb_vars_map.at(term.var_names[0]) * grb_vars_map.at(term.var_names[1]);
+  } else if (term.var_names.size() == 1) {
+    local_obj = grb_vars_map.at(term.var_names[0]);
   } else {
     local_obj = 1;
   }
-  local_obj = const_base * local_obj;
+  local_obj = term.coef * local_obj;
 
   return local_obj;
 }
 
+GRBQuadExpr convertToLocalGRBQuad(const std::vector<std::string> &mul_strs,
+                                  TensorOperator *to,
+                                  Tensor *t,
+                                  std::map<std::string, GRBVar> grb_vars_map) {
+  return convertToGRBQuad(convertToMonomial(mul_strs, to, t), grb_vars_map);
+}
+
+double evaluateMonomials(const std::vector<MonomialTerm> &terms,
+                         const std::map<std::string, long> &values) {
+  double ret = 0;
+  for (const auto &term : terms) {
+    double local = term.coef;
+    for (const auto &name : term.var_names) {
+      local *= static_cast<double>(values.at(name));
+    }
+    ret += local;
+  }
+  return ret;
+}
+
+// Sum up the coefficients of terms with the same variables.
+std::vector<MonomialTerm> mergeMonomials(const std::vector<MonomialTerm> &terms) {
+  std::map<std::vector<std::string>, double> merged;
+  for (const auto &term : terms) {
+    std::vector<std::string> names = term.var_names;
+    std::sort(names.begin(), names.end());
+    merged[names] += term.coef;
+  }
+  std::vector<MonomialTerm> ret;
+  ret.reserve(merged.size());
+  for (const auto &m : merged) {
+    ret.push_back({m.second, m.first});
+  }
+  return ret;
+}
+
+// The block size problem of an operator chain, independent of how it is handed to the solver.
+struct BlockSizeModel {
+  // minimize the sum of objective, or the latency if latency is set
+  std::vector<MonomialTerm> objective;
+  // roofline latency: the sum over operator groups of max(compute, traffic / dram_bandwidth)
+  bool latency{false};
+  std::vector<std::vector<MonomialTerm> > group_traffic;
+  std::vector<std::vector<MonomialTerm> > group_compute;
+  // sum of each group <= mem_constraint
+  std::vector<std::vector<MonomialTerm> > footprint_constraints;
+  // sum of each operator >= options().compute_power
+  std::vector<std::vector<MonomialTerm> > compute_util_constraints;
+  // var >= value, 16 or the whole dim if it is shorter, e.g. the single token of a decode step
+  std::map<std::string, long> min_block_sizes;
+  std::map<std::string, long> fixed_vars;
+  std::vector<std::pair<std::string, std::string> > equal_vars;
+};
+
+// TensorOperator::compute_time of an output stationary schedule without the rounding to whole
+// passes of the compute units: ops / compute_power * (1 + 2 / reduce block size). As
+// bn * bs == size, the reduce block size term is linear in the number of reduce blocks.
+std::vector<MonomialTerm> computeTimeMonomials(TensorOperator *op) {
+  double ops = static_cast<double>(op->getOpsNum()) / options().compute_power;
+  std::vector<MonomialTerm> terms = {{ops, {}}};
+  for (auto d : op->getDims()) {
+    if (!op->getOutputTensors().front()->hasDim(d)) {
+      terms.push_back({2 * ops / d->getSize(), {op->getName() + "_" + d->getName() + "_bn"}});
+    }
+  }
+  return terms;
+}
+
+// The roofline latency of the model on values, see BlockSizeModel::latency.
+double evaluateLatency(const BlockSizeModel &bs_model, const std::map<std::string, long> &values) {
+  double latency = 0;
+  for (size_t g = 0; g < bs_model.group_traffic.size(); ++g) {
+    latency += std::max(evaluateMonomials(bs_model.group_compute[g], values),
+                        evaluateMonomials(bs_model.group_traffic[g], values) / options().dram_bandwidth);
+  }
+  return latency;
+}
+
+BlockSizeModel buildBlockSizeModel(OperatorChain *op_chain) {
+  BlockSizeModel bs_model;
+
+  // objective
+  std::map<TensorOperator *, std::vector<MonomialTerm> > op_traffic;
+  for (auto op : op_chain->getOperators()) {
+    std::vector<Tensor *> tensors = op->getInputTensors();
+    std::vector<Tensor *> outputs = op->getOutputTensors();
+    tensors.insert(tensors.end(), outputs.begin(), outputs.end());
+    for (auto t : tensors) {
+      if (!t->isFused()) {
+        long const_base;
+        std::string access_volume_str = removeParenthesesInfo(t->getAccessVolumeStr(op)[op]);
+        std::vector<std::string> mul_strs = convertStringToVector(access_volume_str);
+        if (mul_strs.front() == "1") {
+          const_base = 1;
+        } else if (mul_strs.front() == "2") {
+          const_base = 2;
+        } else {
+          assert(false && "access volume should begin with \"1 *\" or \"2 *\"");
+        }
+        mul_strs.erase(mul_strs.begin());
+        // an input reloaded over all query heads would be cubic with the group dim, fixed anyway
+        if (op->getDim("gsc")) {
+          mul_strs = changeVarToConst(mul_strs, "gsc", op, t);
+        }
+        MonomialTerm term = convertToMonomial(mul_strs, op, t);
+        // outputs are stored and reloaded as partial sums
+        term.coef *= const_base * (const_base == 2 ? t->getFootprintBytes() : t->getElementBytes());
+        bs_model.objective.push_back(term);
+        op_traffic[op].push_back(term);
+      } else if ((t->isIO() || t->isExternal()) && !t->isLoadedElsewhere(op)) {
+        bs_model.objective.push_back({static_cast<double>(t->getSize() * t->getElementBytes()), {}});
+        op_traffic[op].push_back(bs_model.objective.back());
+      }
+    }
+  }
+  // pipelined operator groups share the SRAM and the DRAM bandwidth at the same time, see
+  // OperatorChain::analyzeMemFootprint and OperatorChain::latency
+  std::vector<std::set<TensorOperator *> > operator_groups = op_chain->getOperatorGroups();
+  if (options().pipeline) {
+    operator_groups = {op_chain->getOperators()};
+  }
+  if (options().objective == "latency") {
+    bs_model.latency = true;
+    for (const auto &og : operator_groups) {
+      std::vector<MonomialTerm> traffic;
+      std::vector<MonomialTerm> compute;
+      for (auto op : og) {
+        traffic.insert(traffic.end(), op_traffic[op].begin(), op_traffic[op].end());
+        std::vector<MonomialTerm> op_compute = computeTimeMonomials(op);
+        compute.insert(compute.end(), op_compute.begin(), op_compute.end());
+      }
+      bs_model.group_traffic.push_back(traffic);
+      bs_model.group_compute.push_back(compute);
+    }
+  }
+
+  // batch, head and head group block sizes are decided outside
+  for (auto op : op_chain->getOperators()) {
+    for (const std::string dim_name : {"bsc", "hsc", "gsc"}) {
+      if (op->getDim(dim_name)) {
+        bs_model.fixed_vars[op->getName() + "_" + dim_name + "_bn"] =
+            op_chain->getDim(dim_name)->getBlocks(op);
+        bs_model.fixed_vars[op->getName() + "_" + dim_name + "_bs"] =
+            op_chain->getDim(dim_name)->getBlockSize(op);
+      }
+    }
+  }
+
+  if (options().enable_compute_utilization_constraint) {
+    for (auto op : op_chain->getOperators()) {
+      // only matrix multiplications run on the PE array
+      if (!dynamic_cast<MatrixMul *>(op)) {
+        continue;
+      }
+      for (auto d : op->getDims()) {
+        std::string name = d->getName();
+        if (name == "bsc" || name == "hsc" || name == "gsc") {
+        } else {
+          bs_model.min_block_sizes[op->getName() + "_" + name + "_bs"] = std::min(16L, d->getSize());
+        }
+      }
+      std::vector<MonomialTerm> compute_util_constraint;
+      for (auto t : op->getTensors()) {
+        MonomialTerm tensor_compute_util_constraint;
+        for (auto d : t->getDims()) {
+          std::string name = d->getName();
+          if (name == "bsc" || name == "hsc" || name == "gsc") {
+            tensor_compute_util_constraint.coef *= d->getBlockSize(op);
+          } else {
+            tensor_compute_util_constraint.var_names.push_back(op->getName() + "_" + name + "_bs");
+          }
+        }
+        assert(tensor_compute_util_constraint.var_names.size() == 2);
+        compute_util_constraint.push_back(tensor_compute_util_constraint);
+      }
+      assert(op->getTensors().size() == 3);
+      bs_model.compute_util_constraints.push_back(compute_util_constraint);
+    }
+  }
+
+  for (const auto &og : operator_groups) {
+    std::vector<MonomialTerm> local_constraint;
+    std::vector<Tensor *> op_tensors;
+    for (auto op : og) {
+      std::vector<Tensor *> inputs = op->getInputTensors();
+      std::vector<Tensor *> outputs = op->getOutputTensors();
+      std::set<Tensor *> envs = op->getEnvTensors();
+      op_tensors.insert(op_tensors.end(), inputs.begin(), inputs.end());
+      op_tensors.insert(op_tensors.end(), outputs.begin(), outputs.end());
+      op_tensors.insert(op_tensors.end(), envs.begin(), envs.end());
+    }
+    std::set<Tensor *> tensor_sets(op_tensors.begin(), op_tensors.end());
+    for (auto t : tensor_sets) {
+      std::vector<std::string> mul_strs;
+      for (const auto &mfs : t->getMemFootprintStr()) {
+        std::vector<std::string>
+            new_mul_strs = convertStringToVector(removeParenthesesInfo(mfs.second));
+        if (new_mul_strs.size() > mul_strs.size()) {
+          mul_strs = new_mul_strs;
+        }
+      }
+      for (auto op_m : t->getRelatedOperator()) {
+        if (og.count(op_m.first)) {
+          if (op_m.first->getDim("bsc")) {
+            mul_strs = changeVarToConst(mul_strs, "bsc", op_m.first, t);
+          }
+          if (op_m.first->getDim("hsc")) {
+            mul_strs = changeVarToConst(mul_strs, "hsc", op_m.first, t);
+          }
+          if (op_m.first->getDim("gsc")) {
+            mul_strs = changeVarToConst(mul_strs, "gsc", op_m.first, t);
+          }
+          MonomialTerm term = convertToMonomial(mul_strs, op_m.first, t);
+          term.coef *= t->getFootprintBytes() * t->getMemBuffers(op_m.first);
+          if (options().pipeline && t->isFused() && op_chain->isStageTensor(t)) {
+            term.coef *= 2;
+          }
+          local_constraint.push_back(term);
+          break;
+        }
+      }
+    }
+    // the statistics of row normalizations, with the same dims as their input
+    for (auto op : og) {
+      if (op->getStateFootprintStr().empty()) {
+        continue;
+      }
+      Tensor *t = op->getInputTensors().front();
+      std::vector<std::string> mul_strs = convertStringToVector(removeParenthesesInfo(op->getStateFootprintStr()));
+      for (const std::string dim_name : {"bsc", "hsc", "gsc"}) {
+        if (op->getDim(dim_name)) {
+          mul_strs = changeVarToConst(mul_strs, dim_name, op, t);
+        }
+      }
+      MonomialTerm term = convertToMonomial(mul_strs, op, t);
+      term.coef *= 2 * op->getOutputTensors().front()->getFootprintBytes();
+      local_constraint.push_back(term);
+    }
+    bs_model.footprint_constraints.push_back(local_constraint);
+  }
+
+  for (auto t : op_chain->getInternalTensors()) {
+    std::set<Dim *> expand_dims = t->getExpandDims();
+    for (auto d : t->getDims()) {
+      if (!expand_dims.count(d)) {
+        std::vector<TensorOperator *> asInput;
+        std::vector<TensorOperator *> asOutput;
+        for (const auto &to : t->getRelatedOperator()) {
+          if (to.second == "input") {
+            asInput.push_back(to.first);
+          } else if (to.second == "output") {
+            asOutput.push_back(to.first);
+          }
+        }
+        // every consumer of a shared tensor takes the blocks of the producer
+        for (auto op1 : asInput)
+          for (auto op2 : asOutput) {
+            bs_model.equal_vars.emplace_back(op1->getName() + '_' + d->getName() + "_bs",
+                                             op2->getName() + '_' + d->getName() + "_bs");
+          }
+      }
+    }
+  }
+
+  return bs_model;
+}
+
 // The return obj may not equal to the mem access. They may differ by a constant.
-double mipBlockSize(OperatorChain *op_chain,
-                         long mem_constraint,
-                         bool print_info = false,
-                         const std::string &lp_file = "") {
+double mipBlockSizeNonConvex(OperatorChain *op_chain,
+                             long mem_constraint,
+                             bool print_info = false,
+                             const std::string &lp_file = "") {
   double ret_obj = -1;
   GRBVar *grbvars = nullptr;
   const std::set<Dim *> op_chain_dims = op_chain->getDims();
@@ -142,6 +413,7 @@ double mipBlockSize(OperatorChain *op_chain,
   auto dim_num = op_chain_dims.size();
   auto op_num = op_chain_ops.size();
   grbvars = new GRBVar[op_num * dim_num * 2];
+  const BlockSizeModel bs_model = buildBlockSizeModel(op_chain);
   try {
 
     // Create an environment
@@ -167,151 +439,70 @@ double mipBlockSize(OperatorChain *op_chain,
       grb_vars_map[grbvar_bn_name] = grbvars[var_i];
       grbvars[var_i + 1] = model.addVar(1.0, d->getSize(), 0.0, GRB_INTEGER, grbvar_bs_name);
       grb_vars_map[grbvar_bs_name] = grbvars[var_i + 1];
-      model.addQConstr(grbvars[var_i] * grbvars[var_i + 1] == d->getSize(), grbvar_name + "_c");
+      // Only divisors of the dim size are legal, so select exactly one of them with binaries
+      // instead of the nonconvex bn * bs == size constraint.
+      GRBLinExpr select_expr = 0;
+      GRBLinExpr bn_expr = 0;
+      GRBLinExpr bs_expr = 0;
+      for (auto f : d->getFactors()) {
+        GRBVar select = model.addVar(0.0, 1.0, 0.0, GRB_BINARY, grbvar_name + "_f" + std::to_string(f));
+        select_expr += select;
+        bn_expr += static_cast<double>(d->getSize() / f) * select;
+        bs_expr += static_cast<double>(f) * select;
+      }
+      model.addConstr(select_expr == 1, grbvar_name + "_c");
+      model.addConstr(grbvars[var_i] == bn_expr, grbvar_bn_name + "_c");
+      model.addConstr(grbvars[var_i + 1] == bs_expr, grbvar_bs_name + "_c");
       var_i += 2;
     }
 
     // Set objective
     GRBQuadExpr obj = 0;
-    for (auto op : op_chain->getOperators()) {
-      std::vector<Tensor *> tensors = op->getInputTensors();
-      std::vector<Tensor *> outputs = op->getOutputTensors();
-      tensors.insert(tensors.end(), outputs.begin(), outputs.end());
-      for (auto t : tensors) {
-        if (!t->isFused()) {
-          long const_base;
-          std::string access_volume_str = removeParenthesesInfo(t->getAccessVolumeStr(op)[op]);
-          std::vector<std::string> mul_strs = convertStringToVector(access_volume_str);
-          if (mul_strs.front() == "1") {
-            const_base = 1;
-          } else if (mul_strs.front() == "2") {
-            const_base = 2;
-          } else {
-            assert(false && "access volume should begin with \"1 *\" or \"2 *\"");
-          }
-          mul_strs.erase(mul_strs.begin());
-          GRBQuadExpr local_obj = const_base * convertToLocalGRBQuad(mul_strs, op, t, grb_vars_map);
-          obj = obj + local_obj;
-        } else if (t->isIO() || t->isExternal()) {
-          obj = obj + t->getSize();
+    if (bs_model.latency) {
+      for (size_t g = 0; g < bs_model.group_traffic.size(); ++g) {
+        GRBVar latency = model.addVar(0.0, GRB_INFINITY, 0.0, GRB_CONTINUOUS, "latency" + std::to_string(g));
+        GRBQuadExpr traffic = 0;
+        for (const auto &term : bs_model.group_traffic[g]) {
+          traffic = traffic + convertToGRBQuad(term, grb_vars_map);
         }
+        GRBQuadExpr compute = 0;
+        for (const auto &term : bs_model.group_compute[g]) {
+          compute = compute + convertToGRBQuad(term, grb_vars_map);
+        }
+        model.addQConstr(traffic <= options().dram_bandwidth * latency);
+        model.addQConstr(compute <= latency);
+        obj = obj + latency;
+      }
+    } else {
+      for (const auto &term : bs_model.objective) {
+        obj = obj + convertToGRBQuad(term, grb_vars_map);
       }
     }
     model.setObjective(obj, GRB_MINIMIZE);
 
     // Add constraint
-    auto addGRBConstConstraint = [&](TensorOperator *op, const std::string &dim_name) {
-      std::string grbvar_bn_name = op->getName() + "_" + dim_name + "_bn";
-      std::string grbvar_bs_name = op->getName() + "_" + dim_name + "_bs";
-
-      model.addConstr(grb_vars_map.at(grbvar_bn_name) == op_chain->getDim(dim_name)->getBlocks(op),
-                      grbvar_bn_name);
-      model.addConstr(grb_vars_map.at(grbvar_bs_name) == op_chain->getDim(dim_name)->getBlockSize(op),
-                      grbvar_bs_name);
-    };
-    for (auto op : op_chain_ops) {
-      if (op->getDim("bsc")) {
-        addGRBConstConstraint(op, "bsc");
-      }
-      if (op->getDim("hsc")) {
-        addGRBConstConstraint(op, "hsc");
-      }
+    for (const auto &fv : bs_model.fixed_vars) {
+      model.addConstr(grb_vars_map.at(fv.first) == fv.second, fv.first);
     }
-    for (auto op : op_chain->getOperators()) {
-      if (Options::enable_compute_utilization_constraint) {
-        for (auto d : op->getDims()) {
-          std::string name = d->getName();
-          if (name == "bsc" || name == "hsc") {
-          } else {
-            std::string bs_name = op->getName() + "_" + name + "_bs";
-            model.addConstr(grb_vars_map.at(bs_name) >= 16);
-          }
-        }
-        GRBQuadExpr compute_util_constraint = 0;
-        for (auto t : op->getTensors()) {
-          GRBQuadExpr tensor_compute_util_constraint = 1;
-          std::vector<std::string> mul_names;
-          double mul_const = 1;
-          for (auto d : t->getDims()) {
-            std::string name = d->getName();
-            if (name == "bsc" || name == "hsc") {
-              mul_const *= d->getBlockSize(op);
-            } else {
-              std::string bs_name = op->getName() + "_" + name + "_bs";
-              mul_names.push_back(bs_name);
-            }
-          }
-          if (mul_names.size() == 2) {
-            tensor_compute_util_constraint =
-                mul_const * grb_vars_map.at(mul_names[0]) * grb_vars_map.at(mul_names[1]);
-          } else {
-            assert(0);
-          }
-          compute_util_constraint = compute_util_constraint + tensor_compute_util_constraint;
-        }
-        assert(op->getTensors().size() == 3);
-        model.addQConstr(compute_util_constraint >= Options::compute_power);
+    for (const auto &mbs : bs_model.min_block_sizes) {
+      model.addConstr(grb_vars_map.at(mbs.first) >= mbs.second);
+    }
+    for (const auto &cuc : bs_model.compute_util_constraints) {
+      GRBQuadExpr compute_util_constraint = 0;
+      for (const auto &term : cuc) {
+        compute_util_constraint = compute_util_constraint + convertToGRBQuad(term, grb_vars_map);
       }
+      model.addQConstr(compute_util_constraint >= options().compute_power);
     }
-    for (const auto& og : op_chain->getOperatorGroups()) {
+    for (const auto &fc : bs_model.footprint_constraints) {
       GRBQuadExpr local_constraint = 0;
-      std::vector<Tensor *> op_tensors;
-      for (auto op : og) {
-        std::vector<Tensor *> inputs = op->getInputTensors();
-        std::vector<Tensor *> outputs = op->getOutputTensors();
-        std::set<Tensor *> envs = op->getEnvTensors();
-        op_tensors.insert(op_tensors.end(), inputs.begin(), inputs.end());
-        op_tensors.insert(op_tensors.end(), outputs.begin(), outputs.end());
-        op_tensors.insert(op_tensors.end(), envs.begin(), envs.end());
-      }
-      std::set<Tensor *> tensor_sets(op_tensors.begin(), op_tensors.end());
-      for (auto t : tensor_sets) {
-        std::vector<std::string> mul_strs;
-        bool added = false;
-        for (const auto &mfs : t->getMemFootprintStr()) {
-          std::vector<std::string>
-              new_mul_strs = convertStringToVector(removeParenthesesInfo(mfs.second));
-          if (new_mul_strs.size() > mul_strs.size()) {
-            mul_strs = new_mul_strs;
-          }
-        }
-        for (auto op_m : t->getRelatedOperator()) {
-          if (og.count(op_m.first)) {
-            if (op_m.first->getDim("bsc")) {
-              mul_strs = changeVarToConst(mul_strs, "bsc", op_m.first, t);
-            }
-            if (op_m.first->getDim("hsc")) {
-              mul_strs = changeVarToConst(mul_strs, "hsc", op_m.first, t);
-            }
-            if (!added) {
-              local_constraint = local_constraint + convertToLocalGRBQuad(mul_strs, op_m.first, t, grb_vars_map);
-              added = true;
-            }
-          }
-        }
+      for (const auto &term : fc) {
+        local_constraint = local_constraint + convertToGRBQuad(term, grb_vars_map);
       }
       model.addQConstr(local_constraint <= mem_constraint, "_c");
     }
-    for (auto t : op_chain->getInternalTensors()) {
-      std::set<Dim *> expand_dims = t->getExpandDims();
-      for (auto d : t->getDims()) {
-        if (!expand_dims.count(d)) {
-          std::vector<TensorOperator *> asInput;
-          std::vector<TensorOperator *> asOutput;
-          for(const auto& to : t->getRelatedOperator()) {
-            if (to.second == "input") {
-              asInput.push_back(to.first);
-            } else if (to.second == "output") {
-              asOutput.push_back(to.first);
-            }
-          }
-          assert(asInput.size() == 1);
-          for (auto op1 : asInput)
-            for (auto op2 : asOutput) {
-              model.addConstr(grb_vars_map.at(op1->getName() + '_' + d->getName() + "_bs") == grb_vars_map.at(op2->getName() + '_' + d->getName() + "_bs"));
-            }
-        }
-      }
+    for (const auto &ev : bs_model.equal_vars) {
+      model.addConstr(grb_vars_map.at(ev.first) == grb_vars_map.at(ev.second));
     }
 
     if (!lp_file.empty()) {
@@ -366,6 +557,207 @@ double mipBlockSize(OperatorChain *op_chain,
 
 }
 
+// Log-domain formulation: every block size is a product of the prime factors of its dim size,
+// so it is modeled by integer prime exponents and its logarithm is linear in them. Every
+// monomial then becomes exp(linear), which is convex, and is handed to the solver as a
+// piecewise-linear overestimate of exp. The return obj is evaluated exactly on the solution.
+double mipBlockSizeLog(OperatorChain *op_chain,
+                       long mem_constraint,
+                       bool print_info = false,
+                       const std::string &lp_file = "") {
+  const std::set<TensorOperator *> op_chain_ops = op_chain->getOperators();
+  const BlockSizeModel bs_model = buildBlockSizeModel(op_chain);
+  try {
+
+    // Create an environment
+    GRBEnv env = GRBEnv(true);
+    env.set("LogFile", "");
+    if (!print_info)
+      env.set("OutputFlag", "0");
+    env.start();
+
+    // Create an empty model
+    GRBModel model = GRBModel(env);
+    model.set(GRB_IntParam_FuncPieces, -1);
+    model.set(GRB_DoubleParam_FuncPieceError, 1e-3);
+    model.set(GRB_DoubleParam_FuncPieceRatio, 1.0);
+
+    // Create variables, log_vars_map holds ln(bn) and ln(bs)
+    std::map<std::string, GRBVar> log_vars_map;
+    std::map<std::string, double> log_ub_map;
+    std::map<std::string, std::map<long, GRBVar> > exp_vars_map;
+    for (auto op : op_chain_ops)
+    for (auto d : op->getDims()) {
+      std::string grbvar_name = op->getName() + '_' + d->getName();
+      std::string grbvar_bn_name = grbvar_name + "_bn";
+      std::string grbvar_bs_name = grbvar_name + "_bs";
+      double log_size = std::log(static_cast<double>(d->getSize()));
+      GRBLinExpr log_bs_expr = 0;
+      for (const auto &pf : findPrimeFactors(d->getSize())) {
+        GRBVar e = model.addVar(0.0, pf.second, 0.0, GRB_INTEGER,
+                                grbvar_name + "_e" + std::to_string(pf.first));
+        exp_vars_map[grbvar_name][pf.first] = e;
+        log_bs_expr += std::log(static_cast<double>(pf.first)) * e;
+      }
+      GRBVar log_bn = model.addVar(0.0, log_size, 0.0, GRB_CONTINUOUS, grbvar_bn_name);
+      GRBVar log_bs = model.addVar(0.0, log_size, 0.0, GRB_CONTINUOUS, grbvar_bs_name);
+      model.addConstr(log_bs == log_bs_expr, grbvar_bs_name + "_c");
+      model.addConstr(log_bn + log_bs == log_size, grbvar_name + "_c");
+      log_vars_map[grbvar_bn_name] = log_bn;
+      log_vars_map[grbvar_bs_name] = log_bs;
+      log_ub_map[grbvar_bn_name] = log_size;
+      log_ub_map[grbvar_bs_name] = log_size;
+    }
+
+    long term_i = 0;
+    auto addExpTerm = [&](const MonomialTerm &term) -> GRBLinExpr {
+      if (term.var_names.empty()) {
+        return term.coef;
+      }
+      double log_lb = std::log(term.coef);
+      double log_ub = log_lb;
+      GRBLinExpr log_expr = log_lb;
+      for (const auto &name : term.var_names) {
+        log_expr += log_vars_map.at(name);
+        log_ub += log_ub_map.at(name);
+      }
+      std::string term_name = "term" + std::to_string(term_i++);
+      GRBVar x = model.addVar(log_lb, log_ub, 0.0, GRB_CONTINUOUS, term_name + "_log");
+      GRBVar y = model.addVar(std::exp(log_lb), std::exp(log_ub), 0.0, GRB_CONTINUOUS, term_name);
+      model.addConstr(x == log_expr, term_name + "_c");
+      model.addGenConstrExp(x, y, term_name + "_exp");
+      return y;
+    };
+
+    // Set objective
+    GRBLinExpr obj = 0;
+    if (bs_model.latency) {
+      for (size_t g = 0; g < bs_model.group_traffic.size(); ++g) {
+        GRBVar latency = model.addVar(0.0, GRB_INFINITY, 0.0, GRB_CONTINUOUS, "latency" + std::to_string(g));
+        GRBLinExpr traffic = 0;
+        for (const auto &term : mergeMonomials(bs_model.group_traffic[g])) {
+          traffic += addExpTerm(term);
+        }
+        GRBLinExpr compute = 0;
+        for (const auto &term : mergeMonomials(bs_model.group_compute[g])) {
+          compute += addExpTerm(term);
+        }
+        model.addConstr(traffic <= options().dram_bandwidth * latency);
+        model.addConstr(compute <= latency);
+        obj += latency;
+      }
+    } else {
+      for (const auto &term : mergeMonomials(bs_model.objective)) {
+        obj += addExpTerm(term);
+      }
+    }
+    model.setObjective(obj, GRB_MINIMIZE);
+
+    // Add constraint
+    for (const auto &fv : bs_model.fixed_vars) {
+      model.addConstr(log_vars_map.at(fv.first) == std::log(static_cast<double>(fv.second)), fv.first);
+    }
+    for (const auto &mbs : bs_model.min_block_sizes) {
+      model.addConstr(log_vars_map.at(mbs.first) >= std::log(static_cast<double>(mbs.second)));
+    }
+    for (const auto &cuc : bs_model.compute_util_constraints) {
+      GRBLinExpr compute_util_constraint = 0;
+      for (const auto &term : mergeMonomials(cuc)) {
+        compute_util_constraint += addExpTerm(term);
+      }
+      model.addConstr(compute_util_constraint >= options().compute_power);
+    }
+    for (const auto &fc : bs_model.footprint_constraints) {
+      GRBLinExpr local_constraint = 0;
+      for (const auto &term : mergeMonomials(fc)) {
+        local_constraint += addExpTerm(term);
+      }
+      model.addConstr(local_constraint <= mem_constraint, "_c");
+    }
+    for (const auto &ev : bs_model.equal_vars) {
+      model.addConstr(log_vars_map.at(ev.first) == log_vars_map.at(ev.second));
+    }
+
+    if (!lp_file.empty()) {
+      model.write(lp_file);
+    }
+    // Optimize model
+    model.optimize();
+
+    if (model.get(GRB_IntAttr_Status) == GRB_OPTIMAL) {
+      std::map<std::string, long> values;
+      for (auto op : op_chain_ops)
+      for (auto d : op->getDims()) {
+        std::string grbvar_name = op->getName() + "_" + d->getName();
+        long bs = 1;
+        for (const auto &ev : exp_vars_map[grbvar_name]) {
+          long e = std::lround(ev.second.get(GRB_DoubleAttr_X));
+          for (long i = 0; i < e; ++i) {
+            bs *= ev.first;
+          }
+        }
+        d->setBlockSize(op, bs);
+        values[grbvar_name + "_bn"] = d->getSize() / bs;
+        values[grbvar_name + "_bs"] = bs;
+      }
+      // exp is overestimated, so the footprint fits but the compute utilization may fall short of
+      // its bound, and a solution violating either constraint is rejected
+      for (const auto &fc : bs_model.footprint_constraints) {
+        if (evaluateMonomials(fc, values) > mem_constraint) {
+          std::cerr << "Log-domain solution exceeds mem_size: " << mem_constraint << ": "
+                    << op_chain->toString() << std::endl;
+          return FLT_MAX;
+        }
+      }
+      for (const auto &cuc : bs_model.compute_util_constraints) {
+        if (evaluateMonomials(cuc, values) < options().compute_power) {
+          std::cerr << "Log-domain solution violates compute utilization constraint: "
+                    << op_chain->toString() << std::endl;
+          return FLT_MAX;
+        }
+      }
+      double ret_obj = bs_model.latency ? evaluateLatency(bs_model, values)
+                                        : evaluateMonomials(bs_model.objective, values);
+      if (print_info) {
+        for (const auto &v : values) {
+          std::cout << v.first << " " << v.second << std::endl;
+        }
+        std::cout << "Obj: " << ret_obj << " (approximate: " << model.get(GRB_DoubleAttr_ObjVal) << ")"
+                  << std::endl;
+      }
+      return ret_obj;
+    } else if (model.get(GRB_IntAttr_Status) == GRB_INFEASIBLE) {
+      if (print_info) {
+        std::cout << "This is infeasible for mem size " << mem_constraint << ": "
+                  << op_chain->toString() << std::endl;
+      }
+      return FLT_MAX;
+    } else {
+      std::cerr << "Get non optimal results, please check. mem_size: " << mem_constraint << ": "
+                << op_chain->toString() << std::endl;
+      return FLT_MAX;
+    }
+
+  } catch (const GRBException &e) {
+    std::cout << "Error code = " << e.getErrorCode() << std::endl;
+    std::cout << e.getMessage() << std::endl;
+    return FLT_MAX;
+  } catch (...) {
+    std::cout << "Exception during optimization" << std::endl;
+    return FLT_MAX;
+  }
+}
+
+double mipBlockSize(OperatorChain *op_chain,
+                    long mem_constraint,
+                    bool print_info = false,
+                    const std::string &lp_file = "") {
+  if (options().mip_formulation == "log") {
+    return mipBlockSizeLog(op_chain, mem_constraint, print_info, lp_file);
+  }
+  return mipBlockSizeNonConvex(op_chain, mem_constraint, print_info, lp_file);
+}
+
 }
 
 #endif //MMCHAIN_ANALYSIS_SRC_TO_GUROBI_H
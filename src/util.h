@@ -6,6 +6,8 @@
 #define MMCHAIN_ANALYSIS_SRC_UTIL_H
 
 #include <string>
+#include <vector>
+#include <map>
 #include <iostream>
 
 bool printAndReturnFalse(std::string s) {
@@ -13,4 +15,39 @@ bool printAndReturnFalse(std::string s) {
   return false;
 };
 
+// Divisors of number in ascending order, found by trial division up to sqrt(number).
+std::vector<long> findFactors(long number) {
+  std::vector<long> factors;
+  std::vector<long> large_factors;
+
+  for (long i = 1; i * i <= number; ++i) {
+    if (number % i == 0) {
+      factors.push_back(i);
+      if (i != number / i) {
+        large_factors.push_back(number / i);
+      }
+    }
+  }
+  factors.insert(factors.end(), large_factors.rbegin(), large_factors.rend());
+
+  return factors;
+}
+
+// Prime factorization of number as {prime: exponent}.
+std::map<long, int> findPrimeFactors(long number) {
+  std::map<long, int> prime_factors;
+
+  for (long p = 2; p * p <= number; ++p) {
+    while (number % p == 0) {
+      prime_factors[p]++;
+      number /= p;
+    }
+  }
+  if (number > 1) {
+    prime_factors[number]++;
+  }
+
+  return prime_factors;
+}
+
 #endif //MMCHAIN_ANALYSIS_SRC_UTIL_H
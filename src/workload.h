@@ -0,0 +1,579 @@
+#ifndef MMCHAIN_ANALYSIS_SRC_WORKLOAD_H
+#define MMCHAIN_ANALYSIS_SRC_WORKLOAD_H
+
+#include <iostream>
+#include <memory>
+#include "operator-chain.h"
+#include "dse.h"
+#include "options.h"
+#include "pareto.h"
+#include "mem-hierarchy.h"
+#include "partition.h"
+#include "simulator.h"
+#include "graph-file.h"
+
+namespace DAT {
+
+struct ExploreResult {
+  bool feasible{false};
+  long operator_chain_num{0};
+  long access_volume{0};
+  long compute_time{0};
+  long mem_footprint{0};
+  long latency{0};
+  // traffic at the boundary above each level of options().inner_mem_sizes
+  std::vector<long> level_access_volumes;
+  // the split over options().core_num cores, see CorePartition::toString
+  std::string partition{"none"};
+  // access_volume over workloadTokenNum, the traffic of each generated token when decoding
+  long access_volume_per_token{0};
+  // the tensors fused inside an operator chain, never moved to DRAM
+  std::set<std::string> internal_tensors;
+  // the access volume the fusion across the boundary of two layers saves, see exploreLayers
+  long boundary_saving{0};
+};
+
+// The tokens the workload graph runs: the query rows of every sequence of the batch, which are the
+// new tokens of a decode step.
+long workloadTokenNum() {
+  const Options &o = DAT::options();
+  long tokens = o.kv_cache_length > 0 ? o.decode_tokens : o.seq_length;
+  return std::max(1L, o.batch_size) * std::max(1L, tokens);
+}
+
+// Explore the fusion, orders and block sizes of a graph under mem_size, see fuseSearch for
+// the fusion search. The chosen schedule is printed to out unless it is null. Bounds from the
+// exploration of the same graph at a larger mem_size, if any, prune the fuse patterns and are
+// updated for a smaller one. With options().pareto_result, the Pareto front of all explored
+// schedules is written to it. Bounds and the Pareto front only apply to the traversal.
+ExploreResult exploreGraph(const std::set<DAT::TensorOperator *> &non_add_to_operator_chain,
+                           const std::set<DAT::Tensor *> &tensors,
+                           long mem_size,
+                           std::ostream *out,
+                           FuseBounds *bounds = nullptr) {
+  std::unique_ptr<DAT::ParetoArchive> archive;
+  if (!DAT::options().pareto_result.empty()) {
+    archive = std::make_unique<DAT::ParetoArchive>();
+    // pruning by access volume would drop schedules better in the other objectives
+    bounds = nullptr;
+  }
+  DAT::LogRecord6 log_record;
+  if (DAT::options().save_log_file >= 1) {
+    log_record.id = 1;
+    log_record.defineAlgroithm(non_add_to_operator_chain);
+    log_record.set_ndh(DAT::options().seq_length, DAT::options().hid_size, DAT::options().head_num);
+    log_record.mem_size = mem_size;
+  }
+
+  std::vector<DAT::OperatorChain *> op_chain(non_add_to_operator_chain.size(), nullptr);
+  long operator_chain_num;
+  std::string fuse_search = DAT::fuseSearch(tensors);
+  if (fuse_search == "greedy") {
+    operator_chain_num = DAT::greedyFused(non_add_to_operator_chain, tensors, mem_size, op_chain.data(),
+                                          DAT::options().print_to_screen);
+  } else if (fuse_search == "dp") {
+    operator_chain_num = DAT::dpFused(non_add_to_operator_chain, tensors, mem_size, op_chain.data(),
+                                      DAT::options().print_to_screen);
+  } else {
+    operator_chain_num = DAT::traversalFused(non_add_to_operator_chain, tensors, mem_size, op_chain.data(),
+                                             DAT::options().print_to_screen, bounds, archive.get());
+  }
+  for (long i = 0; i < operator_chain_num; ++i) {
+    op_chain[i]->setTensorsIsExternal();
+  }
+  if (DAT::options().save_log_file >= 1) {
+    std::set<DAT::Tensor *> non_io_tensors;
+    for (auto t :tensors) {
+      if (!t->isIO()) {
+        non_io_tensors.insert(t);
+      }
+    }
+    log_record.recordFuseStatus(non_io_tensors);
+  }
+  ExploreResult result;
+  result.feasible = operator_chain_num > 0;
+  result.operator_chain_num = operator_chain_num;
+  std::vector<long> inner_mem_sizes = DAT::parseInnerMemSizes(DAT::options().inner_mem_sizes);
+  result.level_access_volumes.assign(inner_mem_sizes.size(), 0);
+  for (long i = 0; i < operator_chain_num; ++i) {
+    DAT::OperatorChain *mul_chain = op_chain[i];
+    mul_chain->setInternalTensorsFuse();
+    for (auto t : mul_chain->getInternalTensors()) {
+      result.internal_tensors.insert(t->getName());
+    }
+    mul_chain->setExternalTensorsFusePattern(mul_chain->getExternalTensorsFusePattern());
+    mul_chain->setOrder(mul_chain->getOperatorTree().getOrderInfos());
+    DAT::optimizeBlockSize(mul_chain, mem_size);
+    mul_chain->setOrder(mul_chain->getOperatorTree().getOrderInfos());
+    if (DAT::options().save_log_file >= 1) {
+      log_record.recordSubFuseStatus(mul_chain, mul_chain->getExternalTensors());
+      log_record.recordOrder(mul_chain, mul_chain->getOperatorTree().getOrderInfos());
+      log_record.recordDimBlocksizes(mul_chain);
+      log_record.recordOpChainMemAccessVolume(mul_chain);
+    }
+    if (out) {
+      *out << mul_chain->toString();
+      *out << "access times: " << mul_chain->getMemAccessTimes() << std::endl;
+      *out << "access volume: " << mul_chain->getMemAccessVolume() << std::endl;
+      *out << "SRAM footprint: " << mul_chain->getMemFootprint() << std::endl;
+      if (DAT::options().objective == "latency") {
+        *out << "latency: " << mul_chain->latency() << std::endl;
+      }
+      if (DAT::options().simulate) {
+        DAT::SimulationResult simulated = DAT::simulateChain(mul_chain);
+        *out << "simulated access volume: " << simulated.access_volume << std::endl;
+        *out << "simulated SRAM footprint: " << simulated.mem_footprint << std::endl;
+      }
+    }
+    std::vector<DAT::LevelTiling> levels = DAT::optimizeInnerLevels(mul_chain->getOperators(), inner_mem_sizes);
+    for (size_t l = 0; l < levels.size(); ++l) {
+      if (!levels[l].feasible) {
+        result.feasible = false;
+        if (out) {
+          *out << "level " << l + 1 << " of size " << levels[l].capacity << " can not hold any tile" << std::endl;
+        }
+        continue;
+      }
+      result.level_access_volumes[l] += levels[l].access_volume;
+      if (out) {
+        *out << "level " << l + 1 << " access volume: " << levels[l].access_volume
+             << ", footprint: " << levels[l].mem_footprint << std::endl;
+      }
+    }
+    result.access_volume += mul_chain->getMemAccessVolume();
+    result.compute_time += mul_chain->compute_time();
+    result.latency += mul_chain->latency();
+    result.mem_footprint = std::max(result.mem_footprint, mul_chain->getMemFootprint());
+  }
+
+  if (out) {
+    *out << "-----------------------------------------" << std::endl;
+    *out << "total access volume: " << result.access_volume << std::endl;
+    for (size_t l = 0; l < result.level_access_volumes.size(); ++l) {
+      *out << "total level " << l + 1 << " access volume: " << result.level_access_volumes[l] << std::endl;
+    }
+    if (DAT::options().objective == "latency") {
+      *out << "total latency: " << result.latency << std::endl;
+    }
+  }
+
+  if (DAT::options().save_log_file >= 1) {
+    log_record.mem_access_volume = result.access_volume;
+    log_record.compute_time = result.compute_time;
+    log_record.mem_footprint = result.mem_footprint;
+    log_record.writeToFile(DAT::options().log_directory + "/log1.csv");
+  }
+  if (archive) {
+    archive->writeToFile(DAT::options().pareto_result);
+  }
+
+  for (long i = 0; i < operator_chain_num; ++i) {
+    delete op_chain[i];
+  }
+
+  return result;
+}
+
+// Explore a graph split over options().core_num cores, each with mem_size of SRAM and sharing
+// the DRAM bandwidth. Every partition of partitionDims is explored on the slice of one core, and
+// the partition with the best objective is explored again to print its schedule. Access volumes
+// and compute times are of all cores, the latency and footprint are of one core running the
+// largest slice. Bounds only apply to a single core, whose graph keeps its sizes.
+ExploreResult explorePartitioned(const std::set<DAT::TensorOperator *> &operators,
+                                 const std::set<DAT::Tensor *> &tensors,
+                                 long mem_size,
+                                 std::ostream *out,
+                                 FuseBounds *bounds = nullptr) {
+  long core_num = DAT::options().core_num;
+  if (core_num <= 1) {
+    ExploreResult result = exploreGraph(operators, tensors, mem_size, out, bounds);
+    result.access_volume_per_token = result.access_volume / workloadTokenNum();
+    return result;
+  }
+
+  // the slices of the cores run concurrently, and share the DRAM bandwidth
+  Context core_context(DAT::options());
+  core_context.order_cache = currentContext().order_cache;
+  core_context.options.dram_bandwidth = std::max(1L, DAT::options().dram_bandwidth / core_num);
+  auto explorePartition = [&](const CorePartition &partition, std::ostream *partition_out) {
+    ExploreResult result;
+    {
+      ContextScope scope(core_context);
+      PartitionScope partition_scope(operators, partition);
+      result = exploreGraph(operators, tensors, mem_size, partition_out);
+    }
+    double cores = static_cast<double>(core_num) * partition.balance();
+    result.access_volume = static_cast<long>(static_cast<double>(result.access_volume) * cores);
+    result.compute_time = static_cast<long>(static_cast<double>(result.compute_time) * cores);
+    for (auto &volume : result.level_access_volumes) {
+      volume = static_cast<long>(static_cast<double>(volume) * cores);
+    }
+    result.partition = partition.toString();
+    return result;
+  };
+
+  core_context.options.save_log_file = 0;
+  core_context.options.pareto_result.clear();
+  CorePartition best_partition;
+  double best_cost = FLT_MAX;
+  for (const auto &partition : enumeratePartitions(partitionDims(operators), core_num)) {
+    ExploreResult result = explorePartition(partition, nullptr);
+    double cost = DAT::options().objective == "latency" ? static_cast<double>(result.latency)
+                                                        : static_cast<double>(result.access_volume);
+    if (DAT::options().print_to_screen) {
+      std::cout << "partition " << result.partition << ": " << (result.feasible ? cost : FLT_MAX) << std::endl;
+    }
+    if (result.feasible && cost < best_cost) {
+      best_cost = cost;
+      best_partition = partition;
+    }
+  }
+  if (best_cost == FLT_MAX) {
+    return {};
+  }
+
+  core_context.options.save_log_file = DAT::options().save_log_file;
+  core_context.options.pareto_result = DAT::options().pareto_result;
+  if (out) {
+    *out << "partition over " << core_num << " cores: " << best_partition.toString()
+         << ", balance: " << best_partition.balance() << std::endl;
+    *out << "replicated tensors:";
+    for (auto t : tensors) {
+      if (best_partition.isReplicated(t)) {
+        *out << " " << t->getName();
+      }
+    }
+    *out << std::endl;
+    *out << "schedule of one core:" << std::endl;
+  }
+  ExploreResult result = explorePartition(best_partition, out);
+  if (out) {
+    *out << "total access volume of " << core_num << " cores: " << result.access_volume << std::endl;
+  }
+  result.access_volume_per_token = result.access_volume / workloadTokenNum();
+  return result;
+}
+
+// The part of a post-LN transformer block after the attention, on its output A: the output
+// projection over the heads, a residual add and a layer norm, then the FFN up and down projections
+// with an activation, a residual add and a layer norm. The residual inputs are separate graph
+// inputs, as I1, I2 and I3 are copies of the block input, unless shared_residual: the second
+// residual then adds N1 itself, which the FFN and the add both consume, and the FFN output takes
+// the model dim e of N1. The query heads are hsc, followed by gsc with grouped query attention.
+struct TransformerBlockTail {
+  TransformerBlockTail(Dim *dim_n, Dim *dim_d, Dim *dim_bs, const std::vector<Dim *> &q_heads, Tensor *mat_a,
+                       long model_size, long ffn_size, bool shared_residual = false)
+      : dim_e("e", model_size), dim_f("f", ffn_size), dim_g("g", model_size),
+        mat_wo("Wo", [&] {
+          std::vector<Dim *> dims = {dim_d};
+          dims.insert(dims.end(), q_heads.begin(), q_heads.end());
+          dims.push_back(&dim_e);
+          return dims;
+        }()), mat_o("O", dim_n, &dim_e, dim_bs), mat_x("X", dim_n, &dim_e, dim_bs),
+        mat_r1("R1", dim_n, &dim_e, dim_bs), mat_n1("N1", dim_n, &dim_e, dim_bs), mat_w1("W1", &dim_e, &dim_f),
+        mat_h("H", dim_n, &dim_f, dim_bs), mat_g("G", dim_n, &dim_f, dim_bs),
+        mat_w2("W2", &dim_f, shared_residual ? &dim_e : &dim_g),
+        mat_y("Y", dim_n, shared_residual ? &dim_e : &dim_g, dim_bs), mat_n1r("N1r", dim_n, &dim_g, dim_bs),
+        mat_r2("R2", dim_n, shared_residual ? &dim_e : &dim_g, dim_bs),
+        mat_z("Z", dim_n, shared_residual ? &dim_e : &dim_g, dim_bs),
+        mul_o("mul_o", mat_a, &mat_wo, &mat_o), residual1("residual1", "add", {&mat_o, &mat_x}, &mat_r1),
+        norm1("norm1", &mat_r1, &mat_n1, &dim_e), mul_up("mul_up", &mat_n1, &mat_w1, &mat_h),
+        gelu("gelu", "gelu", {&mat_h}, &mat_g, 8), mul_down("mul_down", &mat_g, &mat_w2, &mat_y),
+        residual2("residual2", "add", {&mat_y, shared_residual ? &mat_n1 : &mat_n1r}, &mat_r2),
+        norm2("norm2", &mat_r2, &mat_z, shared_residual ? &dim_e : &dim_g),
+        m_o(&mul_o), m_residual1(&residual1), m_norm1(&norm1), m_up(&mul_up), m_gelu(&gelu), m_down(&mul_down),
+        m_residual2(&residual2), m_norm2(&norm2) {
+    mat_wo.setRole(TensorRole::Weight);
+    mat_w1.setRole(TensorRole::Weight);
+    mat_w2.setRole(TensorRole::Weight);
+    // weights are shared by the batch, and the output projection reduces the heads
+    for (auto op : getOperators()) {
+      op->isBatchDependent(true);
+      op->isHeadDependent(op == &mul_o);
+      dim_bs->setBlockSize(op, options().batch_blocksize);
+    }
+    q_heads.front()->setBlockSize(&mul_o, options().head_blocksize);
+    for (size_t i = 1; i < q_heads.size(); ++i) {
+      q_heads[i]->setBlockSize(&mul_o, 1);
+    }
+  }
+  std::set<TensorOperator *> getOperators() {
+    return {&mul_o, &residual1, &norm1, &mul_up, &gelu, &mul_down, &residual2, &norm2};
+  }
+  std::set<Tensor *> getTensors() {
+    std::set<Tensor *> tensors = {&mat_wo, &mat_o, &mat_x, &mat_r1, &mat_n1, &mat_w1, &mat_h, &mat_g, &mat_w2,
+                                  &mat_y, &mat_r2, &mat_z};
+    if (residual2.hasTensor(&mat_n1r)) {
+      tensors.insert(&mat_n1r);
+    }
+    return tensors;
+  }
+
+  Dim dim_e, dim_f, dim_g;
+  TensorND mat_wo;
+  Tensor3D mat_o, mat_x, mat_r1, mat_n1;
+  Tensor2D mat_w1;
+  Tensor3D mat_h, mat_g;
+  Tensor2D mat_w2;
+  Tensor3D mat_y, mat_n1r, mat_r2, mat_z;
+  MatrixMul mul_o;
+  ElementWise residual1;
+  LayerNorm norm1;
+  MatrixMul mul_up;
+  ElementWise gelu;
+  MatrixMul mul_down;
+  ElementWise residual2;
+  LayerNorm norm2;
+  OperatorNode m_o, m_residual1, m_norm1, m_up, m_gelu, m_down, m_residual2, m_norm2;
+};
+
+// Build the graph of options().workload from the options of the current context and call
+// explore(operators, tensors) on it: the attention, or a whole transformer block, in the prefill
+// or, with a kv_cache_length, a decode step. options().graph_file replaces the workload by the
+// graph of the file, see GraphFile, with options().layer_num layers. The graph lives until
+// explore returns.
+template<class Explore>
+auto withWorkloadGraph(Explore &&explore) {
+  if (!DAT::options().graph_file.empty()) {
+    DAT::GraphFile graph(DAT::options().graph_file, DAT::options().layer_num);
+    return explore(graph.getOperators(), graph.getTensors());
+  }
+  if (DAT::options().layer_num != 1) {
+    throw std::invalid_argument("several layers need a graph file with a boundary");
+  }
+  // an unknown workload or a kv_head_num not dividing head_num throws std::invalid_argument
+  DAT::options().check();
+  DAT::Dim dim_n("n"), dim_l("l"), dim_q("q"), dim_m("m"), dim_k("k"), dim_p("p"), dim_d("d");
+  DAT::Dim dim_bs("bsc"), dim_hs("hsc"), dim_gs("gsc");
+
+  long h_size = DAT::options().head_num;
+  long d_size = DAT::options().hid_size;
+  long n_size = DAT::options().seq_length;
+  long batch_size = DAT::options().batch_size;
+  long batch_blocksize = DAT::options().batch_blocksize;
+  long head_blocksize = DAT::options().head_blocksize;
+  long dh_size = d_size * h_size;
+  // a decode step runs the new tokens n against the cached keys and values m, read from DRAM,
+  // while the K and V projections of the new tokens are stored to append them to the cache
+  bool decode = DAT::options().kv_cache_length > 0;
+  dim_n.setSize(decode ? DAT::options().decode_tokens : n_size);
+  dim_m.setSize(decode ? DAT::options().kv_cache_length : n_size);
+  dim_l.setSize(dh_size);
+  dim_k.setSize(dh_size);
+  dim_p.setSize(dh_size);
+  dim_q.setSize(d_size);
+  dim_d.setSize(d_size);
+  dim_bs.setSize(batch_size);
+  // with grouped query attention, hsc runs over the K/V heads and gsc over the query heads
+  // sharing each of them, so the query side has both dims and K and V only hsc
+  long kv_head_num = DAT::options().kv_head_num > 0 ? DAT::options().kv_head_num : h_size;
+  bool grouped = kv_head_num < h_size;
+  dim_hs.setSize(kv_head_num);
+  std::vector<DAT::Dim *> q_heads = {&dim_hs};
+  if (grouped) {
+    dim_gs.setSize(h_size / kv_head_num);
+    q_heads.push_back(&dim_gs);
+  }
+  auto withQueryHeads = [&q_heads](std::vector<DAT::Dim *> dims) {
+    dims.insert(dims.end(), q_heads.begin(), q_heads.end());
+    return dims;
+  };
+
+  DAT::Tensor3D mat_i1("I1", &dim_n, &dim_l, &dim_bs);
+  DAT::TensorND mat_wq("Wq", withQueryHeads({&dim_l, &dim_q}));
+  DAT::Dim *dim_kv = decode ? &dim_n : &dim_m;
+  DAT::Tensor3D mat_i2("I2", dim_kv, &dim_k, &dim_bs), mat_wk("Wk", &dim_k, &dim_q, &dim_hs);
+  // with shared tensors, the K and V projections read I2, which a chain of both loads once
+  bool shared = DAT::options().shared_tensors;
+  DAT::Tensor3D mat_i3("I3", dim_kv, &dim_p, &dim_bs), mat_wv("Wv", shared ? &dim_k : &dim_p, &dim_d, &dim_hs);
+  DAT::TensorND mat_q("Q", withQueryHeads({&dim_n, &dim_q, &dim_bs}));
+  DAT::Tensor4D mat_k("K", dim_kv, &dim_q, &dim_bs, &dim_hs), mat_kc("Kc", &dim_m, &dim_q, &dim_bs, &dim_hs);
+  DAT::TensorND mat_s("S", withQueryHeads({&dim_n, &dim_m, &dim_bs}));
+  DAT::Tensor4D mat_v("V", dim_kv, &dim_d, &dim_bs, &dim_hs), mat_vc("Vc", &dim_m, &dim_d, &dim_bs, &dim_hs);
+  DAT::TensorND mat_a("A", withQueryHeads({&dim_n, &dim_d, &dim_bs}));
+  DAT::TensorND mat_p("P", withQueryHeads({&dim_n, &dim_m, &dim_bs}));
+  mat_wq.setRole(DAT::TensorRole::Weight);
+  mat_wk.setRole(DAT::TensorRole::Weight);
+  mat_wv.setRole(DAT::TensorRole::Weight);
+  mat_s.setRole(DAT::TensorRole::Score);
+  mat_p.setRole(DAT::TensorRole::Score);
+  bool with_softmax = DAT::options().softmax;
+  DAT::MatrixMul mul_q("mul_q", &mat_i1, &mat_wq, &mat_q),
+      mul_v("mul_v", shared ? &mat_i2 : &mat_i3, &mat_wv, &mat_v);
+  DAT::MatrixMul mul_k("mul_k", &mat_i2, &mat_wk, &mat_k),
+      mul_s("mul_s", &mat_q, decode ? &mat_kc : &mat_k, &mat_s);
+  DAT::MatrixMul mul_a("mul_a", with_softmax ? &mat_p : &mat_s, decode ? &mat_vc : &mat_v, &mat_a);
+  mul_q.isBatchDependent(true);
+  mul_k.isBatchDependent(true);
+  mul_v.isBatchDependent(true);
+  mul_s.isBatchDependent(false);
+  mul_a.isBatchDependent(false);
+  mul_q.isHeadDependent(true);
+  mul_k.isHeadDependent(true);
+  mul_v.isHeadDependent(true);
+  mul_s.isHeadDependent(false);
+  mul_a.isHeadDependent(false);
+  DAT::OperatorNode m_q(&mul_q), m_v(&mul_v), m_k(&mul_k), m_s(&mul_s), m_a(&mul_a);
+
+  dim_bs.setBlockSize(&mul_q, batch_blocksize);
+  dim_hs.setBlockSize(&mul_q, head_blocksize);
+  dim_bs.setBlockSize(&mul_k, batch_blocksize);
+  dim_hs.setBlockSize(&mul_k, head_blocksize);
+  dim_bs.setBlockSize(&mul_v, batch_blocksize);
+  dim_hs.setBlockSize(&mul_v, head_blocksize);
+  dim_bs.setBlockSize(&mul_s, batch_blocksize);
+  dim_hs.setBlockSize(&mul_s, head_blocksize);
+  dim_bs.setBlockSize(&mul_a, batch_blocksize);
+  dim_hs.setBlockSize(&mul_a, head_blocksize);
+  if (grouped) {
+    for (auto op : {&mul_q, &mul_s, &mul_a}) {
+      dim_gs.setBlockSize(op, 1);
+    }
+  }
+
+  std::set<DAT::TensorOperator *>
+      non_add_to_operator_chain = {&mul_q, &mul_k, &mul_v, &mul_s, &mul_a};
+  std::set<DAT::Tensor *> tensors =
+      {&mat_i1, &mat_i2, &mat_wq, &mat_wk, &mat_wv, &mat_q, &mat_k, &mat_v, &mat_s, &mat_a};
+  if (!shared) {
+    tensors.insert(&mat_i3);
+  }
+  if (decode) {
+    tensors.insert(&mat_kc);
+    tensors.insert(&mat_vc);
+  }
+  // the softmax of each query row of the scores, over the keys, only linked to S when added
+  std::unique_ptr<DAT::Softmax> softmax;
+  std::unique_ptr<DAT::OperatorNode> m_softmax;
+  if (with_softmax) {
+    softmax = std::make_unique<DAT::Softmax>("softmax", &mat_s, &mat_p, &dim_m);
+    softmax->isBatchDependent(false);
+    softmax->isHeadDependent(false);
+    m_softmax = std::make_unique<DAT::OperatorNode>(softmax.get());
+    dim_bs.setBlockSize(softmax.get(), batch_blocksize);
+    dim_hs.setBlockSize(softmax.get(), head_blocksize);
+    if (grouped) {
+      dim_gs.setBlockSize(softmax.get(), 1);
+    }
+    non_add_to_operator_chain.insert(softmax.get());
+    tensors.insert(&mat_p);
+  }
+  std::unique_ptr<DAT::TransformerBlockTail> tail;
+  if (DAT::options().workload == "transformer_block") {
+    long ffn_size = DAT::options().ffn_size > 0 ? DAT::options().ffn_size : 4 * dh_size;
+    tail = std::make_unique<DAT::TransformerBlockTail>(&dim_n, &dim_d, &dim_bs, q_heads, &mat_a, dh_size, ffn_size,
+                                                       shared);
+    for (auto op : tail->getOperators()) {
+      non_add_to_operator_chain.insert(op);
+    }
+    for (auto t : tail->getTensors()) {
+      tensors.insert(t);
+    }
+  }
+
+  return explore(non_add_to_operator_chain, tensors);
+}
+
+// The result of layer_num layers from the results of one and two layers: every layer after the
+// first adds what the second adds, its own schedule less the saving of the fusion across the
+// boundary before it.
+ExploreResult extrapolateLayers(const ExploreResult &one, const ExploreResult &two, long layer_num) {
+  auto extrapolate = [layer_num](long one_value, long two_value) {
+    return one_value + (layer_num - 1) * (two_value - one_value);
+  };
+  ExploreResult result = two;
+  result.feasible = one.feasible && two.feasible;
+  result.operator_chain_num = extrapolate(one.operator_chain_num, two.operator_chain_num);
+  result.access_volume = extrapolate(one.access_volume, two.access_volume);
+  result.compute_time = extrapolate(one.compute_time, two.compute_time);
+  result.latency = extrapolate(one.latency, two.latency);
+  result.mem_footprint = std::max(one.mem_footprint, two.mem_footprint);
+  for (size_t l = 0; l < result.level_access_volumes.size() && l < one.level_access_volumes.size(); ++l) {
+    result.level_access_volumes[l] = extrapolate(one.level_access_volumes[l], two.level_access_volumes[l]);
+  }
+  result.boundary_saving = 2 * one.access_volume - two.access_volume;
+  return result;
+}
+
+// Explore options().layer_num layers of the graph file under mem_size. The layers are identical,
+// so one layer and two layers are explored, and the later layers extrapolated from the boundary
+// between the two, see extrapolateLayers. Three layers verify the boundary repeats: the fusion
+// across a boundary may change the schedule of the layers around it, and if three layers do not
+// add the same to the objective as two, all layers are explored. The explorations share an order
+// cache, the one of the context or their own, whose keys count the layers from the first one of
+// each chain, so a chain repeated in every layer is searched once. A fused boundary tensor stored
+// for other inputs of the next layer adds its store. The schedule of two layers, or of all layers,
+// is printed to out unless it is null.
+ExploreResult exploreLayers(long mem_size, std::ostream *out) {
+  long layer_num = DAT::options().layer_num;
+  Context layers_context = currentContext();
+  if (!layers_context.order_cache) {
+    layers_context.order_cache = std::make_shared<OrderCache>();
+  }
+  ContextScope scope(layers_context);
+  auto exploreLayerGraph = [mem_size](long layers, std::ostream *layers_out) {
+    DAT::GraphFile graph(DAT::options().graph_file, layers);
+    ExploreResult result = explorePartitioned(graph.getOperators(), graph.getTensors(), mem_size, layers_out);
+    for (const auto &bt : graph.getBoundaryTensors()) {
+      if (bt.second && result.internal_tensors.count(bt.first->getName())) {
+        result.access_volume += bt.first->getSize() * bt.first->getElementBytes();
+      }
+    }
+    return result;
+  };
+  ExploreResult one = exploreLayerGraph(1, nullptr);
+  ExploreResult result;
+  bool repeated = false;
+  if (layer_num > 3) {
+    if (out) {
+      *out << "schedule of two layers:" << std::endl;
+    }
+    ExploreResult two = exploreLayerGraph(2, out);
+    ExploreResult three = exploreLayerGraph(3, nullptr);
+    auto objective = [](const ExploreResult &r) {
+      return DAT::options().objective == "latency" ? r.latency : r.access_volume;
+    };
+    repeated = objective(three) - objective(two) == objective(two) - objective(one);
+    if (repeated) {
+      result = extrapolateLayers(one, two, layer_num);
+    } else if (out) {
+      *out << "the boundary of three layers differs from two, exploring " << layer_num << " layers" << std::endl;
+    }
+  }
+  if (!repeated) {
+    result = exploreLayerGraph(layer_num, out);
+    if (layer_num > 1) {
+      result.boundary_saving = (layer_num * one.access_volume - result.access_volume) / (layer_num - 1);
+    }
+  }
+  result.access_volume_per_token = result.access_volume / workloadTokenNum();
+  if (out) {
+    *out << "access volume of one layer: " << one.access_volume << std::endl;
+    *out << "access volume saved at each boundary: " << result.boundary_saving << std::endl;
+    *out << "total access volume of " << layer_num << " layers: " << result.access_volume << std::endl;
+  }
+  return result;
+}
+
+// Explore the workload graph under the options of the current context.
+ExploreResult exploreWorkload(std::ostream *out) {
+  if (DAT::options().layer_num > 1) {
+    ExploreResult result = exploreLayers(DAT::options().mem_size, out);
+    if (out && DAT::options().kv_cache_length > 0) {
+      *out << "access volume per token: " << result.access_volume_per_token << std::endl;
+    }
+    return result;
+  }
+  return withWorkloadGraph([out](const std::set<DAT::TensorOperator *> &operators,
+                                 const std::set<DAT::Tensor *> &tensors) {
+    ExploreResult result = explorePartitioned(operators, tensors, DAT::options().mem_size, out);
+    if (out && DAT::options().kv_cache_length > 0) {
+      *out << "access volume per token: " << result.access_volume_per_token << std::endl;
+    }
+    return result;
+  });
+}
+
+}
+
+#endif //MMCHAIN_ANALYSIS_SRC_WORKLOAD_H
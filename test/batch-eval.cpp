@@ -0,0 +1,363 @@
+#include <random>
+#include <algorithm>
+#include "operator-chain.h"
+
+// Evaluate random candidates with evaluateOrders and compare with setOrder one by one.
+int checkBatchEval(DAT::OperatorChain &mul_chain, int candidate_num) {
+  std::default_random_engine rng{2024};
+  auto nodes = mul_chain.getOperatorTree().getNodes();
+  std::vector<DAT::OperatorTree> order_trees;
+  std::vector<DAT::BlockSizes> block_sizes;
+  for (int c = 0; c < candidate_num; ++c) {
+    // random dims orders, and a random execute order with parents before children
+    std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos;
+    std::vector<DAT::OperatorNode *> ready{nodes[0]};
+    int rank = 0;
+    while (!ready.empty()) {
+      size_t i = std::uniform_int_distribution<size_t>(0, ready.size() - 1)(rng);
+      DAT::OperatorNode *node = ready[i];
+      ready.erase(ready.begin() + static_cast<long>(i));
+      DAT::OrderInfo o_info(node);
+      auto dims = node->getOperator()->getDims();
+      o_info.dims_order.assign(dims.begin(), dims.end());
+      std::shuffle(o_info.dims_order.begin(), o_info.dims_order.end(), rng);
+      o_info.execute_rank = rank++;
+      o_infos[node] = o_info;
+      for (auto child : node->getChildren()) {
+        if (child) {
+          ready.push_back(child);
+        }
+      }
+    }
+    DAT::OperatorTree tree = mul_chain.getOperatorTree();
+    tree.setOrderInfos(o_infos);
+    order_trees.push_back(tree);
+
+    DAT::BlockSizes bss;
+    for (auto op : mul_chain.getOperators()) {
+      for (auto d : op->getDims()) {
+        const auto &factors = d->getFactors();
+        bss[op][d] = factors[std::uniform_int_distribution<size_t>(0, factors.size() - 1)(rng)];
+      }
+    }
+    block_sizes.push_back(bss);
+  }
+
+  auto costs = mul_chain.evaluateOrders(order_trees, block_sizes);
+  for (int c = 0; c < candidate_num; ++c) {
+    for (const auto &op_bs : block_sizes[c]) {
+      for (const auto &d_bs : op_bs.second) {
+        d_bs.first->setBlockSize(op_bs.first, d_bs.second);
+      }
+    }
+    mul_chain.setOrder(order_trees[c].getOrderInfos());
+    if (costs[c].access_volume != mul_chain.getMemAccessVolume()
+        || costs[c].mem_footprint != mul_chain.getMemFootprint()
+        || costs[c].compute_time != mul_chain.compute_time()) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      std::cout << c << ": " << costs[c].access_volume << " " << mul_chain.getMemAccessVolume() << ", "
+                << costs[c].mem_footprint << " " << mul_chain.getMemFootprint() << ", "
+                << costs[c].compute_time << " " << mul_chain.compute_time() << std::endl;
+      return 1;
+    }
+  }
+
+  // every kernel set supported by this CPU gives the same result
+  for (const auto &kernels : DAT::supportedSimdKernels()) {
+    auto isa_costs = mul_chain.evaluateOrders(order_trees, block_sizes, kernels);
+    for (int c = 0; c < candidate_num; ++c) {
+      if (isa_costs[c].access_volume != costs[c].access_volume
+          || isa_costs[c].mem_footprint != costs[c].mem_footprint
+          || isa_costs[c].min_mem_footprint != costs[c].min_mem_footprint
+          || isa_costs[c].min_mem_footprint > costs[c].mem_footprint) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << " " << kernels.isa << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  // the current block sizes are used when none are given
+  auto current_costs = mul_chain.evaluateOrders({mul_chain.getOperatorTree()});
+  if (current_costs[0].access_volume != mul_chain.getMemAccessVolume()
+      || current_costs[0].mem_footprint != mul_chain.getMemFootprint()) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  DAT::options().compute_power = 1024;
+
+  {
+    DAT::Dim dim_n("n"), dim_l("l"), dim_q("q"), dim_m("m"), dim_b("bsc"), dim_h("hsc");
+    dim_n.setSize(512);
+    dim_l.setSize(512);
+    dim_q.setSize(64);
+    dim_m.setSize(512);
+    dim_b.setSize(8);
+    dim_h.setSize(16);
+    DAT::Tensor3D mat_i("I", &dim_n, &dim_l, &dim_b), mat_wq("Wq", &dim_l, &dim_q, &dim_h);
+    DAT::Tensor4D mat_q("Q", &dim_n, &dim_q, &dim_b, &dim_h), mat_k("K", &dim_m, &dim_q, &dim_b, &dim_h),
+        mat_s("S", &dim_n, &dim_m, &dim_b, &dim_h);
+    DAT::MatrixMul mul_q(&mat_i, &mat_wq, &mat_q), mul_s(&mat_q, &mat_k, &mat_s);
+    DAT::OperatorNode m_q(&mul_q), m_s(&mul_s);
+    mat_q.setFuse();
+    DAT::OperatorChain mul_chain;
+    mul_chain.addOperator(&mul_q, &mul_s);
+    DAT::updateOperatorTreeRelationship({&mat_q, &mat_s, &mat_i, &mat_k, &mat_wq});
+    mul_chain.updateTree();
+    mul_chain.addInternalTensor(&mat_q);
+    if (checkBatchEval(mul_chain, 253)) {
+      return 1;
+    }
+  }
+
+  {
+    DAT::Dim dim_n("n"), dim_l("l"), dim_q("q"), dim_m("m"), dim_k("k"), dim_p("p"), dim_d("d");
+    dim_n.setSize(512);
+    dim_l.setSize(512);
+    dim_k.setSize(512);
+    dim_p.setSize(512);
+    dim_q.setSize(64);
+    dim_d.setSize(64);
+    dim_m.setSize(512);
+    DAT::Tensor2D mat_i1("I1", &dim_n, &dim_l), mat_wq("Wq", &dim_l, &dim_q);
+    DAT::Tensor2D mat_i2("I2", &dim_m, &dim_k), mat_wk("Wk", &dim_k, &dim_q);
+    DAT::Tensor2D mat_q("Q", &dim_n, &dim_q), mat_k("K", &dim_m, &dim_q);
+    DAT::Tensor2D mat_i3("I3", &dim_m, &dim_p), mat_wv("Wv", &dim_p, &dim_d);
+    DAT::Tensor2D mat_s("S", &dim_n, &dim_m), mat_v("V", &dim_m, &dim_d),
+        mat_a("A", &dim_n, &dim_d);
+    DAT::MatrixMul mul_q("mul_q", &mat_i1, &mat_wq, &mat_q),
+        mul_v("mul_v", &mat_i3, &mat_wv, &mat_v);
+    DAT::MatrixMul mul_k("mul_k", &mat_i2, &mat_wk, &mat_k),
+        mul_s("mul_s", &mat_q, &mat_k, &mat_s);
+    DAT::MatrixMul mul_a("mul_a", &mat_s, &mat_v, &mat_a);
+    DAT::OperatorNode m_q(&mul_q), m_v(&mul_v), m_k(&mul_k), m_s(&mul_s), m_a(&mul_a);
+    mat_q.setFuse();
+    mat_k.setFuse();
+    mat_s.setFuse();
+    mat_v.setFuse();
+    mat_i2.setFuse();
+    DAT::OperatorChain mul_chain;
+    mul_chain.addOperator(&mul_q, &mul_k, &mul_v, &mul_s, &mul_a);
+    DAT::updateOperatorTreeRelationship({&mat_q, &mat_s, &mat_i1, &mat_i2, &mat_i3, &mat_k, &mat_v,
+                                         &mat_wk, &mat_wv, &mat_a, &mat_wq});
+    mul_chain.updateTree();
+    for (auto t : {&mat_q, &mat_k, &mat_s, &mat_v}) {
+      mul_chain.addInternalTensor(t);
+    }
+    for (auto t : {&mat_i1, &mat_i2, &mat_i3, &mat_wq, &mat_wk, &mat_wv, &mat_a}) {
+      mul_chain.addExternalTensor(t);
+    }
+    if (checkBatchEval(mul_chain, 253)) {
+      return 1;
+    }
+
+    // mixed element widths
+    mat_wq.setRole(DAT::TensorRole::Weight);
+    mat_wk.setRole(DAT::TensorRole::Weight);
+    mat_wv.setRole(DAT::TensorRole::Weight);
+    mat_s.setRole(DAT::TensorRole::Score);
+    DAT::options().activation_bytes = 2;
+    DAT::options().score_bytes = 2;
+    DAT::options().accumulator_bytes = 4;
+    if (checkBatchEval(mul_chain, 253)) {
+      return 1;
+    }
+
+    // double-buffered streamed tiles
+    DAT::options().buffer_num = 2;
+    if (checkBatchEval(mul_chain, 253)) {
+      return 1;
+    }
+
+    // pipelined operator groups
+    DAT::options().pipeline = true;
+    if (checkBatchEval(mul_chain, 253)) {
+      return 1;
+    }
+  }
+
+  // a softmax between the two matrix multiplications of attention
+  DAT::options().buffer_num = 1;
+  DAT::options().pipeline = false;
+  {
+    DAT::Dim dim_n("n"), dim_q("q"), dim_m("m"), dim_d("d");
+    dim_n.setSize(512);
+    dim_q.setSize(64);
+    dim_m.setSize(512);
+    dim_d.setSize(64);
+    DAT::Tensor2D mat_q("Q", &dim_n, &dim_q), mat_k("K", &dim_m, &dim_q), mat_v("V", &dim_m, &dim_d);
+    DAT::Tensor2D mat_s("S", &dim_n, &dim_m), mat_p("P", &dim_n, &dim_m), mat_a("A", &dim_n, &dim_d);
+    DAT::MatrixMul mul_s("mul_s", &mat_q, &mat_k, &mat_s), mul_a("mul_a", &mat_p, &mat_v, &mat_a);
+    DAT::Softmax softmax("softmax", &mat_s, &mat_p, &dim_m);
+    DAT::OperatorNode m_s(&mul_s), m_softmax(&softmax), m_a(&mul_a);
+    // fused scores, unfused probabilities read twice, and unfused scores with fused probabilities
+    std::vector<std::pair<bool, bool> > fusions = {{true, true}, {true, false}, {false, true}};
+    for (const auto &fusion : fusions) {
+      for (auto pipeline : {false, true}) {
+        DAT::options().pipeline = pipeline;
+        fusion.first ? mat_s.setFuse() : mat_s.unsetFuse();
+        fusion.second ? mat_p.setFuse() : mat_p.unsetFuse();
+        DAT::OperatorChain mul_chain;
+        if (fusion.first && fusion.second) {
+          mul_chain.addOperator(&mul_s, &softmax, &mul_a);
+        } else if (fusion.first) {
+          mul_chain.addOperator(&mul_s, &softmax);
+        } else {
+          mul_chain.addOperator(&softmax, &mul_a);
+        }
+        DAT::updateOperatorTreeRelationship({&mat_q, &mat_k, &mat_v, &mat_s, &mat_p, &mat_a});
+        mul_chain.updateTree();
+        for (auto t : {&mat_s, &mat_p}) {
+          if (t->isFused()) {
+            mul_chain.addInternalTensor(t);
+          }
+        }
+        if (checkBatchEval(mul_chain, 253)) {
+          return 1;
+        }
+      }
+    }
+  }
+
+  // a feed forward network with an activation and a residual add
+  DAT::options().pipeline = false;
+  {
+    DAT::Dim dim_n("n"), dim_d("d"), dim_f("f"), dim_e("e");
+    dim_n.setSize(512);
+    dim_d.setSize(256);
+    dim_f.setSize(1024);
+    dim_e.setSize(256);
+    DAT::Tensor2D mat_x("X", &dim_n, &dim_d), mat_w1("W1", &dim_d, &dim_f), mat_h("H", &dim_n, &dim_f);
+    DAT::Tensor2D mat_g("G", &dim_n, &dim_f), mat_w2("W2", &dim_f, &dim_e), mat_y("Y", &dim_n, &dim_e);
+    DAT::Tensor2D mat_r("R", &dim_n, &dim_e), mat_z("Z", &dim_n, &dim_e);
+    DAT::MatrixMul mul_up("mul_up", &mat_x, &mat_w1, &mat_h), mul_down("mul_down", &mat_g, &mat_w2, &mat_y);
+    DAT::ElementWise gelu("gelu", "gelu", {&mat_h}, &mat_g, 8);
+    DAT::ElementWise residual("residual", "add", {&mat_y, &mat_r}, &mat_z);
+    DAT::OperatorNode m_up(&mul_up), m_gelu(&gelu), m_down(&mul_down), m_residual(&residual);
+    mat_h.setFuse();
+    mat_g.setFuse();
+    mat_y.setFuse();
+    for (auto buffer_num : {1, 2}) {
+      DAT::options().buffer_num = buffer_num;
+      DAT::OperatorChain mul_chain;
+      mul_chain.addOperator(&mul_up, &gelu, &mul_down, &residual);
+      DAT::updateOperatorTreeRelationship({&mat_x, &mat_w1, &mat_h, &mat_g, &mat_w2, &mat_y, &mat_r, &mat_z});
+      mul_chain.updateTree();
+      for (auto t : {&mat_h, &mat_g, &mat_y}) {
+        mul_chain.addInternalTensor(t);
+      }
+      if (checkBatchEval(mul_chain, 253)) {
+        return 1;
+      }
+    }
+    // the activation alone, reading and writing DRAM
+    mat_h.unsetFuse();
+    mat_g.unsetFuse();
+    DAT::OperatorChain mul_chain;
+    mul_chain.addOperator(&gelu);
+    DAT::updateOperatorTreeRelationship({&mat_h, &mat_g});
+    mul_chain.updateTree();
+    if (checkBatchEval(mul_chain, 253)) {
+      return 1;
+    }
+  }
+
+  // with the reduction dim innermost the input and weight tiles are streamed and take two copies,
+  // and the output tile stays: 2 * (64 * 32 + 32 * 16) + 64 * 16 bytes
+  DAT::options().activation_bytes = 1;
+  DAT::options().score_bytes = 1;
+  DAT::options().accumulator_bytes = 1;
+  {
+    DAT::Dim dim_n("n"), dim_l("l"), dim_q("q");
+    dim_n.setSize(512);
+    dim_l.setSize(512);
+    dim_q.setSize(64);
+    DAT::Tensor2D mat_i("I", &dim_n, &dim_l), mat_w("W", &dim_l, &dim_q), mat_o("O", &dim_n, &dim_q);
+    DAT::MatrixMul mul("mul", &mat_i, &mat_w, &mat_o);
+    DAT::OperatorNode m(&mul);
+    std::vector<long> footprints;
+    for (auto buffer_num : {1, 2}) {
+      DAT::options().buffer_num = buffer_num;
+      DAT::OperatorChain mul_chain;
+      mul_chain.addOperator(&mul);
+      DAT::updateOperatorTreeRelationship({&mat_i, &mat_w, &mat_o});
+      mul_chain.updateTree();
+      dim_n.setBlockSize(&mul, 64);
+      dim_l.setBlockSize(&mul, 32);
+      dim_q.setBlockSize(&mul, 16);
+      DAT::OrderInfo o_info(&m);
+      o_info.dims_order = {&dim_l, &dim_n, &dim_q};
+      mul_chain.setOrder({{&m, o_info}});
+      if (mat_i.getMemFootprint()[&mul] != 2048 * buffer_num || mat_w.getMemFootprint()[&mul] != 512 * buffer_num
+          || mat_o.getMemFootprint()[&mul] != 1024) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+      footprints.push_back(mul_chain.getMemFootprint());
+      if (checkBatchEval(mul_chain, 253)) {
+        return 1;
+      }
+    }
+    if (footprints[0] != 3584 || footprints[1] != 6144) {
+      std::cout << footprints[0] << " " << footprints[1] << std::endl;
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+
+  // two pipelined operator groups: C = A * B with k innermost, and E = C * D with p innermost, which
+  // does not expand the reduce dim m in the fused C. Tiles: A 16 * 32, B 32 * 32, C 16 * 32,
+  // D 32 * 16 and E 16 * 16 bytes. Traffic: A and D are loaded once and B 4 times over n, E is
+  // stored once, so 6144 bytes for the first group and 3072 for the second. Compute: 72 cycles each.
+  DAT::options().buffer_num = 1;
+  {
+    DAT::Dim dim_n("n"), dim_k("k"), dim_m("m"), dim_p("p");
+    dim_n.setSize(64);
+    dim_k.setSize(32);
+    dim_m.setSize(32);
+    dim_p.setSize(16);
+    DAT::Tensor2D mat_a("A", &dim_n, &dim_k), mat_b("B", &dim_k, &dim_m), mat_c("C", &dim_n, &dim_m);
+    DAT::Tensor2D mat_d("D", &dim_m, &dim_p), mat_e("E", &dim_n, &dim_p);
+    DAT::MatrixMul mul_c("mul_c", &mat_a, &mat_b, &mat_c), mul_e("mul_e", &mat_c, &mat_d, &mat_e);
+    DAT::OperatorNode m_c(&mul_c), m_e(&mul_e);
+    mat_c.setFuse();
+    for (auto pipeline : {false, true}) {
+      DAT::options().pipeline = pipeline;
+      DAT::OperatorChain mul_chain;
+      mul_chain.addOperator(&mul_c, &mul_e);
+      DAT::updateOperatorTreeRelationship({&mat_a, &mat_b, &mat_c, &mat_d, &mat_e});
+      mul_chain.updateTree();
+      mul_chain.addInternalTensor(&mat_c);
+      for (auto op : {&mul_c, &mul_e}) {
+        dim_n.setBlockSize(op, 16);
+        dim_m.setBlockSize(op, 32);
+      }
+      dim_k.setBlockSize(&mul_c, 32);
+      dim_p.setBlockSize(&mul_e, 16);
+      DAT::OrderInfo o_info_c(&m_c), o_info_e(&m_e);
+      o_info_c.dims_order = {&dim_k, &dim_n, &dim_m};
+      o_info_c.execute_rank = 1;
+      o_info_e.dims_order = {&dim_p, &dim_m, &dim_n};
+      o_info_e.execute_rank = 0;
+      mul_chain.setOrder({{&m_c, o_info_c}, {&m_e, o_info_e}});
+      // one group at a time, max(512 + 1024 + 512, 512 + 512 + 256), and max(72, 6144 / 64)
+      // + max(72, 3072 / 64). Pipelined, the union with two buffers of C, and
+      // max(72 + 72, (6144 + 3072) / 64).
+      long footprint = pipeline ? 512 + 1024 + 2 * 512 + 512 + 256 : 2048;
+      long latency = pipeline ? 144 : 96 + 72;
+      if (mul_chain.getOperatorGroups().size() != 2 || mul_chain.getMemAccessVolume() != 9216
+          || mul_chain.getMemFootprint() != footprint || mul_chain.latency() != latency) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+      if (checkBatchEval(mul_chain, 253)) {
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
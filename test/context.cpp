@@ -0,0 +1,51 @@
+#include <thread>
+#include "operator-chain.h"
+
+// Two threads with different contexts see their own options in the cost model.
+int main() {
+  DAT::Dim dim_n("n"), dim_l("l"), dim_q("q");
+  dim_n.setSize(512);
+  dim_l.setSize(512);
+  dim_q.setSize(64);
+  DAT::Tensor2D mat_i("I", &dim_n, &dim_l), mat_wq("Wq", &dim_l, &dim_q), mat_q("Q", &dim_n, &dim_q);
+  DAT::MatrixMul mul_q(&mat_i, &mat_wq, &mat_q);
+  dim_n.setBlockSize(&mul_q, 64);
+  dim_l.setBlockSize(&mul_q, 64);
+  dim_q.setBlockSize(&mul_q, 64);
+
+  DAT::Options options_a, options_b;
+  options_a.compute_power = 1024;
+  options_b.compute_power = 4096;
+  DAT::Context context_a(options_a, 1), context_b(options_b, 1);
+  long compute_time_a = 0, compute_time_b = 0;
+  std::thread thread_a([&]() {
+    DAT::ContextScope scope(context_a);
+    compute_time_a = mul_q.compute_time();
+  });
+  std::thread thread_b([&]() {
+    DAT::ContextScope scope(context_b);
+    compute_time_b = mul_q.compute_time();
+  });
+  thread_a.join();
+  thread_b.join();
+  if (compute_time_a != 4 * compute_time_b) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    std::cout << compute_time_a << " " << compute_time_b << std::endl;
+    return 1;
+  }
+
+  // the same seed gives the same random numbers, and the scope restores the previous context
+  DAT::options().compute_power = 2048;
+  {
+    DAT::ContextScope scope(context_a);
+    if (DAT::options().compute_power != 1024 || DAT::rng()() != context_b.rng()) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+  if (DAT::options().compute_power != 2048) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  return 0;
+}
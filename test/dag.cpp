@@ -0,0 +1,148 @@
+#include "test-utils.h"
+
+int main() {
+  // a layer norm output consumed by an FFN and by the residual add after it
+  {
+    DAT::Dim dim_n("n"), dim_e("e"), dim_f("f");
+    dim_n.setSize(64);
+    dim_e.setSize(16);
+    dim_f.setSize(64);
+    DAT::Tensor2D mat_x("X", &dim_n, &dim_e), mat_n("N", &dim_n, &dim_e), mat_w1("W1", &dim_e, &dim_f);
+    DAT::Tensor2D mat_h("H", &dim_n, &dim_f), mat_w2("W2", &dim_f, &dim_e), mat_y("Y", &dim_n, &dim_e);
+    DAT::Tensor2D mat_z("Z", &dim_n, &dim_e);
+    DAT::LayerNorm norm("norm", &mat_x, &mat_n, &dim_e);
+    DAT::MatrixMul mul_up("mul_up", &mat_n, &mat_w1, &mat_h), mul_down("mul_down", &mat_h, &mat_w2, &mat_y);
+    DAT::ElementWise residual("residual", "add", {&mat_y, &mat_n}, &mat_z);
+    DAT::OperatorNode m_norm(&norm), m_up(&mul_up), m_down(&mul_down), m_residual(&residual);
+    std::set<DAT::Tensor *> tensors = {&mat_x, &mat_n, &mat_w1, &mat_h, &mat_w2, &mat_y, &mat_z};
+
+    // fused everywhere, the DAG has a single sink
+    for (auto t : {&mat_n, &mat_h, &mat_y}) {
+      t->setFuse();
+    }
+    {
+      DAT::OperatorChain mul_chain;
+      mul_chain.addOperator(&norm, &mul_up, &mul_down, &residual);
+      DAT::updateOperatorTreeRelationship(tensors);
+      mul_chain.updateTree();
+      for (auto t : {&mat_n, &mat_h, &mat_y}) {
+        mul_chain.addInternalTensor(t);
+      }
+      for (auto t : {&mat_x, &mat_w1, &mat_w2, &mat_z}) {
+        mul_chain.addExternalTensor(t);
+      }
+      DAT::OperatorTree tree = mul_chain.getOperatorTree();
+      if (m_norm.getConsumers().size() != 2 || tree.getRoots().size() != 1 || tree.getNodes().size() != 4) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+
+      // N stays in SRAM until the residual add, while the down projection runs
+      std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos;
+      int rank = 0;
+      for (auto node : {&m_residual, &m_down, &m_up, &m_norm}) {
+        DAT::OrderInfo o_info(node);
+        auto dims = node->getOperator()->getDims();
+        o_info.dims_order.assign(dims.begin(), dims.end());
+        o_info.execute_rank = rank++;
+        o_infos[node] = o_info;
+      }
+      mul_chain.setOrder(o_infos);
+      if (!mul_down.getEnvTensors().count(&mat_n) || mul_up.getEnvTensors().count(&mat_n)
+          || mat_n.getAccessTimes()[&mul_up] != 0 || mat_n.getAccessTimes()[&residual] != 0) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+      if (checkRandomOrders(mul_chain, 200)) {
+        return 1;
+      }
+    }
+
+    // only N fused: the up projection and the residual add are two sinks
+    mat_h.unsetFuse();
+    mat_y.unsetFuse();
+    {
+      DAT::OperatorChain mul_chain;
+      mul_chain.addOperator(&norm, &mul_up, &residual);
+      DAT::updateOperatorTreeRelationship(tensors);
+      mul_chain.updateTree();
+      mul_chain.addInternalTensor(&mat_n);
+      for (auto t : {&mat_x, &mat_w1, &mat_h, &mat_y, &mat_z}) {
+        mul_chain.addExternalTensor(t);
+      }
+      DAT::OperatorTree tree = mul_chain.getOperatorTree();
+      if (tree.getRoots().size() != 2 || tree.getNodes().size() != 3) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+      DAT::options().buffer_num = 2;
+      if (checkRandomOrders(mul_chain, 200)) {
+        return 1;
+      }
+      DAT::options() = DAT::Options();
+    }
+  }
+
+  // the K and V projections reading one input, loaded once by a chain of both
+  {
+    DAT::Dim dim_n("n"), dim_q("q"), dim_m("m"), dim_k("k"), dim_d("d");
+    dim_n.setSize(64);
+    dim_q.setSize(16);
+    dim_m.setSize(64);
+    dim_k.setSize(32);
+    dim_d.setSize(16);
+    DAT::Tensor2D mat_i("I", &dim_m, &dim_k), mat_wk("Wk", &dim_k, &dim_q), mat_wv("Wv", &dim_k, &dim_d);
+    DAT::Tensor2D mat_q("Q", &dim_n, &dim_q), mat_k("K", &dim_m, &dim_q), mat_v("V", &dim_m, &dim_d);
+    DAT::Tensor2D mat_s("S", &dim_n, &dim_m), mat_a("A", &dim_n, &dim_d);
+    DAT::MatrixMul mul_k("mul_k", &mat_i, &mat_wk, &mat_k), mul_v("mul_v", &mat_i, &mat_wv, &mat_v);
+    DAT::MatrixMul mul_s("mul_s", &mat_q, &mat_k, &mat_s), mul_a("mul_a", &mat_s, &mat_v, &mat_a);
+    DAT::OperatorNode m_k(&mul_k), m_v(&mul_v), m_s(&mul_s), m_a(&mul_a);
+    for (auto t : {&mat_k, &mat_v, &mat_s, &mat_i}) {
+      t->setFuse();
+    }
+    DAT::OperatorChain mul_chain;
+    mul_chain.addOperator(&mul_k, &mul_v, &mul_s, &mul_a);
+    DAT::updateOperatorTreeRelationship({&mat_i, &mat_wk, &mat_wv, &mat_q, &mat_k, &mat_v, &mat_s, &mat_a});
+    mul_chain.updateTree();
+    for (auto t : {&mat_k, &mat_v, &mat_s}) {
+      mul_chain.addInternalTensor(t);
+    }
+    for (auto t : {&mat_i, &mat_wk, &mat_wv, &mat_q, &mat_a}) {
+      mul_chain.addExternalTensor(t);
+    }
+    mul_chain.setDimsOrder({&dim_k, &dim_q, &dim_d, &dim_m, &dim_n});
+    long i_access = 0;
+    for (auto op : {&mul_k, &mul_v}) {
+      i_access += mat_i.getAccessVolume(op)[op];
+    }
+    if (i_access != mat_i.getSize() * mat_i.getElementBytes()) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      std::cout << "access volume of I: " << i_access << std::endl;
+      return 1;
+    }
+    if (checkRandomOrders(mul_chain, 200)) {
+      return 1;
+    }
+
+    // the projection running first loads I, whatever the addresses of the operators
+    for (auto first : {&m_k, &m_v}) {
+      auto o_infos = mul_chain.getOperatorTree().getOrderInfos();
+      o_infos[&m_a].execute_rank = 0;
+      o_infos[&m_s].execute_rank = 1;
+      o_infos[&m_k].execute_rank = first == &m_k ? 3 : 2;
+      o_infos[&m_v].execute_rank = first == &m_v ? 3 : 2;
+      mul_chain.setOrder(o_infos);
+      DAT::TensorOperator *other = first == &m_k ? &mul_v : &mul_k;
+      if (mat_i.isLoadedElsewhere(first->getOperator()) || !mat_i.isLoadedElsewhere(other)) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+      auto costs = mul_chain.evaluateOrders({mul_chain.getOperatorTree()});
+      if (costs[0].access_volume != mul_chain.getMemAccessVolume()) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include <random>
+#include <algorithm>
+#include "workload.h"
+#include "test-utils.h"
+
+int main() {
+  DAT::options().workload = "transformer_block";
+  DAT::options().softmax = true;
+  DAT::options().seq_length = 64;
+  DAT::options().hid_size = 16;
+  DAT::options().head_num = 4;
+  DAT::options().batch_size = 2;
+  DAT::options().batch_blocksize = 1;
+  DAT::options().head_blocksize = 1;
+  DAT::options().kv_cache_length = 256;
+  DAT::options().decode_tokens = 2;
+  DAT::options().enable_compute_utilization_constraint = true;
+  if (DAT::workloadTokenNum() != 4) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // the new tokens attend to the cached keys and values, and their own K and V are stored
+  return DAT::withWorkloadGraph([](const std::set<DAT::TensorOperator *> &operators,
+                                   const std::set<DAT::Tensor *> &tensors) {
+    DAT::Tensor *mat_q = findTensor(tensors, "Q");
+    DAT::Tensor *mat_k = findTensor(tensors, "K");
+    DAT::Tensor *mat_kc = findTensor(tensors, "Kc");
+    if (mat_q->getDim("n")->getSize() != 2 || mat_k->getDim("n")->getSize() != 2
+        || mat_kc->getDim("m")->getSize() != 256 || !mat_k->isIO() || !mat_kc->isIO()
+        || mat_kc->getRelatedOperator().begin()->first->getName() != "mul_s") {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+
+    // no fused tensor, then the whole block fused: every chain agrees with the batch evaluator and
+    // the simulator, and the skinny token dim may not be split into blocks of 16
+    std::vector<DAT::Tensor *> non_io_tensors;
+    for (auto t : tensors) {
+      if (!t->isIO()) {
+        non_io_tensors.push_back(t);
+      }
+    }
+    std::default_random_engine rng{2024};
+    for (bool fused : {false, true}) {
+      for (auto t : non_io_tensors) {
+        fused ? t->setFuse() : t->unsetFuse();
+      }
+      std::vector<DAT::OperatorChain *> op_chain(operators.size(), nullptr);
+      long operator_chain_num = DAT::createToOperatorChain(op_chain.data(), operators, tensors);
+      for (long i = 0; i < operator_chain_num; ++i) {
+        DAT::OperatorChain *mul_chain = op_chain[i];
+        mul_chain->setTensorsIsExternal();
+        std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos;
+        int rank = 0;
+        for (auto node : DAT::OperatorTree::breadthFirstSort(mul_chain->getOperatorTree().getRoot())) {
+          DAT::OrderInfo o_info(node);
+          auto dims = node->getOperator()->getDims();
+          o_info.dims_order.assign(dims.begin(), dims.end());
+          std::shuffle(o_info.dims_order.begin(), o_info.dims_order.end(), rng);
+          o_info.execute_rank = rank++;
+          o_infos[node] = o_info;
+        }
+        for (auto op : mul_chain->getOperators()) {
+          for (auto d : op->getDims()) {
+            if (d->getName() != "bsc" && d->getName() != "hsc") {
+              const auto &factors = d->getFactors();
+              d->setBlockSize(op, factors[std::uniform_int_distribution<size_t>(0, factors.size() - 1)(rng)]);
+            }
+          }
+        }
+        mul_chain->setOrder(o_infos);
+        auto costs = mul_chain->evaluateOrders({mul_chain->getOperatorTree()});
+        DAT::SimulationResult simulated = DAT::simulateChain(mul_chain);
+        if (costs[0].access_volume != mul_chain->getMemAccessVolume()
+            || costs[0].mem_footprint != mul_chain->getMemFootprint()
+            || simulated.access_volume != mul_chain->getMemAccessVolume()
+            || simulated.mem_footprint > mul_chain->getMemFootprint()) {
+          std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+          std::cout << mul_chain->toString();
+          return 1;
+        }
+        DAT::BlockSizeModel bs_model = DAT::buildBlockSizeModel(mul_chain);
+        for (auto op : mul_chain->getOperators()) {
+          auto it = bs_model.min_block_sizes.find(op->getName() + "_n_bs");
+          if (it != bs_model.min_block_sizes.end() && it->second != 2) {
+            std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+            return 1;
+          }
+        }
+      }
+      for (long i = 0; i < operator_chain_num; ++i) {
+        delete op_chain[i];
+      }
+    }
+    return 0;
+  });
+}
@@ -2,14 +2,36 @@
 // Created by lxu on 23-6-24.
 //
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include "operator-chain.h"
 #include "to-gurobi.h"
 #include "dse.h"
+#include "graph-file.h"
+
+// Optimize the block sizes of the chains a fusion search returned, with their fuse patterns and
+// orders, and delete them. Returns their total access volume.
+long totalAccessVolume(DAT::OperatorChain **op_chain, long operator_chain_num, long mem_size) {
+  for (long i = 0; i < operator_chain_num; ++i) {
+    op_chain[i]->setTensorsIsExternal();
+  }
+  long total_access_volume = 0;
+  for (long i = 0; i < operator_chain_num; ++i) {
+    DAT::OperatorChain *mul_chain = op_chain[i];
+    mul_chain->setInternalTensorsFuse();
+    mul_chain->setExternalTensorsFusePattern(mul_chain->getExternalTensorsFusePattern());
+    mul_chain->setOrder(mul_chain->getOperatorTree().getOrderInfos());
+    DAT::optimizeBlockSize(mul_chain, mem_size);
+    mul_chain->setOrder(mul_chain->getOperatorTree().getOrderInfos());
+    total_access_volume += mul_chain->getMemAccessVolume();
+    delete mul_chain;
+  }
+  return total_access_volume;
+}
 
 int main(int argc, char *argv[]) {
 
-  DAT::Options::parse(argc, argv);
+  DAT::options().parse(argc, argv);
 
   DAT::Dim dim_n("n"), dim_l("l"), dim_q("q"), dim_m("m"), dim_k("k"), dim_p("p"), dim_d("d");
   dim_n.setSize(512);
@@ -51,31 +73,148 @@ int main(int argc, char *argv[]) {
        &mat_a};
 
   long mem_size = 1024 * 64;
-  DAT::OperatorChain *op_chain[16] = {nullptr};
-  long operator_chain_num = DAT::traversalFused(non_add_to_operator_chain, tensors, mem_size, op_chain);
-  for (long i = 0; i < operator_chain_num; ++i) {
-    op_chain[i]->setTensorsIsExternal();
+  std::vector<DAT::OperatorChain *> op_chain(non_add_to_operator_chain.size(), nullptr);
+  long operator_chain_num = DAT::traversalFused(non_add_to_operator_chain, tensors, mem_size, op_chain.data());
+  long total_access_volume = totalAccessVolume(op_chain.data(), operator_chain_num, mem_size);
+
+  if (total_access_volume != 917504) {
+    std::cout << total_access_volume << std::endl;
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
   }
 
-  long total_access_volume = 0;
-  for (long i = 0; i < operator_chain_num; ++i) {
-    DAT::OperatorChain *mul_chain = op_chain[i];
-    mul_chain->setInternalTensorsFuse();
-    mul_chain->setExternalTensorsFusePattern(mul_chain->getExternalTensorsFusePattern());
-    mul_chain->setOrder(mul_chain->getOperatorTree().getOrderInfos());
-    DAT::optimizeBlockSize(mul_chain, mem_size);
-    mul_chain->setOrder(mul_chain->getOperatorTree().getOrderInfos());
-    total_access_volume += mul_chain->getMemAccessVolume();
+  // the same result when pruned by the exploration at a larger mem_size
+  DAT::FuseBounds bounds;
+  for (long m : {mem_size * 4, mem_size}) {
+    operator_chain_num = DAT::traversalFused(non_add_to_operator_chain, tensors, m, op_chain.data(), false, &bounds);
+    total_access_volume = totalAccessVolume(op_chain.data(), operator_chain_num, m);
+  }
+  if (total_access_volume != 917504 || bounds.skipped_pattern_num == 0) {
+    std::cout << total_access_volume << std::endl;
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // a sampled dims order proves nothing about a smaller mem_size, so the bounds are not used and
+  // the result is the one of the exploration without them
+  DAT::options().set("dim_order_opt", "random");
+  DAT::FuseBounds random_bounds;
+  std::vector<long> random_access_volumes;
+  for (DAT::FuseBounds *b : {&random_bounds, &random_bounds, (DAT::FuseBounds *) nullptr}) {
+    long m = random_access_volumes.empty() ? mem_size * 4 : mem_size;
+    operator_chain_num = DAT::traversalFused(non_add_to_operator_chain, tensors, m, op_chain.data(), false, b);
+    total_access_volume = totalAccessVolume(op_chain.data(), operator_chain_num, m);
+    random_access_volumes.push_back(total_access_volume);
+  }
+  DAT::options().set("dim_order_opt", "");
+  if (random_access_volumes[1] != random_access_volumes[2] || random_bounds.skipped_pattern_num != 0
+      || !random_bounds.pattern_costs.empty()) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
   }
 
+  // the greedy fusion search finds a schedule, no better than the traversal of all fuse patterns
+  operator_chain_num = DAT::greedyFused(non_add_to_operator_chain, tensors, mem_size, op_chain.data());
+  total_access_volume = totalAccessVolume(op_chain.data(), operator_chain_num, mem_size);
+  if (operator_chain_num == 0 || total_access_volume < 917504) {
+    std::cout << total_access_volume << std::endl;
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // the dynamic programming over the operator tree finds the best schedule of the traversal
+  operator_chain_num = DAT::dpFused(non_add_to_operator_chain, tensors, mem_size, op_chain.data());
+  total_access_volume = totalAccessVolume(op_chain.data(), operator_chain_num, mem_size);
   if (total_access_volume != 917504) {
     std::cout << total_access_volume << std::endl;
     std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
     return 1;
   }
 
-  for(long i = 0; i < operator_chain_num; ++i) {
-    delete op_chain[i];
+  // a tensor read by two operators makes a DAG, which dpFused searches like greedyFused
+  {
+    DAT::Dim dim_x("x"), dim_y("y"), dim_z("z"), dim_w("w");
+    dim_x.setSize(256);
+    dim_y.setSize(256);
+    dim_z.setSize(256);
+    dim_w.setSize(256);
+    DAT::Tensor2D mat_x("X", &dim_x, &dim_y), mat_w1("W1", &dim_y, &dim_z), mat_h("H", &dim_x, &dim_z);
+    DAT::Tensor2D mat_w2("W2", &dim_z, &dim_w), mat_y1("Y1", &dim_x, &dim_w);
+    DAT::Tensor2D mat_w3("W3", &dim_z, &dim_w), mat_y2("Y2", &dim_x, &dim_w);
+    DAT::MatrixMul mul_h("mul_h", &mat_x, &mat_w1, &mat_h), mul_y1("mul_y1", &mat_h, &mat_w2, &mat_y1);
+    DAT::MatrixMul mul_y2("mul_y2", &mat_h, &mat_w3, &mat_y2);
+    DAT::OperatorNode m_h(&mul_h), m_y1(&mul_y1), m_y2(&mul_y2);
+    std::set<DAT::TensorOperator *> dag_operators = {&mul_h, &mul_y1, &mul_y2};
+    std::set<DAT::Tensor *> dag_tensors = {&mat_x, &mat_w1, &mat_h, &mat_w2, &mat_y1, &mat_w3, &mat_y2};
+    if (DAT::isOperatorTree(dag_tensors)) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+    std::vector<long> dag_access_volumes;
+    for (auto search : {DAT::dpFused, DAT::greedyFused}) {
+      std::vector<DAT::OperatorChain *> dag_chain(dag_operators.size(), nullptr);
+      operator_chain_num = search(dag_operators, dag_tensors, mem_size, dag_chain.data(), false);
+      total_access_volume = totalAccessVolume(dag_chain.data(), operator_chain_num, mem_size);
+      dag_access_volumes.push_back(operator_chain_num == 0 ? -1 : total_access_volume);
+    }
+    if (dag_access_volumes[0] < 0 || dag_access_volumes[0] != dag_access_volumes[1]) {
+      std::cout << dag_access_volumes[0] << " " << dag_access_volumes[1] << std::endl;
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+
+  // a path of 18 adds has 17 non-IO tensors, more than auto traverses, and chains with more than
+  // max_traversal_tensors external tensors, whose sub fuse patterns are chosen greedily
+  {
+    std::ostringstream os;
+    os << "dim n 1024\ntensor X0 n\n";
+    for (int i = 0; i < 18; ++i) {
+      os << "tensor B" << i << " n\ntensor X" << i + 1 << " n\nelementwise a" << i << " X" << i << " B" << i
+         << " -> X" << i + 1 << "\n";
+    }
+    std::istringstream is(os.str());
+    DAT::GraphFile graph(is);
+    std::set<DAT::TensorOperator *> path_operators = graph.getOperators();
+    std::set<DAT::Tensor *> path_tensors = graph.getTensors();
+    if (DAT::fuseSearch(path_tensors) != "dp") {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+    std::vector<long> path_access_volumes;
+    for (auto search : {DAT::dpFused, DAT::greedyFused}) {
+      std::vector<DAT::OperatorChain *> path_chain(path_operators.size(), nullptr);
+      operator_chain_num = search(path_operators, path_tensors, mem_size, path_chain.data(), false);
+      total_access_volume = totalAccessVolume(path_chain.data(), operator_chain_num, mem_size);
+      path_access_volumes.push_back(operator_chain_num == 0 ? -1 : total_access_volume);
+    }
+    // the chains of dpFused are optimized as those of greedyFused, and their split is the best
+    if (path_access_volumes[0] < 0 || path_access_volumes[0] > path_access_volumes[1]) {
+      std::cout << path_access_volumes[0] << " " << path_access_volumes[1] << std::endl;
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+
+  // the hill climbing reaches the optimum of a cost without interactions between the bits
+  long best_cost;
+  DAT::FusePattern best_pattern = DAT::greedyFusePattern(
+      DAT::FusePattern(70), [](const DAT::FusePattern &f) {
+        long cost = 1000;
+        for (size_t b = 0; b < f.size(); ++b) {
+          cost += f[b] ? (b % 3 ? -1 : 2) : 0;
+        }
+        return cost;
+      }, best_cost);
+  for (size_t b = 0; b < best_pattern.size(); ++b) {
+    if (best_pattern[b] != (b % 3 != 0)) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+  if (best_cost != 1000 - 46) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
   }
 
   return 0;
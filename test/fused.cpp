@@ -49,7 +49,7 @@ int main(int argc, char *argv[]) {
   mat_k.setFuse();
   mat_s.setFuse();
   mat_v.setFuse();
-  DAT::OperatorChain *op_chain[MAX_TENSOR_NUM] = {nullptr};
+  DAT::OperatorChain *op_chain[5] = {nullptr};
   long operator_chain_num =
       DAT::createToOperatorChain(op_chain, {&mul_q, &mul_k, &mul_s, &mul_v, &mul_a},
                                  {&mat_q, &mat_s, &mat_i1, &mat_i2, &mat_i3, &mat_k, &mat_v,
@@ -0,0 +1,194 @@
+#include <random>
+#include <algorithm>
+#include "workload.h"
+#include "test-utils.h"
+
+int main() {
+  // a kv_head_num not dividing head_num is rejected when the options are parsed, when a sweep sets
+  // them and when the graph is built
+  {
+    DAT::Options o;
+    char arg0[] = "DAT", arg1[] = "--head_num", arg2[] = "4", arg3[] = "--kv_head_num", arg4[] = "3";
+    char *argv[] = {arg0, arg1, arg2, arg3, arg4};
+    bool rejected = false;
+    try {
+      o.parse(5, argv);
+    } catch (const std::invalid_argument &) {
+      rejected = true;
+    }
+    if (!rejected) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+    DAT::Context context;
+    context.options.set("head_num", "4");
+    context.options.set("kv_head_num", "2");
+    context.options.check();
+    context.options.set("kv_head_num", "3");
+    rejected = false;
+    try {
+      context.options.check();
+    } catch (const std::invalid_argument &) {
+      rejected = true;
+    }
+    DAT::ContextScope scope(context);
+    try {
+      DAT::withWorkloadGraph([](const std::set<DAT::TensorOperator *> &, const std::set<DAT::Tensor *> &) {
+        return 0;
+      });
+      rejected = false;
+    } catch (const std::invalid_argument &) {
+    }
+    if (!rejected) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+
+  DAT::options().softmax = true;
+  DAT::options().seq_length = 64;
+  DAT::options().hid_size = 16;
+  DAT::options().head_num = 4;
+  DAT::options().kv_head_num = 2;
+  DAT::options().batch_size = 2;
+  DAT::options().batch_blocksize = 1;
+  DAT::options().head_blocksize = 1;
+
+  // the query side has the K/V heads and the heads of each group, K and V only the K/V heads,
+  // and K is loaded once for all query heads of a group when the group loop is inside it
+  DAT::options().workload = "attention";
+  int ret = DAT::withWorkloadGraph([](const std::set<DAT::TensorOperator *> &operators,
+                                      const std::set<DAT::Tensor *> &tensors) {
+    DAT::Tensor *mat_q = findTensor(tensors, "Q");
+    DAT::Tensor *mat_k = findTensor(tensors, "K");
+    if (!mat_q->hasDim("gsc") || mat_q->getDim("gsc")->getSize() != 2 || mat_q->getDim("hsc")->getSize() != 2
+        || mat_k->hasDim("gsc") || findTensor(tensors, "V")->hasDim("gsc")) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+    for (auto t : tensors) {
+      t->unsetFuse();
+    }
+    std::vector<DAT::OperatorChain *> op_chain(operators.size(), nullptr);
+    long operator_chain_num = DAT::createToOperatorChain(op_chain.data(), operators, tensors);
+    long k_access[2] = {0, 0};
+    for (long i = 0; i < operator_chain_num; ++i) {
+      DAT::OperatorChain *mul_chain = op_chain[i];
+      DAT::TensorOperator *op = *mul_chain->getOperators().begin();
+      if (op->getName() == "mul_s") {
+        DAT::Dim *dim_gs = op->getDim("gsc");
+        for (auto d : op->getDims()) {
+          if (d->getName() != "bsc" && d->getName() != "hsc" && d != dim_gs) {
+            d->setBlockSize(op, d->getSize());
+          }
+        }
+        for (int outer = 0; outer < 2; ++outer) {
+          std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos;
+          DAT::OperatorNode *node = mul_chain->getOperatorTree().getRoot();
+          DAT::OrderInfo o_info(node);
+          for (auto d : op->getDims()) {
+            if (d != dim_gs) {
+              o_info.dims_order.push_back(d);
+            }
+          }
+          o_info.dims_order.insert(outer ? o_info.dims_order.end() : o_info.dims_order.begin(), dim_gs);
+          o_info.execute_rank = 0;
+          o_infos[node] = o_info;
+          mul_chain->setOrder(o_infos);
+          k_access[outer] = mat_k->getAccessVolume(op)[op];
+        }
+      }
+    }
+    for (long i = 0; i < operator_chain_num; ++i) {
+      delete op_chain[i];
+    }
+    if (k_access[0] != mat_k->getSize() * mat_k->getElementBytes() || k_access[1] != 2 * k_access[0]) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      std::cout << "access volume of K: " << k_access[0] << " " << k_access[1] << std::endl;
+      return 1;
+    }
+    return 0;
+  });
+  if (ret) {
+    return ret;
+  }
+
+  // random fuse patterns of a multi-query transformer block: every chain agrees with the batch
+  // evaluator and the simulator, and its block size model stays quadratic
+  DAT::options().workload = "transformer_block";
+  DAT::options().kv_head_num = 1;
+  DAT::options().enable_compute_utilization_constraint = true;
+  return DAT::withWorkloadGraph([](const std::set<DAT::TensorOperator *> &operators,
+                                   const std::set<DAT::Tensor *> &tensors) {
+    if (findTensor(tensors, "Wo")->getDims().size() != 4) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+    std::vector<DAT::Tensor *> non_io_tensors;
+    for (auto t : tensors) {
+      if (!t->isIO()) {
+        non_io_tensors.push_back(t);
+      }
+    }
+    std::default_random_engine rng{2024};
+    for (int p = 0; p < 20; ++p) {
+      long pattern = p == 0 ? -1 : std::uniform_int_distribution<long>(0, 1L << non_io_tensors.size())(rng);
+      for (size_t i = 0; i < non_io_tensors.size(); ++i) {
+        (pattern >> i & 1) ? non_io_tensors[i]->setFuse() : non_io_tensors[i]->unsetFuse();
+      }
+      std::vector<DAT::OperatorChain *> op_chain(operators.size(), nullptr);
+      long operator_chain_num = DAT::createToOperatorChain(op_chain.data(), operators, tensors);
+      for (long i = 0; i < operator_chain_num; ++i) {
+        DAT::OperatorChain *mul_chain = op_chain[i];
+        mul_chain->setTensorsIsExternal();
+        std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos;
+        int rank = 0;
+        for (auto node : DAT::OperatorTree::breadthFirstSort(mul_chain->getOperatorTree().getRoot())) {
+          DAT::OrderInfo o_info(node);
+          auto dims = node->getOperator()->getDims();
+          o_info.dims_order.assign(dims.begin(), dims.end());
+          std::shuffle(o_info.dims_order.begin(), o_info.dims_order.end(), rng);
+          o_info.execute_rank = rank++;
+          o_infos[node] = o_info;
+        }
+        for (auto op : mul_chain->getOperators()) {
+          for (auto d : op->getDims()) {
+            if (d->getName() != "bsc" && d->getName() != "hsc") {
+              const auto &factors = d->getFactors();
+              d->setBlockSize(op, factors[std::uniform_int_distribution<size_t>(0, factors.size() - 1)(rng)]);
+            }
+          }
+        }
+        mul_chain->setOrder(o_infos);
+        auto costs = mul_chain->evaluateOrders({mul_chain->getOperatorTree()});
+        DAT::SimulationResult simulated = DAT::simulateChain(mul_chain);
+        if (costs[0].access_volume != mul_chain->getMemAccessVolume()
+            || costs[0].mem_footprint != mul_chain->getMemFootprint()
+            || simulated.access_volume != mul_chain->getMemAccessVolume()
+            || simulated.mem_footprint > mul_chain->getMemFootprint()) {
+          std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+          std::cout << mul_chain->toString();
+          return 1;
+        }
+        DAT::BlockSizeModel bs_model = DAT::buildBlockSizeModel(mul_chain);
+        std::vector<std::vector<DAT::MonomialTerm> > polynomials = bs_model.footprint_constraints;
+        polynomials.push_back(bs_model.objective);
+        for (const auto &cuc : bs_model.compute_util_constraints) {
+          polynomials.push_back(cuc);
+        }
+        for (const auto &polynomial : polynomials) {
+          for (const auto &term : polynomial) {
+            if (term.var_names.size() > 2) {
+              std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+              return 1;
+            }
+          }
+        }
+      }
+      for (long i = 0; i < operator_chain_num; ++i) {
+        delete op_chain[i];
+      }
+    }
+    return 0;
+  });
+}
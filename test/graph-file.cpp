@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <sstream>
+#include "workload.h"
+
+// The access volume and the largest footprint of the chains of a graph, with the tensors named in
+// fused fused, every dims order sorted by name, the middle factor of each dim as block size, and
+// the operators of a chain run by depth, then name. The same for two identical graphs.
+std::pair<long, long> evaluateGraph(const std::set<DAT::TensorOperator *> &operators,
+                                    const std::set<DAT::Tensor *> &tensors, const std::set<std::string> &fused) {
+  for (auto t : tensors) {
+    fused.count(t->getName()) ? t->setFuse() : t->unsetFuse();
+  }
+  std::vector<DAT::OperatorChain *> op_chain(operators.size(), nullptr);
+  long operator_chain_num = DAT::createToOperatorChain(op_chain.data(), operators, tensors);
+  std::pair<long, long> cost = {0, 0};
+  for (long i = 0; i < operator_chain_num; ++i) {
+    DAT::OperatorChain *mul_chain = op_chain[i];
+    mul_chain->setTensorsIsExternal();
+    auto depth = [](DAT::OperatorNode *node) {
+      long d = 0;
+      for (; node->getParent(); node = node->getParent()) {
+        ++d;
+      }
+      return d;
+    };
+    std::vector<DAT::OperatorNode *> nodes = DAT::OperatorTree::breadthFirstSort(mul_chain->getOperatorTree().getRoot());
+    std::sort(nodes.begin(), nodes.end(), [&depth](DAT::OperatorNode *a, DAT::OperatorNode *b) {
+      return std::make_pair(depth(a), a->getOperator()->getName()) < std::make_pair(depth(b), b->getOperator()->getName());
+    });
+    std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos;
+    int rank = 0;
+    for (auto node : nodes) {
+      DAT::OrderInfo o_info(node);
+      auto dims = node->getOperator()->getDims();
+      o_info.dims_order.assign(dims.begin(), dims.end());
+      std::sort(o_info.dims_order.begin(), o_info.dims_order.end(),
+                [](DAT::Dim *a, DAT::Dim *b) { return a->getName() < b->getName(); });
+      o_info.execute_rank = rank++;
+      o_infos[node] = o_info;
+    }
+    for (auto op : mul_chain->getOperators()) {
+      for (auto d : op->getDims()) {
+        if (d->getName() != "bsc" && d->getName() != "hsc") {
+          d->setBlockSize(op, d->getFactors()[d->getFactors().size() / 2]);
+        }
+      }
+    }
+    mul_chain->setOrder(o_infos);
+    cost.first += mul_chain->getMemAccessVolume();
+    cost.second = std::max(cost.second, mul_chain->getMemFootprint());
+  }
+  for (long i = 0; i < operator_chain_num; ++i) {
+    delete op_chain[i];
+  }
+  return cost;
+}
+
+int main() {
+  DAT::options().workload = "attention";
+  DAT::options().seq_length = 64;
+  DAT::options().hid_size = 16;
+  DAT::options().head_num = 4;
+  DAT::options().batch_size = 2;
+  DAT::options().batch_blocksize = 1;
+  DAT::options().head_blocksize = 2;
+
+  // the graph file of the attention is the built-in attention, unfused and fused
+  std::vector<std::set<std::string> > patterns = {{}, {"Q", "K", "V", "S"}};
+  std::vector<std::pair<long, long> > builtin_costs;
+  std::vector<std::pair<long, long> > file_costs;
+  for (auto *costs : {&builtin_costs, &file_costs}) {
+    DAT::options().graph_file = costs == &builtin_costs ? "" : std::string(DAT_CONFIG_DIR) + "/attention.graph";
+    int ret = DAT::withWorkloadGraph([&](const std::set<DAT::TensorOperator *> &operators,
+                                         const std::set<DAT::Tensor *> &tensors) {
+      if (operators.size() != 5 || tensors.size() != 11) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+      for (const auto &fused : patterns) {
+        costs->push_back(evaluateGraph(operators, tensors, fused));
+      }
+      return 0;
+    });
+    if (ret) {
+      return ret;
+    }
+  }
+  if (builtin_costs != file_costs || builtin_costs[0].first <= builtin_costs[1].first) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+      std::cout << builtin_costs[i].first << " " << file_costs[i].first << ", " << builtin_costs[i].second << " "
+                << file_costs[i].second << std::endl;
+    }
+    return 1;
+  }
+
+  // malformed graphs are rejected with the line of the error
+  std::vector<std::pair<std::string, std::string> > bad_graphs = {
+      {"dim n 8\ntensor X n m\n", "line 2"},
+      {"dim n seq_length*2\ntensor X n\ntensor Y n\nsoftmax s X -> Y\n", "dim="},
+      {"dim n unknown_option\n", "line 1"},
+      {"dim n 8\ntensor X n\ntensor Y n\ntensor Z n\nelementwise a X -> Y\n", "used by no operator"},
+      {"dim n 8\ntensor X n\ntensor Y n\nelementwise a X -> Y\nelementwise b X -> Y\n", "output of two"},
+      {"dim n 8\ntensor X n\ntensor Y n\nelementwise a X -> Y speed=2\n", "unknown attribute"},
+      {"dim n 8\ntensor X n n\n", "line 2"},
+      {"dim n 8\ntensor X n\ntensor Y n\ntensor Z n\nelementwise a X -> Y\nboundary Y -> Z\n", "line 6"},
+      {"dim n 8\ntensor X n\ntensor Y n\ntensor Z n\nelementwise a X -> Y\nboundary Z -> X\n", "line 6"}};
+  for (const auto &bg : bad_graphs) {
+    std::istringstream is(bg.first);
+    try {
+      DAT::GraphFile graph(is);
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    } catch (const std::invalid_argument &e) {
+      if (std::string(e.what()).find(bg.second) == std::string::npos) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        std::cout << e.what() << std::endl;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,226 @@
+#include <sstream>
+#include "workload.h"
+#include "test-utils.h"
+
+// The access volume of the chains of a graph with only the tensors named in fused fused, random
+// orders, whole dims as blocks or random block sizes, checked against the batch evaluation and the
+// simulator.
+long evaluateFused(const std::set<DAT::TensorOperator *> &operators, const std::set<DAT::Tensor *> &tensors,
+                   const std::set<std::string> &fused, bool whole_blocks) {
+  for (auto t : tensors) {
+    fused.count(t->getName()) ? t->setFuse() : t->unsetFuse();
+  }
+  std::default_random_engine rng{2024};
+  std::vector<DAT::OperatorChain *> op_chain(operators.size(), nullptr);
+  long operator_chain_num = DAT::createToOperatorChain(op_chain.data(), operators, tensors);
+  long access_volume = 0;
+  for (long i = 0; i < operator_chain_num; ++i) {
+    DAT::OperatorChain *mul_chain = op_chain[i];
+    mul_chain->setTensorsIsExternal();
+    std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos = randomOrderInfos(mul_chain->getOperatorTree(), rng);
+    if (whole_blocks) {
+      for (auto op : mul_chain->getOperators()) {
+        for (auto d : op->getDims()) {
+          if (d->getName() != "bsc" && d->getName() != "hsc") {
+            d->setBlockSize(op, d->getSize());
+          }
+        }
+      }
+    } else {
+      setRandomBlockSizes(*mul_chain, rng, false, {"bsc", "hsc"});
+    }
+    if (!sameCosts(*mul_chain, o_infos)) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      std::cout << mul_chain->toString();
+      access_volume = -1;
+      break;
+    }
+    access_volume += mul_chain->getMemAccessVolume();
+  }
+  for (long i = 0; i < operator_chain_num; ++i) {
+    delete op_chain[i];
+  }
+  return access_volume;
+}
+
+int main() {
+  DAT::options().seq_length = 32;
+  DAT::options().hid_size = 8;
+  DAT::options().head_num = 2;
+  DAT::options().batch_size = 2;
+  DAT::options().batch_blocksize = 1;
+  DAT::options().head_blocksize = 1;
+
+  // three layers share the dims, and the output of a layer is the query and residual input of the
+  // next one
+  {
+    DAT::GraphFile graph(std::string(DAT_CONFIG_DIR) + "/transformer-block.graph", 3);
+    std::set<DAT::TensorOperator *> operators = graph.getOperators();
+    std::set<DAT::Tensor *> tensors = graph.getTensors();
+    std::map<std::string, DAT::Tensor *> named_tensors;
+    for (auto t : tensors) {
+      named_tensors[t->getName()] = t;
+    }
+    std::set<std::string> z_1_consumers;
+    for (const auto &ro : named_tensors["Z_1"]->getRelatedOperator()) {
+      if (ro.second == "input") {
+        z_1_consumers.insert(ro.first->getName());
+      }
+    }
+    std::map<DAT::Tensor *, bool> boundary_tensors = graph.getBoundaryTensors();
+    if (operators.size() != 3 * 14 || tensors.size() != 3 * 24 - 2 * 2 || named_tensors.count("I1_2")
+        || z_1_consumers != std::set<std::string>{"mul_q_2", "residual1_2"} || !named_tensors["Z_3"]->isIO()
+        || boundary_tensors.size() != 2 || !boundary_tensors[named_tensors["Z_2"]]
+        || named_tensors["Z_1"]->getDim("e") != named_tensors["I1_1"]->getDim("e")) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+
+    // fusing the boundary chains the last layer norm of a layer with the next layer, and saves
+    // the store and the loads of the boundary tensor
+    if (evaluateFused(operators, tensors, {"Z_1", "Z_2", "N1_2", "R1_2"}, false) < 0) {
+      return 1;
+    }
+    long unfused = evaluateFused(operators, tensors, {}, true);
+    long fused = evaluateFused(operators, tensors, {"Z_1", "Z_2"}, true);
+    DAT::Tensor *mat_z = named_tensors["Z_1"];
+    if (unfused < 0 || fused < 0 || unfused - fused < 2 * 3 * mat_z->getSize() * mat_z->getElementBytes()) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      std::cout << "access volume: " << unfused << " " << fused << std::endl;
+      return 1;
+    }
+
+    // the greedy fusion search schedules the whole graph of the three layers
+    std::vector<DAT::OperatorChain *> op_chain(operators.size(), nullptr);
+    long operator_chain_num = DAT::greedyFused(operators, tensors, 1024 * 64, op_chain.data());
+    for (long i = 0; i < operator_chain_num; ++i) {
+      delete op_chain[i];
+    }
+    if (operator_chain_num == 0) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+
+    // the chain of the query projection and the scores has one order cache key in the second and
+    // the third layer, and the order of one restores on the other
+    std::map<std::string, DAT::TensorOperator *> named_ops;
+    for (auto op : operators) {
+      named_ops[op->getName()] = op;
+    }
+    std::string keys[2];
+    DAT::OrderCache::Entry entry;
+    for (int l = 0; l < 2; ++l) {
+      std::string layer = std::to_string(l + 2);
+      DAT::TensorOperator *mul_q = named_ops["mul_q_" + layer], *mul_s = named_ops["mul_s_" + layer];
+      std::set<DAT::Tensor *> chain_tensors;
+      for (auto op : {mul_q, mul_s}) {
+        for (auto t : op->getTensors()) {
+          t == named_tensors["Q_" + layer] ? t->setFuse() : t->unsetFuse();
+          chain_tensors.insert(t);
+        }
+      }
+      DAT::OperatorChain mul_chain;
+      mul_chain.addOperator(mul_q, mul_s);
+      DAT::updateOperatorTreeRelationship(chain_tensors);
+      mul_chain.updateTree();
+      mul_chain.addInternalTensor(named_tensors["Q_" + layer]);
+      keys[l] = DAT::OrderCache::key(&mul_chain, 65536);
+      if (l == 0) {
+        if (DAT::OrderCache::key(&mul_chain, 65536, false) == keys[l]) {
+          std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+          return 1;
+        }
+        std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos;
+        int rank = 0;
+        for (auto node : mul_chain.getOperatorTree().getNodes()) {
+          DAT::OrderInfo o_info(node);
+          auto dims = node->getOperator()->getDims();
+          o_info.dims_order.assign(dims.rbegin(), dims.rend());
+          o_info.execute_rank = rank++;
+          o_infos[node] = o_info;
+        }
+        mul_chain.setOrder(o_infos);
+        entry = DAT::OrderCache::toEntry(false, 1.0, mul_chain.getOperatorTree());
+      } else {
+        DAT::OperatorTree order_tree = DAT::OrderCache::toOrderTree(&mul_chain, entry);
+        mul_chain.setOrder(order_tree.getOrderInfos());
+        auto dims = mul_s->getDims();
+        if (keys[1] != keys[0]
+            || mul_s->getLinkedNode()->getDimsOrder() != std::vector<DAT::Dim *>(dims.rbegin(), dims.rend())
+            || DAT::OrderCache::toEntry(false, 1.0, order_tree).execute_ranks != entry.execute_ranks) {
+          std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+          return 1;
+        }
+      }
+    }
+  }
+
+  // every layer after the first adds what the second adds to the first
+  {
+    DAT::ExploreResult one, two;
+    one.feasible = two.feasible = true;
+    one.access_volume = 100;
+    two.access_volume = 180;
+    one.compute_time = 10;
+    two.compute_time = 20;
+    one.mem_footprint = 64;
+    two.mem_footprint = 96;
+    one.level_access_volumes = {50};
+    two.level_access_volumes = {90};
+    DAT::ExploreResult layers = DAT::extrapolateLayers(one, two, 32);
+    if (!layers.feasible || layers.access_volume != 100 + 31 * 80 || layers.compute_time != 320
+        || layers.mem_footprint != 96 || layers.level_access_volumes != std::vector<long>{50 + 31 * 40}
+        || layers.boundary_saving != 20) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+
+  // the fuse patterns of 63 non-IO tensors do not fit the bits of a long, so they are not traversed
+  {
+    std::ostringstream os;
+    os << "dim n 8\ntensor X0 n\n";
+    for (int i = 0; i < 64; ++i) {
+      os << "tensor X" << i + 1 << " n\nelementwise a" << i << " X" << i << " -> X" << i + 1 << "\n";
+    }
+    std::istringstream is(os.str());
+    DAT::GraphFile graph(is);
+    std::vector<DAT::OperatorChain *> op_chain(graph.getOperators().size(), nullptr);
+    try {
+      DAT::traversalFused(graph.getOperators(), graph.getTensors(), 1024 * 64, op_chain.data());
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    } catch (const std::invalid_argument &) {
+    }
+  }
+
+  // layers need a boundary whose inputs have the dims of its output
+  std::vector<std::pair<std::string, std::string> > bad_graphs = {
+      {"dim n 8\ntensor X n\ntensor Y n\nelementwise a X -> Y\n", "boundary"},
+      {"dim n 8\ndim e 4\ntensor X n\ntensor W n e\ntensor Y e\nmatmul a X W -> Y\nboundary Y -> X\n", "line 7"},
+      {"dim n 8\ntensor X n\ntensor Y n\nelementwise a X -> Y\nboundary X -> Y\n", "line 5"}};
+  for (const auto &bg : bad_graphs) {
+    std::istringstream is(bg.first);
+    try {
+      DAT::GraphFile graph(is, 2);
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    } catch (const std::invalid_argument &e) {
+      if (std::string(e.what()).find(bg.second) == std::string::npos) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        std::cout << e.what() << std::endl;
+        return 1;
+      }
+    }
+  }
+  DAT::options().layer_num = 2;
+  try {
+    DAT::withWorkloadGraph([](const std::set<DAT::TensorOperator *> &, const std::set<DAT::Tensor *> &) {
+      return 0;
+    });
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  } catch (const std::invalid_argument &) {
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include "mem-hierarchy.h"
+
+int main() {
+  DAT::Dim dim_n("n"), dim_k("k"), dim_m("m");
+  dim_n.setSize(64);
+  dim_k.setSize(64);
+  dim_m.setSize(64);
+  DAT::Tensor2D mat_a("A", &dim_n, &dim_k), mat_b("B", &dim_k, &dim_m), mat_c("C", &dim_n, &dim_m);
+  DAT::MatrixMul mul("mul", &mat_a, &mat_b, &mat_c);
+  dim_n.setBlockSize(&mul, 16);
+  dim_k.setBlockSize(&mul, 16);
+  dim_m.setBlockSize(&mul, 16);
+
+  // a level holding the whole block loads every block once
+  auto levels = DAT::optimizeInnerLevels({&mul}, {3 * 16 * 16});
+  if (levels.size() != 1 || !levels[0].feasible || levels[0].tile_sizes[&mul][&dim_k] != 16
+      || levels[0].access_volume != 64 * (16 * 16 * 3)) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // smaller levels fit their tiles and move more data, and every level tiles the one above
+  levels = DAT::optimizeInnerLevels({&mul}, {3 * 16 * 16, 256, 16, 2});
+  if (levels.size() != 4 || levels[3].feasible) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  for (size_t l = 1; l < 3; ++l) {
+    if (!levels[l].feasible || levels[l].mem_footprint > levels[l].capacity
+        || levels[l].access_volume <= levels[l - 1].access_volume) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+    for (auto d : {&dim_n, &dim_k, &dim_m}) {
+      if (levels[l - 1].tile_sizes[&mul][d] % levels[l].tile_sizes[&mul][d] != 0) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  // the chosen order is the best one for the chosen tile sizes
+  const auto &tiles = levels[1].tile_sizes[&mul];
+  std::vector<DAT::Dim *> order = {&dim_n, &dim_k, &dim_m};
+  std::sort(order.begin(), order.end());
+  do {
+    if (DAT::tileTraffic(&mul, levels[0].tile_sizes[&mul], tiles, order) < levels[1].access_volume) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  } while (std::next_permutation(order.begin(), order.end()));
+
+  if (DAT::parseInnerMemSizes(" 4096, 256 ,") != std::vector<long>{4096, 256}) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  return 0;
+}
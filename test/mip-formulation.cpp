@@ -0,0 +1,90 @@
+//
+// Compare the nonconvex and the log-domain block size MIP on the same chains.
+//
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cfloat>
+#include "operator-chain.h"
+#include "to-gurobi.h"
+#include "dse.h"
+
+int main() {
+
+  DAT::Dim dim_n("n"), dim_l("l"), dim_q("q"), dim_m("m");
+  dim_n.setSize(512);
+  dim_l.setSize(512);
+  dim_q.setSize(64);
+  dim_m.setSize(512);
+  DAT::Tensor2D mat_i("I", &dim_n, &dim_l), mat_wq("Wq", &dim_l, &dim_q);
+  DAT::Tensor2D mat_q("Q", &dim_n, &dim_q), mat_k("K", &dim_m, &dim_q),
+      mat_s("S", &dim_n, &dim_m);
+  DAT::MatrixMul mul_q("mul_q", &mat_i, &mat_wq, &mat_q), mul_s("mul_s", &mat_q, &mat_k, &mat_s);
+  DAT::OperatorNode m_q(&mul_q), m_s(&mul_s);
+  mat_q.setFuse();
+  DAT::OperatorChain mul_chain;
+  mul_chain.addOperator(&mul_q, &mul_s);
+  DAT::updateOperatorTreeRelationship({&mat_q, &mat_s, &mat_i, &mat_k, &mat_wq});
+  mul_chain.addInternalTensor(&mat_q);
+  mul_chain.updateTree();
+
+  std::vector<std::vector<DAT::Dim *> > dims_orders = {
+      {&dim_l, &dim_q, &dim_m, &dim_n},
+      {&dim_q, &dim_l, &dim_m, &dim_n},
+      {&dim_m, &dim_l, &dim_q, &dim_n},
+      {&dim_n, &dim_l, &dim_q, &dim_m}};
+  std::vector<long> mem_sizes = {10240, 65536};
+
+  double nonconvex_time = 0;
+  double log_time = 0;
+  for (const auto &dims_order : dims_orders) {
+    for (auto mem_size : mem_sizes) {
+      mul_chain.setDimsOrder(dims_order);
+      DAT::options().mip_formulation = "nonconvex";
+      auto start = std::chrono::steady_clock::now();
+      double nonconvex_obj = DAT::mipBlockSize(&mul_chain, mem_size);
+      nonconvex_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      mul_chain.setDimsOrder(dims_order);
+      DAT::options().mip_formulation = "log";
+      start = std::chrono::steady_clock::now();
+      double log_obj = DAT::mipBlockSize(&mul_chain, mem_size);
+      log_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      // the piecewise-linear exp may cost a little optimality, but never feasibility
+      if ((nonconvex_obj == FLT_MAX) != (log_obj == FLT_MAX) || log_obj > nonconvex_obj * 1.01) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        std::cout << "nonconvex: " << nonconvex_obj << ", log: " << log_obj << std::endl;
+        return 1;
+      }
+    }
+  }
+  std::cout << "nonconvex solve time: " << nonconvex_time << "s" << std::endl;
+  std::cout << "log solve time: " << log_time << "s" << std::endl;
+
+  // optimizing the latency directly is no worse in latency than optimizing the access volume
+  DAT::options().dram_bandwidth = 4;
+  for (const auto &formulation : {"nonconvex", "log"}) {
+    DAT::options().mip_formulation = formulation;
+    for (const auto &dims_order : dims_orders) {
+      mul_chain.setDimsOrder(dims_order);
+      DAT::options().objective = "access_volume";
+      if (DAT::mipBlockSize(&mul_chain, 65536) == FLT_MAX) {
+        continue;
+      }
+      mul_chain.setDimsOrder(dims_order);
+      long volume_latency = mul_chain.latency();
+      DAT::options().objective = "latency";
+      double latency_obj = DAT::mipBlockSize(&mul_chain, 65536);
+      mul_chain.setDimsOrder(dims_order);
+      if (latency_obj == FLT_MAX || mul_chain.latency() > volume_latency * 1.05) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        std::cout << formulation << " latency: " << mul_chain.latency() << ", access volume objective latency: "
+                  << volume_latency << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
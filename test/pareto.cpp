@@ -0,0 +1,57 @@
+#include <random>
+#include "pareto.h"
+
+int main() {
+  DAT::ParetoArchive archive;
+  if (!archive.insert({10, 10, 10, "a"}) || !archive.insert({5, 20, 10, "b"})
+      || archive.insert({10, 10, 10, "a again"}) || archive.insert({12, 20, 10, "dominated"})
+      || !archive.insert({5, 10, 10, "c"}) || archive.size() != 1
+      || archive.getPoints().front().schedule != "c") {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // the archive is the non-dominated set of all inserted points
+  std::default_random_engine engine(7);
+  std::uniform_int_distribution<long> value(0, 50);
+  std::vector<DAT::ParetoPoint> all;
+  DAT::ParetoArchive random_archive;
+  for (int i = 0; i < 2000; ++i) {
+    DAT::ParetoPoint p{value(engine), value(engine), value(engine), std::to_string(i)};
+    all.push_back(p);
+    random_archive.insert(p);
+  }
+  size_t non_dominated_num = 0;
+  for (size_t i = 0; i < all.size(); ++i) {
+    bool dominated = false;
+    for (size_t j = 0; j < all.size() && !dominated; ++j) {
+      // of equal points only the first is kept
+      dominated = all[j].covers(all[i]) && (!all[i].covers(all[j]) || j < i);
+    }
+    non_dominated_num += !dominated;
+  }
+  for (size_t i = 1; i < random_archive.size(); ++i) {
+    const auto &points = random_archive.getPoints();
+    if (points[i - 1].access_volume > points[i].access_volume) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+  if (random_archive.size() != non_dominated_num) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // chains one after another add up access volumes and compute times, footprints take the max
+  DAT::ParetoArchive first, second;
+  first.insert({10, 100, 5, "x"});
+  first.insert({20, 50, 5, "y"});
+  second.insert({1, 80, 1, "z"});
+  auto sequence = DAT::ParetoArchive::sequence(first, second);
+  if (sequence.size() != 2 || sequence.getPoints()[0].schedule != "x z"
+      || sequence.getPoints()[1].mem_footprint != 80 || sequence.getPoints()[1].compute_time != 6) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include "partition.h"
+
+int main() {
+  DAT::Dim dim_n("n"), dim_l("l"), dim_q("q"), dim_b("bsc");
+  dim_n.setSize(6);
+  dim_l.setSize(64);
+  dim_q.setSize(64);
+  dim_b.setSize(2);
+  DAT::Tensor3D mat_i("I", &dim_n, &dim_l, &dim_b), mat_q("Q", &dim_n, &dim_q, &dim_b);
+  DAT::Tensor2D mat_wq("Wq", &dim_l, &dim_q);
+  DAT::MatrixMul mul_q("mul_q", &mat_i, &mat_wq, &mat_q);
+  dim_b.setBlockSize(&mul_q, 2);
+  dim_n.setBlockSize(&mul_q, 6);
+  dim_q.setBlockSize(&mul_q, 16);
+
+  // the reduced dim is never split
+  auto dims = DAT::partitionDims({&mul_q});
+  if (dims != std::vector<DAT::Dim *>{&dim_b, &dim_n, &dim_q}) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  // bsc can not be split into 4
+  auto partitions = DAT::enumeratePartitions({&dim_b, &dim_n}, 4);
+  if (partitions.size() != 2 || partitions[0].factors[&dim_b] != 1 || partitions[0].factors[&dim_n] != 4
+      || partitions[1].factors[&dim_b] != 2 || partitions[1].factors[&dim_n] != 2
+      || DAT::enumeratePartitions(dims, 4).size() != 5) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // 6 rows over 4 cores take slices of 2, so a quarter of the cores idle
+  const DAT::CorePartition &partition = partitions[0];
+  if (partition.coreSize(&dim_n) != 2 || partition.balance() != 0.75 || partition.toString() != "n=4"
+      || !partition.isReplicated(&mat_wq) || partition.isReplicated(&mat_i)) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  {
+    DAT::PartitionScope scope({&mul_q}, partition);
+    if (dim_n.getSize() != 2 || dim_n.getBlockSize(&mul_q) != 2 || mat_i.getSize() != 2 * 64 * 2) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+  if (dim_n.getSize() != 6 || dim_n.getBlockSize(&mul_q) != 6 || dim_b.getBlockSize(&mul_q) != 2) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // nor is the normalized dim
+  DAT::Tensor3D mat_o("O", &dim_n, &dim_q, &dim_b);
+  DAT::LayerNorm norm("norm", &mat_q, &mat_o, &dim_q);
+  if (DAT::partitionDims({&mul_q, &norm}) != std::vector<DAT::Dim *>{&dim_b, &dim_n}) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include <chrono>
+#include "test-utils.h"
+
+int main() {
+  {
+    DAT::Dim dim_n("n"), dim_l("l"), dim_q("q"), dim_m("m"), dim_k("k"), dim_p("p"), dim_d("d");
+    dim_n.setSize(64);
+    dim_l.setSize(32);
+    dim_k.setSize(32);
+    dim_p.setSize(32);
+    dim_q.setSize(16);
+    dim_d.setSize(16);
+    dim_m.setSize(64);
+    DAT::Tensor2D mat_i1("I1", &dim_n, &dim_l), mat_wq("Wq", &dim_l, &dim_q);
+    DAT::Tensor2D mat_i2("I2", &dim_m, &dim_k), mat_wk("Wk", &dim_k, &dim_q);
+    DAT::Tensor2D mat_q("Q", &dim_n, &dim_q), mat_k("K", &dim_m, &dim_q);
+    DAT::Tensor2D mat_i3("I3", &dim_m, &dim_p), mat_wv("Wv", &dim_p, &dim_d);
+    DAT::Tensor2D mat_s("S", &dim_n, &dim_m), mat_v("V", &dim_m, &dim_d),
+        mat_a("A", &dim_n, &dim_d);
+    DAT::MatrixMul mul_q("mul_q", &mat_i1, &mat_wq, &mat_q),
+        mul_v("mul_v", &mat_i3, &mat_wv, &mat_v);
+    DAT::MatrixMul mul_k("mul_k", &mat_i2, &mat_wk, &mat_k),
+        mul_s("mul_s", &mat_q, &mat_k, &mat_s);
+    DAT::MatrixMul mul_a("mul_a", &mat_s, &mat_v, &mat_a);
+    DAT::OperatorNode m_q(&mul_q), m_v(&mul_v), m_k(&mul_k), m_s(&mul_s), m_a(&mul_a);
+    mat_q.setFuse();
+    mat_k.setFuse();
+    mat_s.setFuse();
+    mat_v.setFuse();
+    mat_i2.setFuse();
+    DAT::OperatorChain mul_chain;
+    mul_chain.addOperator(&mul_q, &mul_k, &mul_v, &mul_s, &mul_a);
+    DAT::updateOperatorTreeRelationship({&mat_q, &mat_s, &mat_i1, &mat_i2, &mat_i3, &mat_k, &mat_v,
+                                         &mat_wk, &mat_wv, &mat_a, &mat_wq});
+    mul_chain.updateTree();
+    for (auto t : {&mat_q, &mat_k, &mat_s, &mat_v}) {
+      mul_chain.addInternalTensor(t);
+    }
+    for (auto t : {&mat_i1, &mat_i2, &mat_i3, &mat_wq, &mat_wk, &mat_wv, &mat_a}) {
+      mul_chain.addExternalTensor(t);
+    }
+    if (checkRandomOrders(mul_chain, 200)) {
+      return 1;
+    }
+
+    // mixed element widths, bias and double buffering
+    mat_wq.setRole(DAT::TensorRole::Weight);
+    mat_s.setRole(DAT::TensorRole::Score);
+    DAT::options().activation_bytes = 2;
+    DAT::options().accumulator_bytes = 4;
+    DAT::options().buffer_num = 2;
+    mul_q.is_with_bias(true);
+    mul_a.is_with_bias(true);
+    if (checkRandomOrders(mul_chain, 200)) {
+      return 1;
+    }
+    DAT::options() = DAT::Options();
+  }
+
+  // a softmax keeping the statistics of its rows, with fused and with unfused probabilities
+  {
+    DAT::Dim dim_n("n"), dim_q("q"), dim_m("m"), dim_d("d");
+    dim_n.setSize(64);
+    dim_q.setSize(16);
+    dim_m.setSize(64);
+    dim_d.setSize(16);
+    DAT::Tensor2D mat_q("Q", &dim_n, &dim_q), mat_k("K", &dim_m, &dim_q), mat_v("V", &dim_m, &dim_d);
+    DAT::Tensor2D mat_s("S", &dim_n, &dim_m), mat_p("P", &dim_n, &dim_m), mat_a("A", &dim_n, &dim_d);
+    DAT::MatrixMul mul_s("mul_s", &mat_q, &mat_k, &mat_s), mul_a("mul_a", &mat_p, &mat_v, &mat_a);
+    DAT::Softmax softmax("softmax", &mat_s, &mat_p, &dim_m);
+    DAT::OperatorNode m_s(&mul_s), m_softmax(&softmax), m_a(&mul_a);
+    mat_s.setFuse();
+    mat_p.setFuse();
+    {
+      DAT::OperatorChain mul_chain;
+      mul_chain.addOperator(&mul_s, &softmax, &mul_a);
+      DAT::updateOperatorTreeRelationship({&mat_q, &mat_k, &mat_v, &mat_s, &mat_p, &mat_a});
+      mul_chain.updateTree();
+      mul_chain.addInternalTensor(&mat_s);
+      mul_chain.addInternalTensor(&mat_p);
+      if (checkRandomOrders(mul_chain, 200)) {
+        return 1;
+      }
+    }
+    mat_p.unsetFuse();
+    DAT::options().accumulator_bytes = 4;
+    DAT::options().buffer_num = 2;
+    {
+      DAT::OperatorChain mul_chain;
+      mul_chain.addOperator(&mul_s, &softmax);
+      DAT::updateOperatorTreeRelationship({&mat_q, &mat_k, &mat_v, &mat_s, &mat_p, &mat_a});
+      mul_chain.updateTree();
+      mul_chain.addInternalTensor(&mat_s);
+      if (checkRandomOrders(mul_chain, 200)) {
+        return 1;
+      }
+    }
+    DAT::options() = DAT::Options();
+  }
+
+  // a feed forward network with an activation and a residual add
+  {
+    DAT::Dim dim_n("n"), dim_d("d"), dim_f("f"), dim_e("e");
+    dim_n.setSize(64);
+    dim_d.setSize(16);
+    dim_f.setSize(64);
+    dim_e.setSize(16);
+    DAT::Tensor2D mat_x("X", &dim_n, &dim_d), mat_w1("W1", &dim_d, &dim_f), mat_h("H", &dim_n, &dim_f);
+    DAT::Tensor2D mat_g("G", &dim_n, &dim_f), mat_w2("W2", &dim_f, &dim_e), mat_y("Y", &dim_n, &dim_e);
+    DAT::Tensor2D mat_r("R", &dim_n, &dim_e), mat_z("Z", &dim_n, &dim_e);
+    DAT::MatrixMul mul_up("mul_up", &mat_x, &mat_w1, &mat_h), mul_down("mul_down", &mat_g, &mat_w2, &mat_y);
+    DAT::ElementWise gelu("gelu", "gelu", {&mat_h}, &mat_g, 8);
+    DAT::ElementWise residual("residual", "add", {&mat_y, &mat_r}, &mat_z);
+    DAT::OperatorNode m_up(&mul_up), m_gelu(&gelu), m_down(&mul_down), m_residual(&residual);
+    mat_h.setFuse();
+    mat_g.setFuse();
+    mat_y.setFuse();
+    DAT::options().buffer_num = 2;
+    DAT::OperatorChain mul_chain;
+    mul_chain.addOperator(&mul_up, &gelu, &mul_down, &residual);
+    DAT::updateOperatorTreeRelationship({&mat_x, &mat_w1, &mat_h, &mat_g, &mat_w2, &mat_y, &mat_r, &mat_z});
+    mul_chain.updateTree();
+    for (auto t : {&mat_h, &mat_g, &mat_y}) {
+      mul_chain.addInternalTensor(t);
+    }
+    if (checkRandomOrders(mul_chain, 200)) {
+      return 1;
+    }
+    DAT::options() = DAT::Options();
+  }
+
+  // a bert-base attention head group in seconds
+  {
+    DAT::Dim dim_n("n"), dim_l("l"), dim_q("q"), dim_m("m");
+    dim_n.setSize(512);
+    dim_l.setSize(768);
+    dim_q.setSize(64);
+    dim_m.setSize(512);
+    DAT::Tensor2D mat_i("I", &dim_n, &dim_l), mat_wq("Wq", &dim_l, &dim_q);
+    DAT::Tensor2D mat_q("Q", &dim_n, &dim_q), mat_k("K", &dim_m, &dim_q), mat_s("S", &dim_n, &dim_m);
+    DAT::MatrixMul mul_q("mul_q", &mat_i, &mat_wq, &mat_q), mul_s("mul_s", &mat_q, &mat_k, &mat_s);
+    DAT::OperatorNode m_q(&mul_q), m_s(&mul_s);
+    mat_q.setFuse();
+    DAT::OperatorChain mul_chain;
+    mul_chain.addOperator(&mul_q, &mul_s);
+    DAT::updateOperatorTreeRelationship({&mat_q, &mat_s, &mat_i, &mat_k, &mat_wq});
+    mul_chain.updateTree();
+    mul_chain.addInternalTensor(&mat_q);
+    for (auto op : {&mul_q, &mul_s}) {
+      for (auto d : op->getDims()) {
+        d->setBlockSize(op, 4);
+      }
+    }
+    mul_chain.setDimsOrder({&dim_n, &dim_q, &dim_m, &dim_l});
+    auto start = std::chrono::steady_clock::now();
+    DAT::SimulationResult simulated = DAT::simulateChain(&mul_chain);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "simulated " << simulated.access_volume << " bytes in " << seconds << "s" << std::endl;
+    if (simulated.access_volume != mul_chain.getMemAccessVolume()
+        || simulated.mem_footprint != mul_chain.getMemFootprint()) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,173 @@
+#include <atomic>
+#include "sweep.h"
+
+int main() {
+  // sweep spec values
+  if (DAT::parseSweepValues("32768:262144:*2")
+      != std::vector<std::string>{"32768", "65536", "131072", "262144"}
+      || DAT::parseSweepValues("256:1024:256") != std::vector<std::string>{"256", "512", "768", "1024"}
+      || DAT::parseSweepValues(" genetic, random ") != std::vector<std::string>{"genetic", "random"}) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  // ranges never growing or missing their step are rejected, and a range up to LONG_MAX stops
+  for (const char *str : {"0:1024:*2", "-4:1024:*2", "1:8: ", "1:8:0"}) {
+    bool thrown = false;
+    try {
+      DAT::parseSweepValues(str);
+    } catch (const std::invalid_argument &) {
+      thrown = true;
+    }
+    if (!thrown) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+  if (DAT::parseSweepValues("1:" + std::to_string(LONG_MAX) + ":*2").size() != 63
+      || DAT::parseSweepValues(std::to_string(LONG_MAX - 1) + ":" + std::to_string(LONG_MAX) + ":1").size() != 2) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  auto points = DAT::expandSweepPoints({{"mem_size", {"1", "2"}}, {"seq_length", {"3", "4", "5"}}});
+  if (points.size() != 6 || points[1] != std::vector<std::string>{"1", "4"}) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // mem_size points of the same other values run together from the largest mem_size
+  std::vector<DAT::SweepAxis> axes = {{"mem_size", {"1", "2"}}, {"seq_length", {"3", "4", "5"}}};
+  auto groups = DAT::groupSweepPoints(axes, points, true);
+  if (groups.size() != 3 || groups[1] != std::vector<size_t>{4, 1}
+      || DAT::groupSweepPoints(axes, points, false).size() != 6) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  std::vector<DAT::ExploreResult> results(6);
+  for (auto [p, access_volume] : std::vector<std::pair<size_t, long> >{{0, 100}, {3, 100}, {4, 80}, {2, 50}, {5, 60}}) {
+    results[p].feasible = true;
+    results[p].operator_chain_num = 1;
+    results[p].access_volume = access_volume;
+  }
+  if (DAT::paretoSweepPoints(axes, points, results)
+      != std::vector<bool>{true, false, true, false, true, false}) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // thread pool
+  std::atomic<long> sum{0};
+  {
+    DAT::ThreadPool pool(4);
+    for (long i = 1; i <= 100; ++i) {
+      pool.submit([&sum, i]() { sum += i; });
+    }
+    pool.wait();
+  }
+  if (sum != 5050) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+  // a task throwing does not stop the others, and wait rethrows its exception
+  sum = 0;
+  {
+    DAT::ThreadPool pool(2);
+    pool.submit([]() { throw std::invalid_argument("task"); });
+    for (long i = 1; i <= 10; ++i) {
+      pool.submit([&sum, i]() { sum += i; });
+    }
+    bool thrown = false;
+    try {
+      pool.wait();
+    } catch (const std::invalid_argument &) {
+      thrown = true;
+    }
+    if (!thrown || sum != 55) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+
+  // a bad axis stops the sweep before any point runs, and a point failing while it runs is
+  // reported after the others
+  fs::path dir = fs::temp_directory_path() / fs::unique_path();
+  fs::create_directories(dir);
+  DAT::options().sweep = (dir / "bad.sweep").string();
+  DAT::options().sweep_result = (dir / "sweep.csv").string();
+  DAT::options().threads = 2;
+  for (const char *spec : {"seq_lenght = 64, 128\n", "workload = attention, transformer\n", "graph_file = missing.graph\nmem_size = 1024, 2048\n"}) {
+    std::ofstream(DAT::options().sweep) << spec;
+    if (DAT::runSweep() != 1) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+  std::ifstream csv(DAT::options().sweep_result);
+  std::string line;
+  long line_num = 0;
+  while (std::getline(csv, line)) {
+    ++line_num;
+  }
+  fs::remove_all(dir);
+  DAT::options() = DAT::Options();
+  if (line_num != 3) {
+    std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+    return 1;
+  }
+
+  // an order cached from one graph is restored on another graph with the same names
+  DAT::OrderCache order_cache;
+  std::string keys[2];
+  DAT::OrderCache::Entry entry;
+  for (int g = 0; g < 2; ++g) {
+    DAT::Dim dim_n("n"), dim_l("l"), dim_q("q"), dim_m("m");
+    dim_n.setSize(512);
+    dim_l.setSize(512);
+    dim_q.setSize(64);
+    dim_m.setSize(512);
+    DAT::Tensor2D mat_i("I", &dim_n, &dim_l), mat_wq("Wq", &dim_l, &dim_q);
+    DAT::Tensor2D mat_q("Q", &dim_n, &dim_q), mat_k("K", &dim_m, &dim_q), mat_s("S", &dim_n, &dim_m);
+    DAT::MatrixMul mul_q("mul_q", &mat_i, &mat_wq, &mat_q), mul_s("mul_s", &mat_q, &mat_k, &mat_s);
+    DAT::OperatorNode m_q(&mul_q), m_s(&mul_s);
+    for (auto op : {&mul_q, &mul_s}) {
+      for (auto d : op->getDims()) {
+        d->setBlockSize(op, 16);
+      }
+    }
+    mat_q.setFuse();
+    DAT::OperatorChain mul_chain;
+    mul_chain.addOperator(&mul_q, &mul_s);
+    DAT::updateOperatorTreeRelationship({&mat_q, &mat_s, &mat_i, &mat_k, &mat_wq});
+    mul_chain.updateTree();
+    mul_chain.addInternalTensor(&mat_q);
+    keys[g] = DAT::OrderCache::key(&mul_chain, 65536);
+    if (g == 0) {
+      mul_chain.setDimsOrder({&dim_m, &dim_l, &dim_q, &dim_n});
+      DAT::OperatorTree order_tree = mul_chain.getOperatorTree();
+      std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos;
+      int rank = 0;
+      for (auto node : order_tree.getNodes()) {
+        o_infos[node] = node->getOrderInfo();
+        o_infos[node].execute_rank = rank++;
+      }
+      mul_chain.setOrder(o_infos);
+      order_cache.store(keys[g], DAT::OrderCache::toEntry(false, 1.0, mul_chain.getOperatorTree()));
+      entry = DAT::OrderCache::toEntry(false, 1.0, mul_chain.getOperatorTree());
+    } else {
+      DAT::OrderCache::Entry cached;
+      if (keys[1] != keys[0] || !order_cache.lookup(keys[1], cached)
+          || DAT::OrderCache::key(&mul_chain, 32768) == keys[1]) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+      DAT::OperatorTree order_tree = DAT::OrderCache::toOrderTree(&mul_chain, cached);
+      mul_chain.setOrder(order_tree.getOrderInfos());
+      if (m_s.getDimsOrder() != std::vector<DAT::Dim *>{&dim_m, &dim_q, &dim_n}
+          || m_q.getDimsOrder() != std::vector<DAT::Dim *>{&dim_l, &dim_q, &dim_n}
+          || DAT::OrderCache::toEntry(false, 1.0, order_tree).execute_ranks != entry.execute_ranks) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,111 @@
+#ifndef MMCHAIN_ANALYSIS_TEST_TEST_UTILS_H
+#define MMCHAIN_ANALYSIS_TEST_TEST_UTILS_H
+
+#include <random>
+#include <algorithm>
+#include "simulator.h"
+
+DAT::Tensor *findTensor(const std::set<DAT::Tensor *> &tensors, const std::string &name) {
+  for (auto t : tensors) {
+    if (t->getName() == name) {
+      return t;
+    }
+  }
+  return nullptr;
+}
+
+// Random dims orders, and a random execute order running every producer before all its consumers.
+std::map<DAT::OperatorNode *, DAT::OrderInfo> randomOrderInfos(const DAT::OperatorTree &tree,
+                                                               std::default_random_engine &rng) {
+  std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos;
+  std::vector<DAT::OperatorNode *> ready = tree.getRoots();
+  int rank = 0;
+  while (!ready.empty()) {
+    size_t i = std::uniform_int_distribution<size_t>(0, ready.size() - 1)(rng);
+    DAT::OperatorNode *node = ready[i];
+    ready.erase(ready.begin() + static_cast<long>(i));
+    DAT::OrderInfo o_info(node);
+    auto dims = node->getOperator()->getDims();
+    o_info.dims_order.assign(dims.begin(), dims.end());
+    std::shuffle(o_info.dims_order.begin(), o_info.dims_order.end(), rng);
+    o_info.execute_rank = rank++;
+    o_infos[node] = o_info;
+    for (auto p : node->getProducers()) {
+      auto consumers = p->getConsumers();
+      if (std::all_of(consumers.begin(), consumers.end(),
+                      [&o_infos](DAT::OperatorNode *n) { return o_infos.count(n) > 0; })) {
+        ready.push_back(p);
+      }
+    }
+  }
+  return o_infos;
+}
+
+// Random block sizes of the dims of the chain, but those named in fixed_dims. With split, every
+// loop of a dim with more than one factor has more than one block.
+void setRandomBlockSizes(DAT::OperatorChain &mul_chain, std::default_random_engine &rng, bool split,
+                         const std::set<std::string> &fixed_dims = {}) {
+  for (auto op : mul_chain.getOperators()) {
+    for (auto d : op->getDims()) {
+      if (!fixed_dims.count(d->getName())) {
+        const auto &factors = d->getFactors();
+        size_t max_factor = factors.size() - 1 - (split && factors.size() > 1);
+        d->setBlockSize(op, factors[std::uniform_int_distribution<size_t>(0, max_factor)(rng)]);
+      }
+    }
+  }
+}
+
+// Set the order of the chain and compare its analytical cost with the batch evaluation and the
+// simulator. A loop of one block keeps no tile alive, but the analytical footprint expands the
+// tensor dims inside it all the same, so the simulated footprint is only equal when all loops are
+// split.
+bool sameCosts(DAT::OperatorChain &mul_chain, const std::map<DAT::OperatorNode *, DAT::OrderInfo> &o_infos) {
+  DAT::OperatorTree tree = mul_chain.getOperatorTree();
+  tree.setOrderInfos(o_infos);
+  DAT::BlockSizes bss;
+  bool all_split = true;
+  for (auto op : mul_chain.getOperators()) {
+    for (auto d : op->getDims()) {
+      bss[op][d] = d->getBlockSize(op);
+      all_split &= d->getBlocks(op) > 1;
+    }
+  }
+  DAT::ChainCost cost = mul_chain.evaluateOrders({tree}, {bss})[0];
+  mul_chain.setOrder(o_infos);
+  DAT::SimulationResult simulated = DAT::simulateChain(&mul_chain);
+  if (cost.access_volume != mul_chain.getMemAccessVolume()
+      || cost.mem_footprint != mul_chain.getMemFootprint()
+      || simulated.access_volume != mul_chain.getMemAccessVolume()
+      || simulated.mem_footprint > mul_chain.getMemFootprint()
+      || (all_split && simulated.mem_footprint != mul_chain.getMemFootprint())) {
+    std::cout << cost.access_volume << " " << simulated.access_volume << " " << mul_chain.getMemAccessVolume()
+              << ", " << cost.mem_footprint << " " << simulated.mem_footprint << " "
+              << mul_chain.getMemFootprint() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Compare candidate_num random orders and block sizes of the chain, every other one splitting
+// every loop.
+int checkRandomOrders(DAT::OperatorChain &mul_chain, int candidate_num) {
+  std::default_random_engine rng{2024};
+  DAT::OperatorTree tree = mul_chain.getOperatorTree();
+  for (int c = 0; c < candidate_num; ++c) {
+    std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos = randomOrderInfos(tree, rng);
+    if (o_infos.size() != tree.getNodes().size()) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+    setRandomBlockSizes(mul_chain, rng, c % 2 == 0);
+    if (!sameCosts(mul_chain, o_infos)) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      std::cout << "candidate " << c << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+#endif //MMCHAIN_ANALYSIS_TEST_TEST_UTILS_H
@@ -0,0 +1,135 @@
+#include <random>
+#include <algorithm>
+#include "workload.h"
+
+int main() {
+  // a fused tensor linking two chains formed by the fused tensors before it merges them
+  {
+    DAT::Dim dim_n("n", 64), dim_m("m", 64);
+    DAT::Tensor2D mat_x("X", &dim_n, &dim_m), mat_y("Y", &dim_n, &dim_m);
+    // fused tensors in address order: a-b, c-d, then b-c
+    DAT::Tensor2D fused[3] = {{"AB", &dim_n, &dim_m}, {"CD", &dim_n, &dim_m}, {"BC", &dim_n, &dim_m}};
+    DAT::ElementWise op_a("a", "scale", {&mat_x}, &fused[0]), op_b("b", "scale", {&fused[0]}, &fused[2]);
+    DAT::ElementWise op_c("c", "scale", {&fused[2]}, &fused[1]), op_d("d", "scale", {&fused[1]}, &mat_y);
+    DAT::OperatorNode m_a(&op_a), m_b(&op_b), m_c(&op_c), m_d(&op_d);
+    for (auto &t : fused) {
+      t.setFuse();
+    }
+    DAT::OperatorChain *op_chain[4] = {nullptr};
+    long operator_chain_num = DAT::createToOperatorChain(op_chain, {&op_a, &op_b, &op_c, &op_d},
+                                                         {&mat_x, &mat_y, &fused[0], &fused[1], &fused[2]});
+    if (operator_chain_num != 1 || op_chain[0]->getOperators().size() != 4) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+    delete op_chain[0];
+  }
+
+  // an unknown workload is rejected when the options are parsed and when its graph is built
+  {
+    DAT::Options o;
+    char arg0[] = "DAT", arg1[] = "--workload", arg2[] = "transformer";
+    char *argv[] = {arg0, arg1, arg2};
+    bool rejected = false;
+    try {
+      o.parse(3, argv);
+    } catch (const std::invalid_argument &e) {
+      rejected = std::string(e.what()) == "unknown workload: transformer";
+    }
+    if (!rejected) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+    DAT::Context context;
+    context.options.workload = "transformer";
+    DAT::ContextScope scope(context);
+    rejected = false;
+    try {
+      DAT::withWorkloadGraph([](const std::set<DAT::TensorOperator *> &, const std::set<DAT::Tensor *> &) {
+        return 0;
+      });
+    } catch (const std::invalid_argument &) {
+      rejected = true;
+    }
+    if (!rejected) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+  }
+
+  // random fuse patterns of a small transformer block: every chain agrees with the batch evaluator
+  // and the simulator, and its block size model builds
+  DAT::options().workload = "transformer_block";
+  DAT::options().softmax = true;
+  DAT::options().seq_length = 64;
+  DAT::options().hid_size = 16;
+  DAT::options().head_num = 4;
+  DAT::options().batch_size = 2;
+  DAT::options().batch_blocksize = 1;
+  DAT::options().head_blocksize = 1;
+  return DAT::withWorkloadGraph([](const std::set<DAT::TensorOperator *> &operators,
+                                   const std::set<DAT::Tensor *> &tensors) {
+    std::vector<DAT::Tensor *> non_io_tensors;
+    for (auto t : tensors) {
+      if (!t->isIO()) {
+        non_io_tensors.push_back(t);
+      }
+    }
+    if (operators.size() != 14 || non_io_tensors.size() != 13) {
+      std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+      return 1;
+    }
+    std::default_random_engine rng{2024};
+    for (int p = 0; p < 20; ++p) {
+      // the first pattern fuses the whole block into one chain
+      long pattern = p == 0 ? -1 : std::uniform_int_distribution<long>(0, 1L << non_io_tensors.size())(rng);
+      for (size_t i = 0; i < non_io_tensors.size(); ++i) {
+        (pattern >> i & 1) ? non_io_tensors[i]->setFuse() : non_io_tensors[i]->unsetFuse();
+      }
+      std::vector<DAT::OperatorChain *> op_chain(operators.size(), nullptr);
+      long operator_chain_num = DAT::createToOperatorChain(op_chain.data(), operators, tensors);
+      if (p == 0 && operator_chain_num != 1) {
+        std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+        return 1;
+      }
+      for (long i = 0; i < operator_chain_num; ++i) {
+        DAT::OperatorChain *mul_chain = op_chain[i];
+        mul_chain->setTensorsIsExternal();
+        std::map<DAT::OperatorNode *, DAT::OrderInfo> o_infos;
+        int rank = 0;
+        for (auto node : DAT::OperatorTree::breadthFirstSort(mul_chain->getOperatorTree().getRoot())) {
+          DAT::OrderInfo o_info(node);
+          auto dims = node->getOperator()->getDims();
+          o_info.dims_order.assign(dims.begin(), dims.end());
+          std::shuffle(o_info.dims_order.begin(), o_info.dims_order.end(), rng);
+          o_info.execute_rank = rank++;
+          o_infos[node] = o_info;
+        }
+        for (auto op : mul_chain->getOperators()) {
+          for (auto d : op->getDims()) {
+            if (d->getName() != "bsc" && d->getName() != "hsc") {
+              const auto &factors = d->getFactors();
+              d->setBlockSize(op, factors[std::uniform_int_distribution<size_t>(0, factors.size() - 1)(rng)]);
+            }
+          }
+        }
+        mul_chain->setOrder(o_infos);
+        auto costs = mul_chain->evaluateOrders({mul_chain->getOperatorTree()});
+        DAT::SimulationResult simulated = DAT::simulateChain(mul_chain);
+        if (costs[0].access_volume != mul_chain->getMemAccessVolume()
+            || costs[0].mem_footprint != mul_chain->getMemFootprint()
+            || simulated.access_volume != mul_chain->getMemAccessVolume()
+            || simulated.mem_footprint > mul_chain->getMemFootprint()) {
+          std::cerr << "failed:" << __FILE__ << ":" << __LINE__ << std::endl;
+          std::cout << mul_chain->toString();
+          return 1;
+        }
+        DAT::buildBlockSizeModel(mul_chain);
+      }
+      for (long i = 0; i < operator_chain_num; ++i) {
+        delete op_chain[i];
+      }
+    }
+    return 0;
+  });
+}